@@ -23,10 +23,12 @@ SOURCES = calendarcontrol.cpp \
           gunzip.cpp \
           login2.cpp \
           login2Options.cpp \
+          metasqlcache.cpp \
           metrics.cpp \
           metricsenc.cpp \
           qbase64encode.cpp \
           qmd5.cpp \
+          querythread.cpp \
           shortcuts.cpp \
           storedProcErrorLookup.cpp \
           tarfile.cpp \
@@ -44,10 +46,12 @@ HEADERS = calendarcontrol.h \
           gunzip.h \
           login2.h \
           login2Options.h \
+          metasqlcache.h \
           metrics.h \
           metricsenc.h \
           qbase64encode.h \
           qmd5.h \
+          querythread.h \
           shortcuts.h \
           storedProcErrorLookup.h \
           tarfile.h \
@@ -24,11 +24,14 @@
 #include <QTextDocument>
 
 #include "metasql.h"
+#include "metasqlcache.h"
 #include "mqlutil.h"
 #include "xsqlquery.h"
 
 #define DEBUG false
 
+static QString delimited(XSqlQuery &qry, ParameterList &params, QString &errmsg);
+
 bool ExportHelper::exportHTML(const int qryheadid, ParameterList &params, QString &filename, QString &errmsg)
 {
   if (DEBUG)
@@ -162,6 +165,7 @@ QString ExportHelper::generateDelimited(const int qryheadid, ParameterList &para
   while (itemq.next())
   {
     QString qtext;
+    QString oneresult;
     if (itemq.value("qryitem_src").toString() == "REL")
     {
       QString schemaName = itemq.value("qryitem_group").toString();
@@ -171,23 +175,28 @@ QString ExportHelper::generateDelimited(const int qryheadid, ParameterList &para
     }
     else if (itemq.value("qryitem_src").toString() == "MQL")
     {
+      // use the cached parse instead of handing the text to generateDelimited()
       QString tmpmsg;
       bool valid;
-      qtext = MQLUtil::mqlLoad(itemq.value("qryitem_group").toString(),
-                               itemq.value("qryitem_detail").toString(),
-                               tmpmsg, &valid);
+      QSharedPointer<MetaSQLQuery> mql =
+          MetaSQLCache::instance()->query(itemq.value("qryitem_group").toString(),
+                                          itemq.value("qryitem_detail").toString(),
+                                          tmpmsg, &valid);
       if (! valid)
         errmsg = tmpmsg;
+      else
+      {
+        XSqlQuery qry = mql->toQuery(params);
+        oneresult = delimited(qry, params, errmsg);
+      }
     }
     else if (itemq.value("qryitem_src").toString() == "CUSTOM")
       qtext = itemq.value("qryitem_detail").toString();
 
     if (! qtext.isEmpty())
-    {
-      QString oneresult = generateDelimited(qtext, params, errmsg);
-      if (! oneresult.isEmpty())
-        result.append(oneresult);
-    }
+      oneresult = generateDelimited(qtext, params, errmsg);
+    if (! oneresult.isEmpty())
+      result.append(oneresult);
   }
   if (itemq.lastError().type() != QSqlError::NoError)
     errmsg = itemq.lastError().text();
@@ -211,6 +220,13 @@ QString ExportHelper::generateDelimited(QString qtext, ParameterList &params, QS
     qDebug("generateDelimited parameters:\n%s", qPrintable(plist.join("\n")));
   }
 
+  MetaSQLQuery mql(qtext);
+  XSqlQuery qry = mql.toQuery(params);
+  return delimited(qry, params, errmsg);
+}
+
+static QString delimited(XSqlQuery &qry, ParameterList &params, QString &errmsg)
+{
   bool valid;
   QString delim = params.value("delim", &valid).toString();
   if (! valid)
@@ -226,8 +242,6 @@ QString ExportHelper::generateDelimited(QString qtext, ParameterList &params, QS
            includeheader, valid);
 
   QStringList line;
-  MetaSQLQuery mql(qtext);
-  XSqlQuery qry = mql.toQuery(params);
   if (qry.first())
   {
     QStringList field;
@@ -287,9 +301,9 @@ QString ExportHelper::generateHTML(const int qryheadid, ParameterList &params, Q
     {
       QString tmpmsg;
       bool valid;
-      qtext = MQLUtil::mqlLoad(itemq.value("qryitem_group").toString(),
-                               itemq.value("qryitem_detail").toString(),
-                               tmpmsg, &valid);
+      qtext = MetaSQLCache::instance()->source(itemq.value("qryitem_group").toString(),
+                                               itemq.value("qryitem_detail").toString(),
+                                               tmpmsg, &valid);
       if (! valid)
         errmsg = tmpmsg;
     }
@@ -397,9 +411,9 @@ QString ExportHelper::generateXML(const int qryheadid, ParameterList &params, QS
     {
       QString tmpmsg;
       bool valid;
-      qtext = MQLUtil::mqlLoad(itemq.value("qryitem_group").toString(),
-                               itemq.value("qryitem_detail").toString(),
-                               tmpmsg, &valid);
+      qtext = MetaSQLCache::instance()->source(itemq.value("qryitem_group").toString(),
+                                               itemq.value("qryitem_detail").toString(),
+                                               tmpmsg, &valid);
       if (! valid)
         errmsg = tmpmsg;
     }
@@ -12,6 +12,7 @@
 
 #include <QMessageBox>
 #include <QSqlError>
+#include <QSqlRecord>
 #include <QVariant>
 
 #include "format.h"
@@ -49,6 +50,47 @@ static int    weightscale      = WEIGHTSCALE;
 
 static bool   loadedLocales    = false;
 
+/* take the colors and scales from localeq, a record with the columns of
+   the locale table, leaving the defaults where a column is empty */
+static void applyLocale(const QSqlRecord &localeq)
+{
+  if (!localeq.value("locale_error_color").toString().isEmpty())
+    error = QColor(localeq.value("locale_error_color").toString());
+  if (!localeq.value("locale_warning_color").toString().isEmpty())
+    warning = QColor(localeq.value("locale_warning_color").toString());
+  if (!localeq.value("locale_emphasis_color").toString().isEmpty())
+    emphasis = QColor(localeq.value("locale_emphasis_color").toString());
+  if (!localeq.value("locale_altemphasis_color").toString().isEmpty())
+    altemphasis = QColor(localeq.value("locale_altemphasis_color").toString());
+  if (!localeq.value("locale_expired_color").toString().isEmpty())
+    expired = QColor(localeq.value("locale_expired_color").toString());
+  if (!localeq.value("locale_future_color").toString().isEmpty())
+    future = QColor(localeq.value("locale_future_color").toString());
+
+  if (!localeq.value("locale_cost_scale").toString().isEmpty())
+    costscale = localeq.value("locale_cost_scale").toInt();
+  if (!localeq.value("locale_curr_scale").toString().isEmpty())
+    currvalscale = localeq.value("locale_curr_scale").toInt();
+  if (!localeq.value("locale_extprice_scale").toString().isEmpty())
+    extpricescale = localeq.value("locale_extprice_scale").toInt();
+  if (!localeq.value("locale_percent_scale").toString().isEmpty())
+    percentscale = localeq.value("locale_percent_scale").toInt();
+  if (!localeq.value("locale_purchprice_scale").toString().isEmpty())
+    purchpricescale = localeq.value("locale_purchprice_scale").toInt();
+  if (!localeq.value("locale_qty_scale").toString().isEmpty())
+    qtyscale = localeq.value("locale_qty_scale").toInt();
+  if (!localeq.value("locale_qtyper_scale").toString().isEmpty())
+    qtyperscale = localeq.value("locale_qtyper_scale").toInt();
+  if (!localeq.value("locale_salesprice_scale").toString().isEmpty())
+    salespricescale = localeq.value("locale_salesprice_scale").toInt();
+  if (!localeq.value("locale_uomratio_scale").toString().isEmpty())
+    uomratioscale = localeq.value("locale_uomratio_scale").toInt();
+  if (!localeq.value("locale_weight_scale").toString().isEmpty())
+    weightscale = localeq.value("locale_weight_scale").toInt();
+
+  // TODO: add locale_percent_scale
+}
+
 static bool   loadLocale()
 {
   if (!loadedLocales)
@@ -78,43 +120,7 @@ static bool   loadLocale()
     localeq.bindValue(":user", user);
     localeq.exec();
     if (localeq.first())
-    {
-      if (!localeq.value("locale_error_color").toString().isEmpty())
-        error = QColor(localeq.value("locale_error_color").toString());
-      if (!localeq.value("locale_warning_color").toString().isEmpty())
-        warning = QColor(localeq.value("locale_warning_color").toString());
-      if (!localeq.value("locale_emphasis_color").toString().isEmpty())
-        emphasis = QColor(localeq.value("locale_emphasis_color").toString());
-      if (!localeq.value("locale_altemphasis_color").toString().isEmpty())
-        altemphasis = QColor(localeq.value("locale_altemphasis_color").toString());
-      if (!localeq.value("locale_expired_color").toString().isEmpty())
-        expired = QColor(localeq.value("locale_expired_color").toString());
-      if (!localeq.value("locale_future_color").toString().isEmpty())
-        future = QColor(localeq.value("locale_future_color").toString());
-
-      if (!localeq.value("locale_cost_scale").toString().isEmpty())
-        costscale = localeq.value("locale_cost_scale").toInt();
-      if (!localeq.value("locale_curr_scale").toString().isEmpty())
-        currvalscale = localeq.value("locale_curr_scale").toInt();
-      if (!localeq.value("locale_extprice_scale").toString().isEmpty())
-        extpricescale = localeq.value("locale_extprice_scale").toInt();
-      if (!localeq.value("locale_percent_scale").toString().isEmpty())
-        percentscale = localeq.value("locale_percent_scale").toInt();
-      if (!localeq.value("locale_purchprice_scale").toString().isEmpty())
-        purchpricescale = localeq.value("locale_purchprice_scale").toInt();
-      if (!localeq.value("locale_qty_scale").toString().isEmpty())
-        qtyscale = localeq.value("locale_qty_scale").toInt();
-      if (!localeq.value("locale_qtyper_scale").toString().isEmpty())
-        qtyperscale = localeq.value("locale_qtyper_scale").toInt();
-      if (!localeq.value("locale_salesprice_scale").toString().isEmpty())
-        salespricescale = localeq.value("locale_salesprice_scale").toInt();
-      if (!localeq.value("locale_uomratio_scale").toString().isEmpty())
-        uomratioscale = localeq.value("locale_uomratio_scale").toInt();
-      if (!localeq.value("locale_weight_scale").toString().isEmpty())
-        weightscale = localeq.value("locale_weight_scale").toInt();
-
-      // TODO: add locale_percent_scale
-    }
+      applyLocale(localeq.record());
     else if (localeq.lastError().type() != QSqlError::NoError)
     {
       QMessageBox::critical(0,
@@ -128,6 +134,16 @@ static bool   loadLocale()
   return true;
 }
 
+/*! Use the colors and numeric scales in \a locale, a record holding the
+    columns of the user's locale, instead of querying for them the first
+    time they're needed.
+ */
+void setFormatLocale(const QSqlRecord &locale)
+{
+  applyLocale(locale);
+  loadedLocales = true;
+}
+
 int decimalPlaces(QString pName)
 {
   int returnVal = MONEYSCALE;
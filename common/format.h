@@ -15,6 +15,8 @@
 #include <QLocale>
 #include <QString>
 
+class QSqlRecord;
+
 int             decimalPlaces(QString);
 QString         formatNumber(double, int);
 QString         formatMoney(double, int = -1, int = 0);
@@ -28,6 +30,7 @@ QString         formatPurchPrice(double, int = -1);
 QString         formatUOMRatio(double);
 QString         formatPercent(double);
 QColor          namedColor(QString);
+void            setFormatLocale(const QSqlRecord &);
 
 inline QString  formatDate(const QDate &pDate)
 {
@@ -0,0 +1,136 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "metasqlcache.h"
+
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlError>
+
+#include "metasql.h"
+#include "xsqlquery.h"
+
+#define DEBUG false
+
+#define NOTIFYNAME "metasqlUpdated"
+
+MetaSQLCache *MetaSQLCache::instance()
+{
+  static MetaSQLCache *cache = 0;
+  if (! cache)
+    cache = new MetaSQLCache();
+  return cache;
+}
+
+MetaSQLCache::MetaSQLCache(QObject *parent)
+  : QObject(parent),
+    _dirty(false),
+    _hits(0),
+    _misses(0)
+{
+  QSqlDatabase::database().driver()->subscribeToNotification(NOTIFYNAME);
+  QObject::connect(QSqlDatabase::database().driver(), SIGNAL(notification(const QString&)),
+                   this, SLOT(sNotified(const QString &)));
+}
+
+/*! Return the parsed MetaSQL statement \a group / \a name. \a valid is
+    set to false and \a errmsg is filled in if it can't be found or
+    doesn't parse. Statements that fail are not cached.
+ */
+QSharedPointer<MetaSQLQuery> MetaSQLCache::query(const QString &group, const QString &name,
+                                                 QString &errmsg, bool *valid, int grade)
+{
+  Entry *found = entry(group, name, errmsg, valid, grade);
+  return found ? found->query : QSharedPointer<MetaSQLQuery>(new MetaSQLQuery());
+}
+
+/*! Return the text of the MetaSQL statement \a group / \a name, for
+    callers that need to hand it to something else, such as a QueryThread.
+ */
+QString MetaSQLCache::source(const QString &group, const QString &name,
+                             QString &errmsg, bool *valid, int grade)
+{
+  Entry *found = entry(group, name, errmsg, valid, grade);
+  return found ? found->source : QString();
+}
+
+void MetaSQLCache::clear()
+{
+  if (DEBUG)
+    qDebug("MetaSQLCache::clear() %d entries, %d hits, %d misses",
+           _cache.size(), _hits, _misses);
+  _cache.clear();
+  _dirty = false;
+}
+
+void MetaSQLCache::sNotified(const QString &note)
+{
+  if (note == NOTIFYNAME)
+    _dirty = true;
+}
+
+MetaSQLCache::Entry *MetaSQLCache::entry(const QString &group, const QString &name,
+                                         QString &errmsg, bool *valid, int grade)
+{
+  if (_dirty)
+    clear();
+
+  QString key = QString("%1/%2/%3").arg(group, name).arg(grade);
+  QHash<QString, Entry>::iterator cached = _cache.find(key);
+  if (cached != _cache.end())
+  {
+    _hits++;
+    if (valid)
+      *valid = true;
+    return &cached.value();
+  }
+  _misses++;
+
+  XSqlQuery mqlq;
+  mqlq.prepare("SELECT metasql_query"
+               "  FROM metasql"
+               " WHERE ((metasql_group=:group)"
+               "   AND  (metasql_name=:name)"
+               "   AND  (:grade < 0 OR metasql_grade=:grade))"
+               " ORDER BY metasql_grade DESC LIMIT 1;");
+  mqlq.bindValue(":group", group);
+  mqlq.bindValue(":name",  name);
+  mqlq.bindValue(":grade", grade);
+  mqlq.exec();
+  if (! mqlq.first())
+  {
+    if (mqlq.lastError().type() != QSqlError::NoError)
+      errmsg = mqlq.lastError().databaseText();
+    else
+      errmsg = tr("Could not find the MetaSQL statement %1/%2").arg(group, name);
+    if (valid)
+      *valid = false;
+    return 0;
+  }
+
+  Entry loaded;
+  loaded.source = mqlq.value("metasql_query").toString();
+  loaded.query  = QSharedPointer<MetaSQLQuery>(new MetaSQLQuery(loaded.source));
+  if (! loaded.query->isValid())
+  {
+    errmsg = tr("Could not parse the MetaSQL statement %1/%2").arg(group, name);
+    if (valid)
+      *valid = false;
+    return 0;
+  }
+
+  if (DEBUG)
+    qDebug("MetaSQLCache::entry(%s) loaded, %d hits, %d misses",
+           qPrintable(key), _hits, _misses);
+
+  if (valid)
+    *valid = true;
+  return &_cache.insert(key, loaded).value();
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __METASQLCACHE_H__
+#define __METASQLCACHE_H__
+
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+
+class MetaSQLQuery;
+
+/* Parsed MetaSQL statements from the metasql table, kept for the life of
+   the session so displays that are refreshed over and over don't fetch
+   and parse the same text every time.
+
+   Entries are keyed by group, name and grade, where a grade of -1 means
+   whichever grade MQLUtil::mqlLoad() would pick, the highest. The whole
+   cache is dropped when the database sends the metasqlUpdated
+   notification, the same way Privileges reloads on usrprivUpdated, and
+   by the MetaSQL list whenever a statement is deleted or an editor it
+   opened is closed, since MQLEdit saves without telling anyone.
+*/
+class MetaSQLCache : public QObject
+{
+  Q_OBJECT
+
+  public:
+    static MetaSQLCache *instance();
+
+    QSharedPointer<MetaSQLQuery> query(const QString &group, const QString &name,
+                                       QString &errmsg, bool *valid = 0, int grade = -1);
+    QString source(const QString &group, const QString &name,
+                   QString &errmsg, bool *valid = 0, int grade = -1);
+
+    int hits()   const { return _hits;   }
+    int misses() const { return _misses; }
+
+  public slots:
+    void clear();
+
+  protected slots:
+    void sNotified(const QString &note);
+
+  private:
+    MetaSQLCache(QObject *parent = 0);
+
+    struct Entry
+    {
+      QString                      source;
+      QSharedPointer<MetaSQLQuery> query;
+    };
+    Entry *entry(const QString &group, const QString &name,
+                 QString &errmsg, bool *valid, int grade);
+
+    QHash<QString, Entry> _cache;
+    bool                  _dirty;
+    int                   _hits;
+    int                   _misses;
+};
+
+#endif
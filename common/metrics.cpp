@@ -10,35 +10,116 @@
 
 
 #include "metrics.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDesktopServices>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QSqlError>
 #include <QSqlDatabase>
 #include <QSqlDriver>
+#include <QStringList>
+#include <QTimer>
 #include <QVariant>
 #include "xsqlquery.h"
 #include <QMessageBox>
 
+#define DEBUG false
+
+/* how long set() waits for more changes before writing them */
+#define FLUSH_DELAY 1000
+
 Parameters::Parameters(QObject * parent)
   : QObject(parent)
 {
   _dirty = FALSE;
+  _writeThrough = false;
+  _journal = 0;
+
+  _flushTimer = new QTimer(this);
+  _flushTimer->setSingleShot(true);
+  _flushTimer->setInterval(FLUSH_DELAY);
+  connect(_flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
+  if (QCoreApplication::instance())
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(flush()));
+}
+
+Parameters::~Parameters()
+{
+  flush();
 }
 
 void Parameters::load()
 {
+  flush();
+
+  // changes a crash kept from being written last time
+  _pending = _readJournal();
+  flush();
+
   _values.clear();
+  _parents.clear();
 
   XSqlQuery q;
   q.prepare(_readSql);
   q.bindValue(":username", _username);
   q.exec();
   while (q.next())
-    _values[q.value("key").toString()] = q.value("value").toString();
+    _store(q.value("key").toString(), q.value("value").toString());
+
+  _dirty = FALSE;
+
+  emit loaded();
+}
+
+/*! Take \a pValues as the current contents instead of querying for them,
+    for callers that have already read them along with other data.
+ */
+void Parameters::load(const MetricMap &pValues)
+{
+  _pending.clear();
+  _values.clear();
+  _parents.clear();
+  _values.reserve(pValues.size());
+  for (MetricMap::const_iterator it = pValues.constBegin(); it != pValues.constEnd(); ++it)
+    _store(it.key(), it.value());
+
+  // changes a crash kept from being written last time, which pValues
+  // can't have seen
+  MetricMap recovered = _readJournal();
+  for (MetricMap::const_iterator it = recovered.constBegin(); it != recovered.constEnd(); ++it)
+    set(it.key(), it.value());
+  flush();
 
   _dirty = FALSE;
 
   emit loaded();
 }
 
+/* keep pName = pValue in memory, decoding it and indexing it for parent() */
+void Parameters::_store(const QString &pName, const QString &pValue)
+{
+  Value value;
+  value.text = pValue;
+  value.flag = (pValue == "t");
+  _values.insert(pName, value);
+  _indexParent(pName, pValue);
+}
+
+/* parent() has always answered with the first name in sorted order, so
+   the index keeps the smallest name for each value */
+void Parameters::_indexParent(const QString &pName, const QString &pValue)
+{
+  QHash<QString, QString>::iterator it = _parents.find(pValue);
+  if (it == _parents.end())
+    _parents.insert(pValue, pName);
+  else if (pName < it.value())
+    it.value() = pName;
+}
+
 void Parameters::sSetDirty(const QString &note)
 {
     if(note == _notifyName)
@@ -52,11 +133,11 @@ QString Parameters::value(const char *pName)
 
 QString Parameters::value(const QString &pName)
 {
-  MetricMap::iterator it = _values.find(pName);
-  if (it == _values.end())
+  QHash<QString, Value>::const_iterator it = _values.constFind(pName);
+  if (it == _values.constEnd())
     return QString::null;
   else
-    return it.value();
+    return it.value().text;
 }
 
 bool Parameters::boolean(const char *pName)
@@ -66,13 +147,11 @@ bool Parameters::boolean(const char *pName)
 
 bool Parameters::boolean(const QString &pName)
 {
-  MetricMap::iterator it = _values.find(pName);
-  if (it == _values.end())
+  QHash<QString, Value>::const_iterator it = _values.constFind(pName);
+  if (it == _values.constEnd())
     return FALSE;
-  else if (it.value() == "t")
-    return TRUE;
 
-  return FALSE;
+  return it.value().flag;
 }
 
 void Parameters::set(const char *pName, bool pValue)
@@ -102,66 +181,250 @@ void Parameters::set(const char *pName, const QString &pValue)
 
 void Parameters::set(const QString &pName, const QString &pValue)
 {
-  MetricMap::iterator it = _values.find(pName);
+  QHash<QString, Value>::iterator it = _values.find(pName);
   if (it != _values.end())
   {
-    if (it.value() == pValue)
+    if (it.value().text == pValue)
       return;
-    else
-      it.value() = pValue;
+
+    QString old = it.value().text;
+    _values.erase(it);
+    if (_parents.value(old) == pName)
+    {
+      // find the next name holding the old value, if there is one
+      _parents.remove(old);
+      for (QHash<QString, Value>::const_iterator v = _values.constBegin(); v != _values.constEnd(); ++v)
+        if (v.value().text == old)
+          _indexParent(v.key(), old);
+    }
   }
-  else
-    _values[pName] = pValue;
+  _store(pName, pValue);
 
   _set(pName, pValue);
 }
 
+/* queue pName = pValue to be written by flush(). A name set again before
+   then is written once, with the last value. With write-through the
+   queue is written before set() returns; otherwise the change is added
+   to the journal first, so a crash before the flush doesn't lose it. */
 void Parameters::_set(const QString &pName, QVariant pValue)
 {
+  _pending.insert(pName, pValue.toString());
+  _dirty = TRUE;
+
+  if (_writeThrough)
+    flush();
+  else
+  {
+    _appendJournal(pName, pValue.toString());
+    if (! _flushTimer->isActive())
+      _flushTimer->start();
+  }
+}
+
+/* keep queued changes in a file named for the database and pUser until
+   they're written. A Parameters without a journal only loses its queue
+   if the client dies before flushing it. */
+void Parameters::_setJournal(const QString &pUser)
+{
+  QSqlDatabase db = QSqlDatabase::database();
+  QString      id = QString("%1:%2/%3/%4").arg(db.hostName()).arg(db.port())
+                                          .arg(db.databaseName()).arg(pUser);
+  QString      hash = QCryptographicHash::hash(id.toUtf8(), QCryptographicHash::Md5).toHex();
+
+  _journalPath = QDesktopServices::storageLocation(QDesktopServices::DataLocation) +
+                 "/" + metaObject()->className() + "-" + hash + ".journal";
+}
+
+void Parameters::_appendJournal(const QString &pName, const QString &pValue)
+{
+  if (_journalPath.isEmpty())
+    return;
+
+  if (! _journal)
+  {
+    QDir().mkpath(QFileInfo(_journalPath).absolutePath());
+    _journal = new QFile(_journalPath, this);
+  }
+  if (! _journal->isOpen() && ! _journal->open(QIODevice::WriteOnly | QIODevice::Append))
+  {
+    qWarning("Parameters could not open %s: %s", qPrintable(_journalPath),
+             qPrintable(_journal->errorString()));
+    return;
+  }
+
+  QDataStream out(_journal);
+  out << pName << pValue;
+  _journal->flush();
+}
+
+/* the changes in the journal, the last value of each name winning. A
+   record cut short by a crash is ignored. */
+MetricMap Parameters::_readJournal()
+{
+  MetricMap changes;
+  if (_journalPath.isEmpty())
+    return changes;
+
+  QFile file(_journalPath);
+  if (! file.open(QIODevice::ReadOnly))
+    return changes;
+
+  QDataStream in(&file);
+  while (! in.atEnd())
+  {
+    QString name;
+    QString value;
+    in >> name >> value;
+    if (in.status() != QDataStream::Ok)
+      break;
+    changes.insert(name, value);
+  }
+
+  if (DEBUG)
+    qDebug("Parameters::_readJournal() %d changes in %s",
+           changes.size(), qPrintable(_journalPath));
+  return changes;
+}
+
+void Parameters::_removeJournal()
+{
+  if (_journal)
+    _journal->close();
+  if (! _journalPath.isEmpty())
+    QFile::remove(_journalPath);
+}
+
+/*! Write every change set() has queued in one statement. This happens
+    on its own shortly after the first change, when the application quits,
+    and before load() reads the values back, so callers only need it when
+    something other than this object must see a change right away.
+    Returns false if the changes could not be written; they are dropped
+    rather than retried so one bad value can't fail every later write.
+ */
+bool Parameters::flush()
+{
+  _flushTimer->stop();
+  if (_pending.isEmpty())
+    return true;
+
+  QStringList rows;
+  for (int i = 0; i < _pending.size(); i++)
+    rows << QString("(CAST(:name%1 AS TEXT), CAST(:value%1 AS TEXT))").arg(i);
+
   XSqlQuery q;
-  q.prepare(_setSql);
+  q.prepare(_setSql.arg(rows.join(", ")));
   q.bindValue(":username", _username);
-  q.bindValue(":name", pName);
-  q.bindValue(":value", pValue);
+  int i = 0;
+  for (MetricMap::const_iterator it = _pending.constBegin(); it != _pending.constEnd(); ++it, i++)
+  {
+    q.bindValue(QString(":name%1").arg(i),  it.key());
+    q.bindValue(QString(":value%1").arg(i), it.value());
+  }
   q.exec();
 
-  _dirty = TRUE;
+  if (DEBUG)
+    qDebug("Parameters::flush() wrote %d changes", _pending.size());
+  _pending.clear();
+  _removeJournal();
+
+  if (q.lastError().type() != QSqlError::NoError)
+  {
+    qWarning("Parameters::flush() could not save changes: %s",
+             qPrintable(q.lastError().databaseText()));
+    return false;
+  }
+  return true;
 }
 
+/*! Return how many milliseconds set() waits for more changes before
+    writing them.
+ */
+int Parameters::flushDelay() const
+{
+  return _writeThrough ? -1 : _flushTimer->interval();
+}
+
+/*! Wait \a pMsec milliseconds after the first of a series of changes
+    before writing them. 0 writes them as soon as the event loop is idle,
+    and a negative delay writes each change in set() before it returns.
+ */
+void Parameters::setFlushDelay(int pMsec)
+{
+  _writeThrough = (pMsec < 0);
+  _flushTimer->setInterval(qMax(0, pMsec));
+  if (_writeThrough)
+    flush();
+}
+
+/*! Return the name whose value is \a pValue, the first in sorted order if
+    there are several, or a null string if no name has that value. This is
+    how the hotkeys are looked up: the preference is named for the key and
+    holds the name of the action it triggers.
+ */
 QString Parameters::parent(const QString &pValue)
 {
-  for (MetricMap::iterator it = _values.begin(); it != _values.end(); it++)
-    if (it.value() == pValue)
-      return it.key();
+  QHash<QString, QString>::const_iterator it = _parents.constFind(pValue);
+  if (it == _parents.constEnd())
+    return QString::null;
 
-  return QString::null;
+  return it.value();
 }
 
 
 Metrics::Metrics()
+{
+  init();
+  load();
+}
+
+Metrics::Metrics(const MetricMap &pValues)
+{
+  init();
+  load(pValues);
+}
+
+void Metrics::init()
 {
   _notifyName = "metricsUpdated";
   _readSql = "SELECT metric_name AS key, metric_value AS value FROM metric;";
-  _setSql  = "SELECT setMetric(:name, :value);";
+  _setSql  = "SELECT setMetric(name, value)"
+             "  FROM (VALUES %1) AS pending(name, value);";
 
-  load();
+  // metrics are configuration the database reads too, so a change has
+  // to be there as soon as set() returns
+  setFlushDelay(-1);
 }
 
 
 Preferences::Preferences(const QString &pUsername)
+{
+  init(pUsername);
+  load();
+}
+
+Preferences::Preferences(const QString &pUsername, const MetricMap &pValues)
+{
+  init(pUsername);
+  load(pValues);
+}
+
+void Preferences::init(const QString &pUsername)
 {
   _notifyName = "preferencesUpdated";
   _readSql  = "SELECT usrpref_name AS key, usrpref_value AS value "
               "FROM usrpref "
               "WHERE (usrpref_username=:username);";
-  _setSql   = "SELECT setUserPreference(:username, :name, :value);";
+  _setSql   = "SELECT setUserPreference(:username, name, value)"
+              "  FROM (VALUES %1) AS pending(name, value);";
   _username = pUsername;
-
-  load();
+  _setJournal(pUsername);
 }
 
 void Preferences::remove(const QString &pPrefName)
 {
+  flush();
+
   XSqlQuery q;
   q.prepare("SELECT deleteUserPreference(:prefname);");
   q.bindValue(":prefname", pPrefName);
@@ -173,7 +436,6 @@ void Preferences::remove(const QString &pPrefName)
 
 Privileges::Privileges()
 {
-  _notifyName = "usrprivUpdated";
   QString user;
   XSqlQuery userq("SELECT getEffectiveXtUser() AS user;");
   if (userq.lastError().type() != QSqlError::NoError)
@@ -181,6 +443,23 @@ Privileges::Privileges()
   if (userq.first())
     user = userq.value("user").toString();
 
+  init(user);
+  load();
+}
+
+/*! Set up the privileges of \a pUser, the effective xTuple user, from
+    \a pValues instead of querying for them. They are still reloaded
+    from the database when they change.
+ */
+Privileges::Privileges(const QString &pUser, const MetricMap &pValues)
+{
+  init(pUser);
+  load(pValues);
+}
+
+void Privileges::init(const QString &user)
+{
+  _notifyName = "usrprivUpdated";
   _readSql = QString("SELECT priv_name AS key, TEXT('t') AS value "
              "  FROM usrpriv, priv "
              " WHERE((usrpriv_priv_id=priv_id)"
@@ -195,19 +474,13 @@ Privileges::Privileges()
   QSqlDatabase::database().driver()->subscribeToNotification("usrprivUpdated");
   QObject::connect(QSqlDatabase::database().driver(), SIGNAL(notification(const QString&)),
            this, SLOT(sSetDirty(const QString &)));
-
-  load();
 }
 
 bool Privileges::check(const QString &pName)
 {
   if(_dirty)
     load();
-  MetricMap::iterator it = _values.find(pName);
-  if (it == _values.end())
-    return FALSE;
-  else
-    return TRUE;
+  return _values.contains(pName);
 }
 
 bool Privileges::isDba()
@@ -14,8 +14,12 @@
 
 #include <QObject>
 #include <QString>
+#include <QHash>
 #include <QMap>
 
+class QFile;
+class QTimer;
+
 typedef QMap<QString, QString> MetricMap;
 
 class Parameters : public QObject
@@ -23,18 +27,33 @@ class Parameters : public QObject
   Q_OBJECT
 
   protected:
-    MetricMap _values;
+    /* the text of a value as stored plus what boolean() makes of it, so
+       the many checks of flags don't compare strings each time */
+    struct Value
+    {
+      QString text;
+      bool    flag;
+    };
+
+    QHash<QString, Value>   _values;
+    QHash<QString, QString> _parents;   // value -> smallest name holding it
     QString   _readSql;
-    QString   _setSql;
+    QString   _setSql;      // statement to write the VALUES list of pending changes
     QString   _username;
     bool      _dirty;
     QString   _notifyName;
+    MetricMap _pending;     // changes set() has made but flush() hasn't written
+    QTimer   *_flushTimer;
+    bool      _writeThrough;
+    QString   _journalPath; // the pending changes on disk until they're written
+    QFile    *_journal;
 
   public:
     Parameters(QObject * parent = 0);
-    virtual ~Parameters() {};
+    virtual ~Parameters();
 
     void load();
+    void load(const MetricMap &);
 
     QString value(const char *);
     bool    boolean(const char *);
@@ -48,13 +67,23 @@ class Parameters : public QObject
 
     QString parent(const QString &);
 
+    int  flushDelay() const;
+    void setFlushDelay(int);
+
   public slots:
     QString value(const QString &);
     bool    boolean(const QString &);
     void    sSetDirty(const QString &);
+    bool    flush();
 
   protected:
     void _set(const QString &, QVariant);
+    void _store(const QString &, const QString &);
+    void _indexParent(const QString &, const QString &);
+    void _setJournal(const QString &);
+    void _appendJournal(const QString &, const QString &);
+    MetricMap _readJournal();
+    void _removeJournal();
 
   signals:
     void loaded();
@@ -67,6 +96,10 @@ class Metrics : public Parameters
 
   public:
     Metrics();
+    Metrics(const MetricMap &);
+
+  private:
+    void init();
 };
 
 class Preferences : public Parameters
@@ -76,8 +109,12 @@ class Preferences : public Parameters
   public:
     Preferences() {};
     Preferences(const QString &);
+    Preferences(const QString &, const MetricMap &);
 
     void remove(const QString &);
+
+  private:
+    void init(const QString &);
 };
 
 class Privileges : public Parameters
@@ -86,10 +123,14 @@ class Privileges : public Parameters
 
   public:
     Privileges();
+    Privileges(const QString &, const MetricMap &);
 
   public slots:
     bool check(const QString &);
     bool isDba();
+
+  private:
+    void init(const QString &);
 };
 
 #endif
@@ -0,0 +1,439 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "querythread.h"
+
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlField>
+#include <QSqlQuery>
+#include <QStringList>
+
+#include "metasql.h"
+#include "xsqlquery.h"
+
+#define DEBUG false
+
+#define CURSORNAME "_querythread_cursor"
+
+static int _queryThreadCount = 0;
+
+static bool isNameChar(const QChar &c)
+{
+  return c.isLetterOrNumber() || c == '_';
+}
+
+/* DECLARE can't be PREPAREd so a cursor has to be declared with the
+   parameter values written into the statement. let the driver quote
+   them the same way it would for a driver that can't bind values.
+
+   only whole :name tokens outside quotes and comments are placeholders,
+   so ':x' in a string literal, :p1 inside :p10 and the second colon of a
+   ::cast are left alone. give up on anything we can't map back.
+ */
+static QString literalSql(QSqlDatabase &pDb, const QSqlQuery &pQuery)
+{
+  QString sql = pQuery.lastQuery().trimmed();
+  while (sql.endsWith(";"))
+    sql = sql.left(sql.length() - 1).trimmed();
+
+  QMap<QString, QVariant> bound = pQuery.boundValues();
+  foreach (QString name, bound.keys())
+    if (! name.startsWith(":"))
+      return QString();   // positional placeholders, can't map them back
+
+  QString result;
+  int     n = sql.length();
+  int     i = 0;
+  while (i < n)
+  {
+    QChar c = sql.at(i);
+    int   end = i + 1;
+
+    if (c == '\'' || c == '"')
+    {
+      // E'...' strings can escape a quote with a backslash
+      bool escapes = c == '\'' && i > 0 && sql.at(i - 1).toUpper() == 'E' &&
+                     (i == 1 || ! isNameChar(sql.at(i - 2)));
+      while (end < n && sql.at(end) != c)  // '' and "" just end and restart
+        end += (escapes && sql.at(end) == '\\') ? 2 : 1;
+      end = qMin(end + 1, n);
+    }
+    else if (c == '-' && i + 1 < n && sql.at(i + 1) == '-')
+    {
+      end = sql.indexOf('\n', i);
+      end = end < 0 ? n : end;
+    }
+    else if (c == '/' && i + 1 < n && sql.at(i + 1) == '*')
+    {
+      end = sql.indexOf("*/", i + 2);
+      end = end < 0 ? n : end + 2;
+    }
+    else if (c == ':' && i + 1 < n && sql.at(i + 1) == ':')
+      end = i + 2;
+    else if (c == ':' && i + 1 < n && isNameChar(sql.at(i + 1)))
+    {
+      while (end < n && isNameChar(sql.at(end)))
+        end++;
+      QString name = sql.mid(i, end - i);
+      if (! bound.contains(name))
+        return QString();
+
+      QVariant value = bound.value(name);
+      QSqlField field("", value.type());
+      if (! value.isNull())
+        field.setValue(value);
+      result += pDb.driver()->formatValue(field);
+      i = end;
+      continue;
+    }
+
+    result += sql.mid(i, end - i);
+    i = end;
+  }
+
+  return result;
+}
+
+static void copyRow(const QSqlQuery &pQuery, int pFieldCount, QList<QVariantList> &pRows)
+{
+  QVariantList row;
+  for (int i = 0; i < pFieldCount; i++)
+    row.append(pQuery.value(i));
+  pRows.append(row);
+}
+
+QueryThread::QueryThread(QObject *parent)
+  : QThread(parent),
+    _stopping(false),
+    _pending(false),
+    _request(0),
+    _backendPid(0),
+    _inStatement(false),
+    _size(-1),
+    _firstChunk(250),
+    _maxChunk(8000),
+    _streaming(false)
+{
+  /* copy the connection settings now, on the thread that owns the main
+     connection. the worker opens its own connection with them because
+     a QSqlDatabase may only be used by the thread that created it
+   */
+  QSqlDatabase db = QSqlDatabase::database();
+  _connectionName = QString("QueryThread%1").arg(++_queryThreadCount);
+  _driverName     = db.driverName();
+  _hostName       = db.hostName();
+  _port           = db.port();
+  _databaseName   = db.databaseName();
+  _userName       = db.userName();
+  _password       = db.password();
+  _connectOptions = db.connectOptions();
+}
+
+QueryThread::~QueryThread()
+{
+  {
+    QMutexLocker locker(&_mutex);
+    _stopping = true;
+  }
+  cancel();
+  _wake.wakeAll();
+  wait();
+}
+
+/*! Start running \a pSql, a MetaSQL statement, with \a pParams on the
+    worker connection. Any query still running is abandoned.
+    Returns the request number that the signals will carry for this query.
+ */
+int QueryThread::exec(const QString &pSql, const ParameterList &pParams)
+{
+  cancel();
+
+  int request;
+  {
+    QMutexLocker locker(&_mutex);
+    request  = _request;
+    _sql     = pSql;
+    _params  = pParams;
+    _pending = true;
+  }
+
+  if (! isRunning())
+    start();
+  _wake.wakeAll();
+
+  if (DEBUG)
+    qDebug("QueryThread::exec() request %d", request);
+  return request;
+}
+
+/*! Abandon the current query. The server is asked to stop working on it
+    and whatever rows have not been taken yet are thrown away.
+ */
+void QueryThread::cancel()
+{
+  {
+    QMutexLocker locker(&_mutex);
+    _request++;
+    _pending = false;
+    _rows.clear();
+    _fields = QSqlRecord();
+    _size   = -1;
+  }
+
+  /* the worker can't finish the statement it's in or start another
+     while this is held, so the cancel can only reach the statement that
+     was running for the request just abandoned. one that reaches the
+     server after the statement has finished is ignored by the server.
+
+     plain QSqlQuery: failing to cancel (e.g. insufficient privilege) is
+     harmless because the worker drops stale rows anyway, so there's no
+     need to bother the error log with it
+   */
+  QMutexLocker locker(&_cancelLock);
+  if (_inStatement && _backendPid > 0)
+  {
+    QSqlQuery cancelq;
+    cancelq.prepare("SELECT pg_cancel_backend(:pid);");
+    cancelq.bindValue(":pid", _backendPid);
+    cancelq.exec();
+  }
+}
+
+/*! Move the rows collected so far for \a pRequest into \a pRows.
+    Returns false if \a pRequest is no longer the current query.
+ */
+bool QueryThread::takeRows(int pRequest, QSqlRecord &pFields, QList<QVariantList> &pRows, int *pSize)
+{
+  QMutexLocker locker(&_mutex);
+  if (pRequest != _request)
+    return false;
+
+  pFields = _fields;
+  pRows   = _rows;
+  _rows.clear();
+  if (pSize)
+    *pSize = _size;
+
+  return true;
+}
+
+void QueryThread::run()
+{
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase(_driverName, _connectionName);
+    db.setHostName(_hostName);
+    db.setPort(_port);
+    db.setDatabaseName(_databaseName);
+    db.setUserName(_userName);
+    db.setPassword(_password);
+    db.setConnectOptions(_connectOptions);
+
+    QString connectError;
+    if (db.open())
+    {
+      QSqlQuery pidq(db);
+      if (pidq.exec("SELECT pg_backend_pid() AS pid;") && pidq.first())
+        _backendPid = pidq.value(0).toInt();
+    }
+    else
+      connectError = db.lastError().databaseText();
+
+    forever
+    {
+      int           request;
+      QString       sql;
+      ParameterList params;
+      {
+        QMutexLocker locker(&_mutex);
+        while (! _stopping && ! _pending)
+          _wake.wait(&_mutex);
+        if (_stopping)
+          break;
+
+        request  = _request;
+        sql      = _sql;
+        params   = _params;
+        _pending = false;
+      }
+
+      if (connectError.isEmpty())
+        execute(db, request, sql, params);
+      else
+        emit queryFailed(request, connectError);
+    }
+
+    db.close();
+  }
+  QSqlDatabase::removeDatabase(_connectionName);
+}
+
+void QueryThread::execute(QSqlDatabase &pDb, int pRequest, const QString &pSql, const ParameterList &pParams)
+{
+  MetaSQLQuery mql(pSql);
+  if (_streaming)
+  {
+    XSqlQuery prepared = mql.toQuery(pParams, pDb, false);
+    QString   sql      = literalSql(pDb, prepared);
+    if (! sql.isEmpty() && executeCursor(pDb, pRequest, sql))
+      return;
+  }
+
+  if (! beginStatement(pRequest))
+    return;
+  XSqlQuery qry = mql.toQuery(pParams, pDb);
+  endStatement();
+  if (! isCurrent(pRequest))
+    return;
+
+  if (qry.lastError().type() != QSqlError::NoError)
+  {
+    emit queryFailed(pRequest, qry.lastError().databaseText());
+    return;
+  }
+
+  QSqlRecord fields = qry.record();
+  int        fieldCount = fields.count();
+  int        chunk = _firstChunk;
+  QList<QVariantList> rows;
+
+  while (qry.next())
+  {
+    copyRow(qry, fieldCount, rows);
+
+    if (rows.size() >= chunk)
+    {
+      if (! isCurrent(pRequest))
+        return;
+      deliver(pRequest, fields, rows, qry.size());
+      chunk = qMin(chunk * 2, _maxChunk);
+    }
+  }
+
+  // always deliver once, even if empty, so the caller sees the columns
+  deliver(pRequest, fields, rows, qry.size());
+  if (isCurrent(pRequest))
+    emit queryFinished(pRequest);
+}
+
+/* returns false if the statement can't be run as a cursor, e.g. because
+   it isn't a single SELECT, so the caller can fall back to running it
+   directly. anything that goes wrong after that is reported as usual.
+ */
+bool QueryThread::executeCursor(QSqlDatabase &pDb, int pRequest, const QString &pSql)
+{
+  QSqlQuery cursor(pDb);
+  if (! cursor.exec("BEGIN;"))
+    return false;
+  if (! cursor.exec("DECLARE " CURSORNAME " NO SCROLL CURSOR FOR " + pSql))
+  {
+    if (DEBUG)
+      qDebug("QueryThread::executeCursor() cannot DECLARE: %s",
+             qPrintable(cursor.lastError().databaseText()));
+    cursor.exec("ROLLBACK;");
+    return false;
+  }
+
+  QString errorText;
+  int     chunk = _firstChunk;
+  bool    first = true;
+  while (beginStatement(pRequest))
+  {
+    QSqlQuery fetch(pDb);
+    fetch.setForwardOnly(true);
+    bool ok = fetch.exec(QString("FETCH FORWARD %1 FROM " CURSORNAME ";").arg(chunk));
+    endStatement();
+    if (! ok)
+    {
+      errorText = fetch.lastError().databaseText();
+      break;
+    }
+
+    QSqlRecord          fields     = fetch.record();
+    int                 fieldCount = fields.count();
+    QList<QVariantList> rows;
+    while (fetch.next())
+      copyRow(fetch, fieldCount, rows);
+
+    int fetched = rows.size();
+    if (fetched || first)
+      deliver(pRequest, fields, rows, -1);
+    first = false;
+
+    if (fetched < chunk)
+      break;
+    chunk = qMin(chunk * 2, _maxChunk);
+  }
+
+  bool current = isCurrent(pRequest);
+
+  // a failed or cancelled FETCH aborts the transaction
+  if (errorText.isEmpty() && current)
+  {
+    cursor.exec("CLOSE " CURSORNAME ";");
+    cursor.exec("COMMIT;");
+  }
+  else
+    cursor.exec("ROLLBACK;");
+
+  if (current && ! errorText.isEmpty())
+    emit queryFailed(pRequest, errorText);
+  else if (current)
+    emit queryFinished(pRequest);
+
+  return true;
+}
+
+void QueryThread::deliver(int pRequest, const QSqlRecord &pFields, QList<QVariantList> &pRows, int pSize)
+{
+  bool notify = false;
+  {
+    QMutexLocker locker(&_mutex);
+    if (pRequest != _request)
+    {
+      pRows.clear();
+      return;
+    }
+
+    notify  = _rows.isEmpty();  // otherwise a rowsReady is already queued
+    _fields = pFields;
+    _size   = pSize;
+    _rows  += pRows;
+  }
+  pRows.clear();
+
+  if (notify)
+    emit rowsReady(pRequest);
+}
+
+bool QueryThread::isCurrent(int pRequest)
+{
+  QMutexLocker locker(&_mutex);
+  return pRequest == _request;
+}
+
+/* mark the worker as running a statement for pRequest that cancel() may
+   interrupt, unless pRequest has already been abandoned */
+bool QueryThread::beginStatement(int pRequest)
+{
+  QMutexLocker locker(&_cancelLock);
+  if (! isCurrent(pRequest))
+    return false;
+  _inStatement = true;
+  return true;
+}
+
+void QueryThread::endStatement()
+{
+  QMutexLocker locker(&_cancelLock);
+  _inStatement = false;
+}
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __QUERYTHREAD_H__
+#define __QUERYTHREAD_H__
+
+#include <QList>
+#include <QMutex>
+#include <QSqlRecord>
+#include <QString>
+#include <QThread>
+#include <QVariant>
+#include <QWaitCondition>
+
+#include <parameter.h>
+
+class QSqlDatabase;
+
+/* Run MetaSQL queries on a database connection of their own so the GUI
+   stays responsive while the server works. Rows are copied out of the
+   result on the worker thread and handed back in chunks that grow as the
+   query goes on, so the first rows show up quickly without flooding the
+   event loop with tiny batches on big results.
+
+   In streaming mode the statement is run through a server-side cursor
+   and FETCHed one chunk at a time, so neither the server connection nor
+   this thread ever holds more than one chunk of the result.
+
+   Only one query is active at a time. Starting a new one or calling
+   cancel() abandons the current one; its remaining rows are discarded.
+*/
+class QueryThread : public QThread
+{
+  Q_OBJECT
+
+  public:
+    QueryThread(QObject *parent = 0);
+    ~QueryThread();
+
+    int   exec(const QString &pSql, const ParameterList &pParams);
+    void  cancel();
+    bool  takeRows(int pRequest, QSqlRecord &pFields, QList<QVariantList> &pRows, int *pSize = 0);
+
+    int   firstChunk() const          { return _firstChunk; }
+    void  setFirstChunk(int pRows)    { _firstChunk = qMax(1, pRows); }
+    int   maxChunk()   const          { return _maxChunk; }
+    void  setMaxChunk(int pRows)      { _maxChunk = qMax(1, pRows); }
+    bool  streaming()  const          { return _streaming; }
+    void  setStreaming(bool pOn)      { _streaming = pOn; }
+
+  signals:
+    void  rowsReady(int request);
+    void  queryFinished(int request);
+    void  queryFailed(int request, const QString &msg);
+
+  protected:
+    virtual void run();
+
+  private:
+    void  execute(QSqlDatabase &pDb, int pRequest, const QString &pSql, const ParameterList &pParams);
+    bool  executeCursor(QSqlDatabase &pDb, int pRequest, const QString &pSql);
+    void  deliver(int pRequest, const QSqlRecord &pFields, QList<QVariantList> &pRows, int pSize);
+    bool  isCurrent(int pRequest);
+    bool  beginStatement(int pRequest);
+    void  endStatement();
+
+    QMutex          _mutex;
+    QWaitCondition  _wake;
+    bool            _stopping;
+    bool            _pending;
+    int             _request;
+    QString         _sql;
+    ParameterList   _params;
+    int             _backendPid;
+    QMutex          _cancelLock;    // held while a cancel is being sent
+    bool            _inStatement;   // guarded by _cancelLock
+
+    QSqlRecord          _fields;
+    QList<QVariantList> _rows;
+    int                 _size;
+
+    int             _firstChunk;
+    int             _maxChunk;
+    bool            _streaming;
+
+    QString         _connectionName;
+    QString         _driverName;
+    QString         _hostName;
+    int             _port;
+    QString         _databaseName;
+    QString         _userName;
+    QString         _password;
+    QString         _connectOptions;
+};
+
+#endif
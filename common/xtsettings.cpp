@@ -10,32 +10,155 @@
 
 #include "xtsettings.h"
 
+#include <QCoreApplication>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QSettings>
+#include <QStringList>
 
-QVariant xtsettingsValue(const QString & key, const QVariant & defaultValue)
+#define DEBUG false
+
+/* Every setting the client has is read from QSettings once, the first
+   time any is asked for, and served from memory after that. Changes go
+   to memory and to one long-lived QSettings, which writes them to disk
+   together from the event loop and again when the application exits,
+   rather than a new QSettings being opened for each call.
+*/
+class XtSettingsCache
+{
+  public:
+    XtSettingsCache();
+    ~XtSettingsCache();
+
+    QVariant value(const QString &key, const QVariant &defaultValue);
+    void     setValue(const QString &key, const QVariant &value);
+
+  private:
+    void importOpenMFG();
+
+    QSettings               *_settings;
+    QHash<QString, QVariant> _values;
+    QMutex                   _mutex;
+};
+
+static XtSettingsCache *_cache = 0;
+static bool             _cleanupRegistered = false;
+
+static void xtsettingsCleanup()
+{
+  delete _cache;
+  _cache = 0;
+}
+
+/* the message handler can read settings before main() makes the
+   QApplication, so the exit-time cleanup is registered by the first call
+   that finds an application rather than by the one that made the cache
+ */
+static XtSettingsCache *xtsettingsCache()
+{
+  if (! _cache)
+    _cache = new XtSettingsCache();
+  if (! _cleanupRegistered && QCoreApplication::instance())
+  {
+    qAddPostRoutine(xtsettingsCleanup);
+    _cleanupRegistered = true;
+  }
+  return _cache;
+}
+
+/* QSettings treats "/xTuple/a", "xTuple/a" and "xTuple//a/" as the same
+   key so the cache has to as well */
+static QString normalizedKey(const QString &key)
+{
+  return key.split('/', QString::SkipEmptyParts).join("/");
+}
+
+XtSettingsCache::XtSettingsCache()
+{
+  _settings = new QSettings(QSettings::UserScope, "xTuple.com", "xTuple");
+
+  QStringList keys = _settings->allKeys();
+  _values.reserve(keys.size());
+  for (int i = 0; i < keys.size(); i++)
+    _values.insert(normalizedKey(keys.at(i)), _settings->value(keys.at(i)));
+
+  importOpenMFG();
+
+  if (DEBUG)
+    qDebug("XtSettingsCache() loaded %d settings", _values.size());
+}
+
+XtSettingsCache::~XtSettingsCache()
 {
-  QSettings settings(QSettings::UserScope, "xTuple.com", "xTuple");
-  QString key2 = key;
-  if(key.startsWith("/xTuple/"))
-    key2 = key2.replace(0, 8, QString("/OpenMFG/"));
-  if(settings.contains(key))
-    return settings.value(key, defaultValue);
-  else
+  delete _settings;       // writes anything not yet synced
+}
+
+/* Copy what's left of the settings from before the product was renamed,
+   once, instead of looking there for every setting the client doesn't
+   have. Settings under /OpenMFG/ became /xTuple/; the rest kept their
+   names. Nothing already set is overwritten.
+*/
+void XtSettingsCache::importOpenMFG()
+{
+  static const QString imported("xTuple/OpenMFGSettingsImported");
+  if (_values.contains(imported))
+    return;
+
+  QSettings oldsettings(QSettings::UserScope, "OpenMFG.com", "OpenMFG");
+  QStringList keys = oldsettings.allKeys();
+  int copied = 0;
+  for (int i = 0; i < keys.size(); i++)
   {
-    QSettings oldsettings(QSettings::UserScope, "OpenMFG.com", "OpenMFG");
-    if(oldsettings.contains(key2))
+    QString oldkey = normalizedKey(keys.at(i));
+    QString newkey = oldkey;
+    if (oldkey.startsWith("OpenMFG/"))
+      newkey.replace(0, 7, QString("xTuple"));
+    else if (oldkey.startsWith("xTuple/"))
+      continue;
+
+    if (! _values.contains(newkey))
     {
-      QVariant val = oldsettings.value(key2, defaultValue);
-      xtsettingsSetValue(key, val);
-      return val;
+      QVariant val = oldsettings.value(keys.at(i));
+      _values.insert(newkey, val);
+      _settings->setValue(newkey, val);
+      copied++;
     }
   }
-  return defaultValue;
+
+  _values.insert(imported, true);
+  _settings->setValue(imported, true);
+
+  if (DEBUG)
+    qDebug("XtSettingsCache::importOpenMFG() copied %d of %d settings",
+           copied, keys.size());
 }
 
-void xtsettingsSetValue(const QString & key, const QVariant & value)
+QVariant XtSettingsCache::value(const QString &key, const QVariant &defaultValue)
+{
+  QMutexLocker locker(&_mutex);
+  QHash<QString, QVariant>::const_iterator it = _values.constFind(normalizedKey(key));
+  if (it == _values.constEnd())
+    return defaultValue;
+  return it.value();
+}
+
+void XtSettingsCache::setValue(const QString &key, const QVariant &value)
 {
-  QSettings settings(QSettings::UserScope, "xTuple.com", "xTuple");
-  settings.setValue(key, value);
+  QMutexLocker locker(&_mutex);
+  QString name = normalizedKey(key);
+  _values.insert(name, value);
+  _settings->setValue(name, value);
+  if (! QCoreApplication::instance())   // no event loop or exit to sync from
+    _settings->sync();
 }
 
+QVariant xtsettingsValue(const QString & key, const QVariant & defaultValue)
+{
+  return xtsettingsCache()->value(key, defaultValue);
+}
+
+void xtsettingsSetValue(const QString & key, const QVariant & value)
+{
+  xtsettingsCache()->setValue(key, value);
+}
@@ -13,11 +13,17 @@
 #include "xlineedit.h"
 #include "ui_display.h"
 
+#include <QDomDocument>
+#include <QPointer>
+#include <QSet>
+#include <QSqlDriver>
 #include <QSqlError>
+#include <QSqlField>
 #include <QMessageBox>
 #include <QPrinter>
 #include <QPrintDialog>
 #include <QShortcut>
+#include <QTime>
 #include <QToolButton>
 #include <QDebug>
 
@@ -30,6 +36,193 @@
 #include <previewdialog.h>
 
 #include "../scriptapi/parameterlistsetup.h"
+#include "metasqlcache.h"
+#include "querythread.h"
+
+#define DEBUG false
+
+/* Parsed report definitions, shared by every display. Checking the
+   cache costs one small query for the grade and a checksum of the
+   source instead of fetching and parsing the whole definition again,
+   and an edited report is noticed because its checksum changes.
+ */
+class displayReportCache
+{
+  public:
+    static bool load(const QString &name, QDomDocument &doc, QWidget *parent);
+
+  private:
+    struct Entry
+    {
+      QString      md5;
+      QDomDocument doc;
+    };
+    static QHash<QString, Entry> _cache;  // key is "grade/name"
+};
+
+QHash<QString, displayReportCache::Entry> displayReportCache::_cache;
+
+bool displayReportCache::load(const QString &name, QDomDocument &doc, QWidget *parent)
+{
+  XSqlQuery report;
+  report.prepare("SELECT report_id, report_grade, MD5(report_source) AS report_md5"
+                 "  FROM report "
+                 " WHERE (report_name=:report_name)"
+                 " ORDER BY report_grade DESC LIMIT 1");
+  report.bindValue(":report_name", name);
+  report.exec();
+  if (! report.first())
+  {
+    QMessageBox::critical(parent, ::display::tr("Report Not Found"),
+      ::display::tr("The report %1 does not exist.").arg(name));
+    return false;
+  }
+
+  QString key = QString("%1/%2").arg(report.value("report_grade").toInt()).arg(name);
+  QString md5 = report.value("report_md5").toString();
+  QHash<QString, Entry>::const_iterator cached = _cache.constFind(key);
+  if (cached != _cache.constEnd() && cached.value().md5 == md5)
+  {
+    if (DEBUG)
+      qDebug("displayReportCache::load(%s) cached", qPrintable(key));
+    doc = cached.value().doc;
+    return true;
+  }
+
+  XSqlQuery source;
+  source.prepare("SELECT report_source FROM report WHERE (report_id=:report_id);");
+  source.bindValue(":report_id", report.value("report_id"));
+  source.exec();
+  if (! source.first())
+  {
+    QMessageBox::critical(parent, ::display::tr("Report Not Found"),
+      ::display::tr("The report %1 does not exist.").arg(name));
+    return false;
+  }
+
+  QString errorMessage;
+  int     errorLine;
+  QDomDocument parsed;
+  if (! parsed.setContent(source.value("report_source").toString(), &errorMessage, &errorLine))
+  {
+    QMessageBox::critical(parent, ::display::tr("Error Parsing Report"),
+      ::display::tr("There was an error Parsing the report definition. %1 %2").arg(errorMessage).arg(errorLine));
+    return false;
+  }
+
+  Entry entry;
+  entry.md5 = md5;
+  entry.doc = parsed;
+  _cache.insert(key, entry);
+  doc = parsed;
+  return true;
+}
+
+static QString sqlType(QVariant::Type type)
+{
+  switch (type)
+  {
+    case QVariant::Bool:      return "BOOLEAN";
+    case QVariant::Int:
+    case QVariant::UInt:      return "INTEGER";
+    case QVariant::LongLong:
+    case QVariant::ULongLong: return "BIGINT";
+    case QVariant::Double:    return "NUMERIC";
+    case QVariant::Date:      return "DATE";
+    case QVariant::Time:      return "TIME";
+    case QVariant::DateTime:  return "TIMESTAMP";
+    case QVariant::ByteArray: return "BYTEA";
+    default:                  return "TEXT";
+  }
+}
+
+/* A SELECT that returns the given rows without doing any of the work of
+   the query that produced them. Returns an empty string if the rows
+   can't be written as a MetaSQL statement.
+ */
+static QString snapshotSql(const QSqlRecord &fields, const QList<QVariantList> &rows)
+{
+  QSqlDriver *driver = QSqlDatabase::database().driver();
+  if (! driver || fields.isEmpty())
+    return QString();
+
+  QStringList columns;
+  QStringList aliases;
+  for (int i = 0; i < fields.count(); i++)
+  {
+    QString name = driver->escapeIdentifier(fields.fieldName(i), QSqlDriver::FieldName);
+    QString alias = QString("_snapshot_%1").arg(i);
+    columns << "CAST(" + (rows.isEmpty() ? QString("NULL") : alias) + " AS " +
+               sqlType(fields.field(i).type()) + ") AS " + name;
+    aliases << alias;
+  }
+
+  if (rows.isEmpty())
+    return "SELECT " + columns.join(", ") + " LIMIT 0;";
+
+  QStringList values;
+  for (int r = 0; r < rows.size(); r++)
+  {
+    QStringList row;
+    for (int i = 0; i < fields.count(); i++)
+    {
+      QVariant  value = rows.at(r).value(i);
+      QSqlField field("", fields.field(i).type());
+      if (! value.isNull())
+        field.setValue(value);
+      QString literal = driver->formatValue(field);
+      if (literal.contains("<?"))
+        return QString();   // MetaSQL would take it for a tag
+      row << literal;
+    }
+    values << "(" + row.join(", ") + ")";
+  }
+
+  // no arg() here, the values could contain %1
+  return "SELECT " + columns.join(", ") +
+         " FROM (VALUES " + values.join(",\n") + ") AS _snapshot(" + aliases.join(", ") + ");";
+}
+
+static bool isQuerySource(const QDomElement &source, const QString &group,
+                          const QString &name, const QString &sql)
+{
+  if (source.attribute("loadFromDb") == "true")
+    return source.firstChildElement("mqlgroup").text() == group &&
+           source.firstChildElement("mqlname").text()  == name;
+
+  return source.firstChildElement("sql").text().trimmed() == sql.trimmed();
+}
+
+static bool sameParams(const ParameterList &a, const ParameterList &b)
+{
+  if (a.count() != b.count())
+    return false;
+  for (int i = 0; i < a.count(); i++)
+    if (a.name(i) != b.name(i) || a.value(i) != b.value(i))
+      return false;
+  return true;
+}
+
+#define PREFETCHTHREADS 3       // background connections shared by all displays
+#define PREFETCHCACHE   4       // prefetched results kept per display
+#define PREFETCHAGE     120000  // ms before a prefetched result is too old to show
+#define SNAPSHOTROWS    2000    // most rows kept for printing, larger results are queried again
+
+/* prefetch() queues the display here until one of the shared connections
+   is free. the queue holds QPointers so a display closed while waiting
+   simply drops out.
+ */
+static QList<QueryThread*>      _prefetchThreads;
+static QSet<QueryThread*>       _prefetchBusy;
+static QList<QPointer<display> > _prefetchQueue;
+
+static QList<QueryThread*> prefetchThreads()
+{
+  if (_prefetchThreads.isEmpty())
+    for (int i = 0; i < PREFETCHTHREADS; i++)
+      _prefetchThreads.append(new QueryThread(qApp));
+  return _prefetchThreads;
+}
 
 class displayPrivate : public Ui::display
 {
@@ -46,6 +239,19 @@ public:
     _useAltId = false;
     _queryOnStartEnabled = false;
     _autoUpdateEnabled = false;
+    _asyncFill = false;
+    _queryThread = 0;
+    _fillRequest = -1;
+    _fillItemId = -1;
+    _fillRows = 0;
+    _fillMerge = false;
+    _refreshing = false;
+    _snapshotValid = false;
+    _snapshotOverflow = false;
+    _prefetchThread = 0;
+    _prefetchRequest = -1;
+    _prefetchAdopt = false;
+    _fillAnnounced = false;
 
     // Build Toolbar even if we hide it so we get actions
     _newBtn = new QToolButton(_toolBar);
@@ -127,6 +333,14 @@ public:
   bool setParams(ParameterList &);
   void setupCharacteristics(unsigned int use);
   void print(ParameterList, bool, bool);
+  void startFill(const QString &, const ParameterList &, int);
+  void fillRows(int);
+  void printSnapshot(QDomDocument &, const ParameterList &);
+  void keepSnapshot(const QString &, const ParameterList &,
+                    const QSqlRecord &, const QList<QVariantList> &);
+  bool usePrefetch(const QString &, const ParameterList &, int);
+  void releasePrefetch();
+  static void startPrefetches();
 
   QString reportName;
   QString metasqlName;
@@ -136,6 +350,43 @@ public:
   bool _queryOnStartEnabled;
   bool _autoUpdateEnabled;
 
+  bool         _asyncFill;
+  QueryThread *_queryThread;
+  int          _fillRequest;
+  int          _fillItemId;
+  int          _fillRows;
+  bool         _fillMerge;
+  bool         _refreshing;
+
+  // the result of the last sFillList(), printed instead of running the
+  // report's copy of the same query again. only results of up to
+  // SNAPSHOTROWS rows are kept; larger ones are left to the report. an
+  // asynchronous fill collects its rows here as they arrive, and an
+  // auto-update merge collects all of them before merging.
+  bool                _snapshotValid;
+  bool                _snapshotOverflow;
+  QString             _snapshotSource;
+  ParameterList       _snapshotParams;
+  QSqlRecord          _snapshotFields;
+  QList<QVariantList> _snapshotRows;
+
+  // results prefetch() collected on the shared connections before
+  // anybody asked for them, most recent first, and the one in progress
+  struct Prefetch
+  {
+    QString             source;
+    ParameterList       params;
+    QSqlRecord          fields;
+    QList<QVariantList> rows;
+    QTime               age;
+  };
+  QList<Prefetch> _prefetched;
+  Prefetch        _prefetching;
+  QueryThread    *_prefetchThread;
+  int             _prefetchRequest;
+  bool            _prefetchAdopt;
+  bool            _fillAnnounced;   // fillListBefore() already sent for this fill
+
   QAction* _newAct;
   QAction* _closeAct;
   QAction* _sep1;
@@ -178,34 +429,12 @@ void displayPrivate::print(ParameterList pParams, bool showPreview, bool forceSe
     if(!_parent->setParams(params))
       return;
   }
-  params.append("isReport", true);
-
-  XSqlQuery report;
-  report.prepare("SELECT report_grade, report_source "
-                 "  FROM report "
-                 " WHERE (report_name=:report_name)"
-                 " ORDER BY report_grade DESC LIMIT 1");
-  report.bindValue(":report_name", reportName);
-  report.exec();
   QDomDocument _doc;
-  if (report.first())
-  {
-    QString errorMessage;
-    int     errorLine;
-
-    if (!_doc.setContent(report.value("report_source").toString(), &errorMessage, &errorLine))
-    {
-      QMessageBox::critical(_parent, ::display::tr("Error Parsing Report"),
-        ::display::tr("There was an error Parsing the report definition. %1 %2").arg(errorMessage).arg(errorLine));
-      return;
-    }
-  }
-  else
-  {
-    QMessageBox::critical(_parent, ::display::tr("Report Not Found"),
-      ::display::tr("The report %1 does not exist.").arg(reportName));
+  if (! displayReportCache::load(reportName, _doc, _parent))
     return;
-  }
+  printSnapshot(_doc, params);
+
+  params.append("isReport", true);
 
   ORPreRender pre;
   pre.setDom(_doc);
@@ -245,6 +474,210 @@ void displayPrivate::print(ParameterList pParams, bool showPreview, bool forceSe
   }
 }
 
+/* Point the report's query sources that run the display's own MetaSQL at
+   the rows the display already has, as long as the display was filled
+   with the same parameters. Queries that check isReport return something
+   different when printed so they always run again.
+ */
+void displayPrivate::printSnapshot(QDomDocument &doc, const ParameterList &params)
+{
+  if (! _snapshotValid || _snapshotSource.contains("isReport") ||
+      ! sameParams(params, _snapshotParams))
+    return;
+
+  QDomNodeList sources = doc.elementsByTagName("querysource");
+  int matches = 0;
+  for (int i = 0; i < sources.count(); i++)
+    if (isQuerySource(sources.at(i).toElement(), metasqlGroup, metasqlName, _snapshotSource))
+      matches++;
+  if (! matches)
+    return;
+
+  QString sql = snapshotSql(_snapshotFields, _snapshotRows);
+  if (sql.isEmpty())
+    return;
+
+  if (DEBUG)
+    qDebug("displayPrivate::printSnapshot() %d rows for %d query sources",
+           _snapshotRows.size(), matches);
+
+  // the parsed report is shared with the cache, don't change it in place
+  doc = doc.cloneNode(true).toDocument();
+  sources = doc.elementsByTagName("querysource");
+  for (int i = 0; i < sources.count(); i++)
+  {
+    QDomElement source = sources.at(i).toElement();
+    if (! isQuerySource(source, metasqlGroup, metasqlName, _snapshotSource))
+      continue;
+
+    source.removeAttribute("loadFromDb");
+    source.removeChild(source.firstChildElement("mqlgroup"));
+    source.removeChild(source.firstChildElement("mqlname"));
+    source.removeChild(source.firstChildElement("sql"));
+    QDomElement text = doc.createElement("sql");
+    text.appendChild(doc.createTextNode(sql));
+    source.appendChild(text);
+  }
+}
+
+/* remember the result of a fill for printSnapshot() if it is small
+   enough to be worth keeping, and forget any older one otherwise */
+void displayPrivate::keepSnapshot(const QString &source, const ParameterList &params,
+                                  const QSqlRecord &fields, const QList<QVariantList> &rows)
+{
+  _snapshotOverflow = false;
+  _snapshotSource   = source;
+  _snapshotParams   = params;
+  _snapshotValid    = rows.size() <= SNAPSHOTROWS;
+  _snapshotFields   = _snapshotValid ? fields : QSqlRecord();
+  _snapshotRows     = _snapshotValid ? rows   : QList<QVariantList>();
+}
+
+/* run the query on the display's QueryThread and let fillRows() feed the
+   list as the rows come in. the current contents stay visible until the
+   first chunk replaces them. an auto-update refresh instead collects the
+   whole result and merges it into the list when the query finishes.
+ */
+void displayPrivate::startFill(const QString &source, const ParameterList &params, int itemid)
+{
+  if (! _queryThread)
+  {
+    _queryThread = new QueryThread(_parent);
+    _queryThread->setStreaming(true);
+    QObject::connect(_queryThread, SIGNAL(rowsReady(int)),     _parent, SLOT(sFillRowsReady(int)), Qt::QueuedConnection);
+    QObject::connect(_queryThread, SIGNAL(queryFinished(int)), _parent, SLOT(sFillFinished(int)),  Qt::QueuedConnection);
+    QObject::connect(_queryThread, SIGNAL(queryFailed(int, const QString &)),
+                     _parent,      SLOT(sFillFailed(int, const QString &)),  Qt::QueuedConnection);
+    QObject::connect(_list, SIGNAL(populateCanceled()), _parent, SLOT(sCancelFill()));
+  }
+
+  _fillItemId  = itemid;
+  _fillRows    = 0;
+  _fillMerge   = _refreshing;
+  _snapshotValid    = false;
+  _snapshotOverflow = false;
+  _snapshotSource   = source;
+  _snapshotParams   = params;
+  _snapshotFields   = QSqlRecord();
+  _snapshotRows.clear();
+  _fillRequest = _queryThread->exec(source, params);
+  if (! _fillMerge)
+    _list->setProgress(0, 0);
+}
+
+void displayPrivate::fillRows(int request)
+{
+  QSqlRecord          fields;
+  QList<QVariantList> rows;
+  int                 size = -1;
+
+  if (request != _fillRequest ||
+      ! _queryThread->takeRows(request, fields, rows, &size))
+    return;
+
+  // a merge needs every row; otherwise stop collecting once there are
+  // too many to keep for printing
+  _snapshotFields = fields;
+  if (_fillMerge)
+  {
+    _snapshotRows += rows;
+    return;
+  }
+  if (! _snapshotOverflow)
+  {
+    _snapshotRows += rows;
+    if (_snapshotRows.size() > SNAPSHOTROWS)
+    {
+      _snapshotRows.clear();
+      _snapshotOverflow = true;
+    }
+  }
+
+  if (rows.isEmpty() && _fillRows > 0)
+    return;
+
+  _list->populate(fields, rows, _fillItemId, _useAltId,
+                  _fillRows ? XTreeWidget::Append : XTreeWidget::Replace);
+  _fillRows += rows.size();
+  _list->setProgress(_fillRows, qMax(size, 0));
+}
+
+/* fill the list from a prefetched result for the same query if there is
+   a fresh one, or wait for the prefetch still running for it. either way
+   the result is used once; asking again runs the query again.
+ */
+bool displayPrivate::usePrefetch(const QString &source, const ParameterList &params, int itemid)
+{
+  if (_refreshing)
+    return false;
+
+  for (int i = 0; i < _prefetched.size(); i++)
+  {
+    if (_prefetched.at(i).source != source || ! sameParams(_prefetched.at(i).params, params))
+      continue;
+
+    Prefetch prefetched = _prefetched.takeAt(i);
+    if (prefetched.age.elapsed() > PREFETCHAGE)
+      return false;
+
+    if (DEBUG)
+      qDebug("displayPrivate::usePrefetch() %s.%s %d rows, %d ms old",
+             qPrintable(metasqlGroup), qPrintable(metasqlName),
+             prefetched.rows.size(), prefetched.age.elapsed());
+
+    _list->populate(prefetched.fields, prefetched.rows, itemid, _useAltId, XTreeWidget::Replace);
+    keepSnapshot(source, params, prefetched.fields, prefetched.rows);
+    emit _parent->fillListAfter();
+    return true;
+  }
+
+  if ((_prefetchThread || _prefetchQueue.contains(_parent)) &&
+      _prefetching.source == source && sameParams(_prefetching.params, params))
+  {
+    _prefetchAdopt = true;
+    _list->setProgress(0, 0);
+    return true;
+  }
+
+  return false;
+}
+
+void displayPrivate::releasePrefetch()
+{
+  if (_prefetchThread)
+  {
+    _prefetchThread->cancel();
+    _prefetchBusy.remove(_prefetchThread);
+  }
+  _prefetchThread  = 0;
+  _prefetchRequest = -1;
+  _prefetchQueue.removeAll(_parent);
+}
+
+/* hand queued displays to whichever shared connections are free */
+void displayPrivate::startPrefetches()
+{
+  QList<QueryThread*> threads = prefetchThreads();
+  for (int i = 0; i < threads.size() && ! _prefetchQueue.isEmpty(); i++)
+  {
+    if (_prefetchBusy.contains(threads.at(i)))
+      continue;
+
+    QPointer< ::display> next;
+    while (! next && ! _prefetchQueue.isEmpty())
+      next = _prefetchQueue.takeFirst();
+    if (! next)
+      break;
+
+    displayPrivate *data = next->_data;
+    data->_prefetchThread  = threads.at(i);
+    data->_prefetchRequest = threads.at(i)->exec(data->_prefetching.source,
+                                                 data->_prefetching.params);
+    data->_prefetching.age.start();
+    _prefetchBusy.insert(threads.at(i));
+  }
+}
+
 void displayPrivate::setupCharacteristics(unsigned int use)
 {
   QStringList uses;
@@ -445,6 +878,10 @@ display::display(QWidget* parent, const char* name, Qt::WindowFlags flags)
 
 display::~display()
 {
+  _data->releasePrefetch();
+  displayPrivate::startPrefetches();
+  if (_data->_queryThread)
+    delete _data->_queryThread;
   delete _data;
   _data = 0;
 }
@@ -574,6 +1011,16 @@ void display::setMetaSQLOptions(const QString & group, const QString & name)
   _data->metasqlGroup = group;
 }
 
+QString display::metaSQLGroup() const
+{
+  return _data->metasqlGroup;
+}
+
+QString display::metaSQLName() const
+{
+  return _data->metasqlName;
+}
+
 void display::setListLabel(const QString & pText)
 {
   _data->_listLabelFrame->setHidden(pText.isEmpty());
@@ -662,14 +1109,7 @@ void display::setQueryOnStartEnabled(bool on)
   {
     QString prefname = window()->objectName() + "/" +
                        _data->_queryonstart->objectName() + "/checked";
-    XSqlQuery qry;
-    qry.prepare("SELECT usrpref_id "
-                "FROM usrpref "
-                "WHERE ((usrpref_username=getEffectiveXtUser()) "
-                " AND (usrpref_name=:prefname));");
-    qry.bindValue(":prefname", prefname);
-    qry.exec();
-    if (!qry.first())
+    if (_preferences->value(prefname).isNull())
       _preferences->set(prefname, 2);
   }
 }
@@ -704,6 +1144,26 @@ bool display::autoUpdateEnabled() const
   return _data->_autoUpdateEnabled;
 }
 
+/*! Run the query for sFillList() on a background connection instead of
+    blocking the GUI. Rows are added to the list in chunks as they arrive
+    and the list's progress bar can cancel the query. Plain SELECTs are
+    read through a server-side cursor so large results never have to be
+    held in memory all at once. fillListBefore() is
+    emitted when the query starts and fillListAfter() once all rows are in.
+
+    Subclasses that rely on the list being filled when sFillList() returns
+    should leave this disabled.
+ */
+void display::setAsyncFillEnabled(bool on)
+{
+  _data->_asyncFill = on;
+}
+
+bool display::asyncFillEnabled() const
+{
+  return _data->_asyncFill;
+}
+
 void display::sNew()
 {
 }
@@ -735,7 +1195,10 @@ void display::sFillList()
 
 void display::sFillList(ParameterList pParams, bool forceSetParams)
 {
-  emit fillListBefore();
+  if (_data->_fillAnnounced)
+    _data->_fillAnnounced = false;
+  else
+    emit fillListBefore();
   if (forceSetParams || !pParams.count())
   {
     if (!setParams(pParams))
@@ -744,14 +1207,45 @@ void display::sFillList(ParameterList pParams, bool forceSetParams)
   int itemid = _data->_list->id();
   bool ok = true;
   QString errorString;
-  MetaSQLQuery mql = MQLUtil::mqlLoad(_data->metasqlGroup, _data->metasqlName, errorString, &ok);
+  QSharedPointer<MetaSQLQuery> mql = MetaSQLCache::instance()->query(_data->metasqlGroup, _data->metasqlName, errorString, &ok);
   if(!ok)
   {
     systemError(this, errorString, __FILE__, __LINE__);
     return;
   }
-  XSqlQuery xq = mql.toQuery(pParams);
-  _data->_list->populate(xq, itemid, _data->_useAltId);
+  if (_data->usePrefetch(mql->getSource(), pParams, itemid))
+    return;
+  if (_data->_asyncFill)
+  {
+    _data->startFill(mql->getSource(), pParams, itemid);
+    return;
+  }
+  _data->_snapshotValid  = false;
+  _data->_snapshotFields = QSqlRecord();
+  _data->_snapshotRows.clear();
+  XSqlQuery xq = mql->toQuery(pParams);
+  XTreeWidget::PopulateStyle style = _data->_refreshing ? XTreeWidget::Merge
+                                                        : XTreeWidget::Replace;
+
+  // copy a small result out once, then show it and keep it for printing
+  // from the copy. a larger one goes to populate() unread: it reads the
+  // rows later from a timer, through a copy of xq that shares its cursor
+  if (xq.size() >= 0 && xq.size() <= SNAPSHOTROWS)
+  {
+    QSqlRecord          fields = xq.record();
+    QList<QVariantList> rows;
+    while (xq.next())
+    {
+      QVariantList row;
+      for (int i = 0; i < fields.count(); i++)
+        row.append(xq.value(i));
+      rows.append(row);
+    }
+    _data->_list->populate(fields, rows, itemid, _data->_useAltId, style);
+    _data->keepSnapshot(mql->getSource(), pParams, fields, rows);
+  }
+  else
+    _data->_list->populate(xq, itemid, _data->_useAltId, style);
   if (xq.lastError().type() != QSqlError::NoError)
   {
     systemError(this, xq.lastError().databaseText(), __FILE__, __LINE__);
@@ -768,9 +1262,212 @@ void display::sAutoUpdateToggled()
 {
   bool update = _data->_autoUpdateEnabled && _data->_autoupdate->isChecked();
   if (update)
-    connect(omfgThis, SIGNAL(tick()), this, SLOT(sFillList()));
+    connect(omfgThis, SIGNAL(tick()), this, SLOT(sAutoUpdateTick()));
+  else
+    disconnect(omfgThis, SIGNAL(tick()), this, SLOT(sAutoUpdateTick()));
+}
+
+/* refresh by merging the new result into the list so only rows that were
+   added, changed or removed are touched and the user keeps their place.
+   skip the tick if the last fill hasn't finished yet.
+ */
+void display::sAutoUpdateTick()
+{
+  if (_data->_fillRequest >= 0)
+    return;
+
+  _data->_refreshing = true;
+  sFillList();
+  _data->_refreshing = false;
+}
+
+/* the list keeps the rows it already has. chunks that arrived but haven't
+   been added yet are dropped with the rest of the query. */
+void display::sCancelFill()
+{
+  bool filling = _data->_fillRequest >= 0;
+  if (_data->_queryThread)
+    _data->_queryThread->cancel();
+  _data->_fillRequest = -1;
+  _data->_snapshotRows.clear();
+  _data->_list->cancelPopulate();
+  if (filling)
+    emit fillListAfter();
+}
+
+void display::sFillRowsReady(int request)
+{
+  _data->fillRows(request);
+}
+
+void display::sFillFinished(int request)
+{
+  if (request != _data->_fillRequest)
+    return;
+
+  _data->fillRows(request);
+  _data->_fillRequest = -1;
+  if (_data->_fillMerge)
+    _data->_list->populate(_data->_snapshotFields, _data->_snapshotRows, _data->_fillItemId,
+                           _data->_useAltId, XTreeWidget::Merge);
+  if (_data->_snapshotOverflow || _data->_snapshotRows.size() > SNAPSHOTROWS)
+  {
+    _data->_snapshotFields = QSqlRecord();
+    _data->_snapshotRows.clear();
+  }
   else
-    disconnect(omfgThis, SIGNAL(tick()), this, SLOT(sFillList()));
+    _data->_snapshotValid = true;
+  _data->_list->hideProgress();
+  emit fillListAfter();
+}
+
+void display::sFillFailed(int request, const QString &msg)
+{
+  if (request != _data->_fillRequest)
+    return;
+
+  _data->_fillRequest = -1;
+  _data->_snapshotRows.clear();
+  _data->_list->hideProgress();
+  systemError(this, msg, __FILE__, __LINE__);
+}
+
+/*! Start running the query sFillList() would run with the display's
+    current parameters on one of a few background connections shared by
+    all displays, and keep the result. If sFillList() is called with the
+    same parameters later, the list is filled from that result, or from
+    the query still running, instead of querying again. This lets a
+    window with several displays fill the ones the user hasn't looked at
+    yet while they're busy with the first.
+
+    Returns false if setParams() rejects the current parameters.
+ */
+bool display::prefetch()
+{
+  ParameterList params;
+  if (! setParams(params))
+    return false;
+
+  bool ok = true;
+  QString errorString;
+  QSharedPointer<MetaSQLQuery> mql = MetaSQLCache::instance()->query(_data->metasqlGroup, _data->metasqlName, errorString, &ok);
+  if (! ok)
+    return false;
+
+  QString source = mql->getSource();
+  for (int i = 0; i < _data->_prefetched.size(); i++)
+    if (_data->_prefetched.at(i).source == source &&
+        sameParams(_data->_prefetched.at(i).params, params) &&
+        _data->_prefetched.at(i).age.elapsed() <= PREFETCHAGE)
+      return true;
+  if ((_data->_prefetchThread || _prefetchQueue.contains(this)) &&
+      _data->_prefetching.source == source && sameParams(_data->_prefetching.params, params))
+    return true;
+
+  foreach (QueryThread *thread, prefetchThreads())
+  {
+    connect(thread, SIGNAL(rowsReady(int)),     this, SLOT(sPrefetchRowsReady(int)), Qt::UniqueConnection);
+    connect(thread, SIGNAL(queryFinished(int)), this, SLOT(sPrefetchFinished(int)),  Qt::UniqueConnection);
+    connect(thread, SIGNAL(queryFailed(int, const QString &)),
+            this,   SLOT(sPrefetchFailed(int, const QString &)), Qt::UniqueConnection);
+  }
+
+  _data->releasePrefetch();
+  _data->_prefetching.source = source;
+  _data->_prefetching.params = params;
+  _data->_prefetching.fields = QSqlRecord();
+  _data->_prefetching.rows.clear();
+  _prefetchQueue.append(this);
+  displayPrivate::startPrefetches();
+  return true;
+}
+
+/*! Forget any prefetched results and stop the prefetch in progress.
+ */
+void display::clearPrefetch()
+{
+  _data->releasePrefetch();
+  _data->_prefetched.clear();
+  _data->_prefetchAdopt = false;
+  displayPrivate::startPrefetches();
+}
+
+void display::sPrefetchRowsReady(int request)
+{
+  QueryThread *thread = qobject_cast<QueryThread*>(sender());
+  if (! thread || thread != _data->_prefetchThread || request != _data->_prefetchRequest)
+    return;
+
+  QSqlRecord          fields;
+  QList<QVariantList> rows;
+  if (thread->takeRows(request, fields, rows))
+  {
+    _data->_prefetching.fields = fields;
+    _data->_prefetching.rows  += rows;
+  }
+}
+
+void display::sPrefetchFinished(int request)
+{
+  QueryThread *thread = qobject_cast<QueryThread*>(sender());
+  if (! thread || thread != _data->_prefetchThread || request != _data->_prefetchRequest)
+    return;
+
+  sPrefetchRowsReady(request);
+  _prefetchBusy.remove(thread);
+  _data->_prefetchThread  = 0;
+  _data->_prefetchRequest = -1;
+
+  if (DEBUG)
+    qDebug("display::sPrefetchFinished() %s.%s %d rows in %d ms",
+           qPrintable(_data->metasqlGroup), qPrintable(_data->metasqlName),
+           _data->_prefetching.rows.size(), _data->_prefetching.age.elapsed());
+
+  _data->_prefetching.age.start();
+  _data->_prefetched.prepend(_data->_prefetching);
+  while (_data->_prefetched.size() > PREFETCHCACHE)
+    _data->_prefetched.removeLast();
+  _data->_prefetching.rows.clear();
+
+  displayPrivate::startPrefetches();
+
+  if (_data->_prefetchAdopt)
+  {
+    _data->_prefetchAdopt = false;
+    _data->_fillAnnounced = true;   // sFillList() emitted fillListBefore() when it started waiting
+    _data->_list->hideProgress();
+    sFillList();
+    _data->_fillAnnounced = false;  // in case a subclass's sFillList() didn't get that far
+  }
+}
+
+void display::sPrefetchFailed(int request, const QString &msg)
+{
+  QueryThread *thread = qobject_cast<QueryThread*>(sender());
+  if (! thread || thread != _data->_prefetchThread || request != _data->_prefetchRequest)
+    return;
+
+  if (DEBUG)
+    qDebug("display::sPrefetchFailed() %s.%s %s",
+           qPrintable(_data->metasqlGroup), qPrintable(_data->metasqlName),
+           qPrintable(msg));
+
+  _prefetchBusy.remove(thread);
+  _data->_prefetchThread  = 0;
+  _data->_prefetchRequest = -1;
+  _data->_prefetching.rows.clear();
+  _data->_prefetching.source.clear();
+  displayPrivate::startPrefetches();
+
+  // let the real query report the error if anybody is waiting for it
+  if (_data->_prefetchAdopt)
+  {
+    _data->_prefetchAdopt = false;
+    _data->_fillAnnounced = true;   // sFillList() emitted fillListBefore() when it started waiting
+    _data->_list->hideProgress();
+    sFillList();
+    _data->_fillAnnounced = false;  // in case a subclass's sFillList() didn't get that far
+  }
 }
 
 ParameterList display::getParams()
@@ -33,6 +33,8 @@ public:
     Q_INVOKABLE void setReportName(const QString &);
     Q_INVOKABLE QString reportName() const;
     Q_INVOKABLE void setMetaSQLOptions(const QString &, const QString &);
+    Q_INVOKABLE QString metaSQLGroup() const;
+    Q_INVOKABLE QString metaSQLName() const;
     Q_INVOKABLE void setListLabel(const QString &);
 
     Q_INVOKABLE void setUseAltId(bool);
@@ -56,6 +58,12 @@ public:
     Q_INVOKABLE void setAutoUpdateEnabled(bool);
     Q_INVOKABLE bool autoUpdateEnabled() const;
 
+    Q_INVOKABLE void setAsyncFillEnabled(bool);
+    Q_INVOKABLE bool asyncFillEnabled() const;
+
+    Q_INVOKABLE bool prefetch();
+    Q_INVOKABLE void clearPrefetch();
+
     Q_INVOKABLE XTreeWidget * list();
     Q_INVOKABLE ParameterWidget * parameterWidget();
     Q_INVOKABLE QWidget * optionsWidget();
@@ -91,6 +99,16 @@ protected:
 protected slots:
     virtual void languageChange();
     virtual void sAutoUpdateToggled();
+    virtual void sCancelFill();
+
+private slots:
+    void sAutoUpdateTick();
+    void sFillRowsReady(int);
+    void sFillFinished(int);
+    void sFillFailed(int, const QString &);
+    void sPrefetchRowsReady(int);
+    void sPrefetchFinished(int);
+    void sPrefetchFailed(int, const QString &);
 
 signals:
     void fillList();
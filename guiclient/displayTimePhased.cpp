@@ -14,8 +14,12 @@
 #include <QSqlError>
 #include <QMessageBox>
 
+#include <metasql.h>
 #include <parameter.h>
 
+#include "metasqlcache.h"
+#include "timePhasedBuckets.h"
+
 
 class displayTimePhasedPrivate : public Ui::displayTimePhased
 {
@@ -24,9 +28,13 @@ public:
   {
     setupUi(_parent->display::optionsWidget());
     _baseColumns = -1;
+    _bucketOptions = TimePhasedBuckets::NoOptions;
+    _numericRole = "qty";
   }
 
   int _baseColumns;
+  int _bucketOptions;
+  QString _numericRole;
 
 private:
   ::displayTimePhased * _parent;
@@ -40,6 +48,10 @@ displayTimePhased::displayTimePhased(QWidget* parent, const char* name, Qt::Wind
   connect(_data->_calendar, SIGNAL(newCalendarId(int)), _data->_periods, SLOT(populate(int)));
   connect(_data->_calendar, SIGNAL(select(ParameterList&)), _data->_periods, SLOT(load(ParameterList&)));
 
+  /* a wide horizon means many bucket columns, so only format the cells
+     that are scrolled into view */
+  list()->setResultSetBacked(true);
+
   _column = 0;
 }
 
@@ -89,8 +101,27 @@ void displayTimePhased::setBaseColumns(int columns)
   _data->_baseColumns = columns;
 }
 
+/*! Choose what TimePhasedBuckets::loadList() adds to the result before
+    it's shown: a Total column, running totals or hiding empty rows. The
+    line total is formatted with \a numericRole.
+ */
+void displayTimePhased::setBucketOptions(int options, const QString &numericRole)
+{
+  _data->_bucketOptions = options;
+  _data->_numericRole = numericRole;
+}
+
+int displayTimePhased::bucketOptions() const
+{
+  return _data->_bucketOptions;
+}
+
+/* the periods become bucket columns, and the result is read in one pass
+   through TimePhasedBuckets so totals and hidden rows are worked out on
+   the client instead of in another query */
 void displayTimePhased::sFillList()
 {
+  emit fillListBefore();
   ParameterList params;
   if(!setParams(params))
     return;
@@ -98,12 +129,14 @@ void displayTimePhased::sFillList()
   if(_data->_baseColumns == -1)
     _data->_baseColumns = list()->columnCount();
 
+  int itemid = list()->id();
   list()->clear();
   list()->setColumnCount(_data->_baseColumns);
 
   _columnDates.clear();
   _column = 0;
 
+  QStringList bucketnames;
   QList<XTreeWidgetItem*> selected = _data->_periods->selectedItems();
   for (int i = 0; i < selected.size(); i++)
   {
@@ -111,8 +144,37 @@ void displayTimePhased::sFillList()
     QString bucketname = QString("bucket_%1").arg(cursor->id());
     list()->addColumn(formatDate(cursor->startDate()), _qtyColumn, Qt::AlignRight, true, bucketname);
     _columnDates.append(DatePair(cursor->startDate(), cursor->endDate()));
+    bucketnames << bucketname;
   }
 
-  display::sFillList();
+  if (_data->_bucketOptions & TimePhasedBuckets::LineTotal)
+  {
+    list()->addColumn(tr("Total"), _qtyColumn, Qt::AlignRight, true, "linetotal");
+    _columnDates.append(DatePair());
+  }
+
+  bool ok = true;
+  QString errorString;
+  QSharedPointer<MetaSQLQuery> mql = MetaSQLCache::instance()->query(metaSQLGroup(), metaSQLName(), errorString, &ok);
+  if(!ok)
+  {
+    systemError(this, errorString, __FILE__, __LINE__);
+    return;
+  }
+
+  XSqlQuery xq = mql->toQuery(params);
+  if (xq.lastError().type() != QSqlError::NoError)
+  {
+    systemError(this, xq.lastError().databaseText(), __FILE__, __LINE__);
+    return;
+  }
+
+  QSqlRecord          fields;
+  QList<QVariantList> rows;
+  TimePhasedBuckets   buckets;
+  buckets.loadList(xq, bucketnames, _data->_bucketOptions, fields, rows, _data->_numericRole);
+  list()->populate(fields, rows, itemid, useAltId());
+
+  emit fillListAfter();
 }
 
@@ -36,6 +36,8 @@ protected:
     Q_INVOKABLE QWidget * optionsWidget();
     virtual bool setParamsTP(ParameterList &) = 0;
     virtual void setBaseColumns(int);
+    virtual void setBucketOptions(int, const QString & = QString("qty"));
+    int bucketOptions() const;
 
     int _column;
     QList<DatePair> _columnDates;
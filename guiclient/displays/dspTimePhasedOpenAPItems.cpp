@@ -18,6 +18,7 @@
 
 #include <metasql.h>
 #include "mqlutil.h"
+#include "timePhasedBuckets.h"
 
 #include <datecluster.h>
 
@@ -33,6 +34,8 @@ dspTimePhasedOpenAPItems::dspTimePhasedOpenAPItems(QWidget* parent, const char*,
 
   connect(_custom, SIGNAL(toggled(bool)), this, SLOT(sToggleCustom()));
 
+  list()->setResultSetBacked(true);
+
   _asOf->setDate(omfgThis->dbDate(), true);
   sToggleCustom();
 
@@ -170,7 +173,7 @@ void dspTimePhasedOpenAPItems::sFillCustom()
   list()->setColumnCount(2);
 
   QString sql("SELECT vend_id, vend_number, vend_name");
-  QStringList linetotal;
+  QStringList bucketnames;
 
   int columns = 1;
   QList<XTreeWidgetItem*> selected = _periods->selectedItems();
@@ -187,16 +190,12 @@ void dspTimePhasedOpenAPItems::sFillCustom()
 
     list()->addColumn(formatDate(cursor->startDate()), _bigMoneyColumn, Qt::AlignRight, true, bucketname);
     _columnDates.append(DatePair(cursor->startDate(), cursor->endDate()));
-    linetotal << QString("openAPItemsValue(vend_id, %1)").arg(cursor->id());
+    bucketnames << bucketname;
   }
 
   list()->addColumn(tr("Total"), _bigMoneyColumn, Qt::AlignRight, true, "linetotal");
   _columnDates.append(DatePair());
-  sql += ", " + linetotal.join("+") + " AS linetotal,"
-         " 'curr' AS linetotal_xtnumericrole,"
-         " 0 AS linetotal_xttotalrole,"
-         " (" + linetotal.join("+") + ") = 0.0 AS xthiddenrole "
-         "FROM vendinfo "
+  sql += " FROM vendinfo "
          "<? if exists('vend_id') ?>"
          "WHERE (vend_id=<? value ('vend_id') ?>)"
          "<? elseif exists('vendtype_id') ?>"
@@ -212,12 +211,22 @@ void dspTimePhasedOpenAPItems::sFillCustom()
     return;
 
   dspFillCustom = mql.toQuery(params);
-  list()->populate(dspFillCustom);
   if (dspFillCustom.lastError().type() != QSqlError::NoError)
   {
     systemError(this, dspFillCustom.lastError().databaseText(), __FILE__, __LINE__);
     return;
   }
+
+  /* total each row here instead of asking the server to value every
+     period twice more for the total and the hidden flag */
+  QSqlRecord          fields;
+  QList<QVariantList> rows;
+  TimePhasedBuckets   buckets;
+  buckets.loadList(dspFillCustom, bucketnames,
+                   TimePhasedBuckets::LineTotal | TimePhasedBuckets::HideZeroRows,
+                   fields, rows, "curr");
+
+  list()->populate(fields, rows, list()->id());
 }
 
 void dspTimePhasedOpenAPItems::sFillStd()
@@ -18,6 +18,7 @@
 
 #include <metasql.h>
 #include "mqlutil.h"
+#include "timePhasedBuckets.h"
 
 #include <datecluster.h>
 
@@ -36,6 +37,8 @@ dspTimePhasedOpenARItems::dspTimePhasedOpenARItems(QWidget* parent, const char*,
   list()->addColumn(tr("Cust. #"),  _orderColumn, Qt::AlignLeft, true, "araging_cust_number" );
   list()->addColumn(tr("Customer"), -1,          Qt::AlignLeft, true, "araging_cust_name" );
   
+  list()->setResultSetBacked(true);
+
   _asOf->setDate(omfgThis->dbDate(), true);
   sToggleCustom();
 
@@ -185,7 +188,7 @@ void dspTimePhasedOpenARItems::sFillCustom()
   list()->setColumnCount(2);
 
   QString sql("SELECT cust_id, cust_number, cust_name");
-  QStringList linetotal;
+  QStringList bucketnames;
 
   int columns = 1;
   QList<XTreeWidgetItem*> selected = _periods->selectedItems();
@@ -202,16 +205,12 @@ void dspTimePhasedOpenARItems::sFillCustom()
 
     list()->addColumn(formatDate(cursor->startDate()), _bigMoneyColumn, Qt::AlignRight, true, bucketname);
     _columnDates.append(DatePair(cursor->startDate(), cursor->endDate()));
-    linetotal << QString("openARItemsValue(cust_id, %2)").arg(cursor->id());
+    bucketnames << bucketname;
   }
 
   list()->addColumn(tr("Total"), _bigMoneyColumn, Qt::AlignRight, true, "linetotal");
 
-  sql += ", " + linetotal.join("+") + " AS linetotal,"
-         " 'curr' AS linetotal_xtnumericrole,"
-         " 0 AS linetotal_xttotalrole,"
-         " (" + linetotal.join("+") + ") = 0.0 AS xthiddenrole "
-         "FROM custinfo LEFT OUTER JOIN custgrpitem ON (cust_id = custgrpitem_cust_id) "
+  sql += " FROM custinfo LEFT OUTER JOIN custgrpitem ON (cust_id = custgrpitem_cust_id) "
          "<? if exists('cust_id') ?>"
          "WHERE (cust_id=<? value('cust_id') ?>)"
          "<? elseif exists('custtype_id') ?>"
@@ -228,12 +227,22 @@ void dspTimePhasedOpenARItems::sFillCustom()
   if (! setParams(params))
     return;
   dspFillCustom = mql.toQuery(params);
-  list()->populate(dspFillCustom);
   if (dspFillCustom.lastError().type() != QSqlError::NoError)
   {
     systemError(this, dspFillCustom.lastError().databaseText(), __FILE__, __LINE__);
     return;
   }
+
+  /* total each row here instead of asking the server to value every
+     period twice more for the total and the hidden flag */
+  QSqlRecord          fields;
+  QList<QVariantList> rows;
+  TimePhasedBuckets   buckets;
+  buckets.loadList(dspFillCustom, bucketnames,
+                   TimePhasedBuckets::LineTotal | TimePhasedBuckets::HideZeroRows,
+                   fields, rows, "curr");
+
+  list()->populate(fields, rows, list()->id());
 }
 
 void dspTimePhasedOpenARItems::sFillStd()
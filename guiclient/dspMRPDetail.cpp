@@ -26,6 +26,7 @@
 #include "purchaseRequest.h"
 #include "workOrder.h"
 #include "mqlutil.h"
+#include "timePhasedBuckets.h"
 
 dspMRPDetail::dspMRPDetail(QWidget* parent, const char* name, Qt::WFlags fl)
     : XWidget(parent, name, fl)
@@ -231,76 +232,91 @@ void dspMRPDetail::sFillItemsites()
 
 void dspMRPDetail::sFillMRPDetail()
 {
-  XSqlQuery dspFillMRPDetail;
   _mrp->clear();
 
   _mrp->setColumnCount(1);
 
   QList<XTreeWidgetItem*> selected = _periods->selectedItems();
+  QStringList periodIds;
   for (int i = 0; i < selected.size(); i++)
   {
     XTreeWidgetItem *cursor = (XTreeWidgetItem*)selected[i];
     _mrp->addColumn(formatDate(((PeriodListViewItem *)cursor)->startDate()), _qtyColumn, Qt::AlignRight);
+    periodIds.append(QString::number(cursor->id()));
   }
 
-  XTreeWidgetItem *qoh = 0;
-  XTreeWidgetItem *allocations = 0;
-  XTreeWidgetItem *orders = 0;
-  XTreeWidgetItem *availability = 0;
-  XTreeWidgetItem *firmedAllocations = 0;
-  XTreeWidgetItem *firmedOrders = 0;
-  XTreeWidgetItem *firmedAvailability = 0;
-  double        runningAvailability = 0.0;
-  double	runningFirmed = 0.0;
-  int           counter = 0;
+  if (selected.isEmpty() || _itemsite->id() == -1)
+    return;
 
-  for (int i = 0; i < selected.size(); i++)
+  /* one record per selected period, all in a single round trip, instead
+     of running the detail query once for each period */
+  XSqlQuery dspFillMRPDetail;
+  dspFillMRPDetail.prepare("SELECT seq, itemsite_qtyonhand,"
+                           "       qtyAllocated(itemsite_id, findPeriodStart(period_id), findPeriodEnd(period_id)) AS allocations,"
+                           "       qtyOrdered(itemsite_id, findPeriodStart(period_id), findPeriodEnd(period_id)) AS orders,"
+                           "       qtyFirmedAllocated(itemsite_id, findPeriodStart(period_id), findPeriodEnd(period_id)) AS firmedallocations,"
+                           "       qtyFirmed(itemsite_id, findPeriodStart(period_id), findPeriodEnd(period_id)) AS firmedorders"
+                           "  FROM itemsite,"
+                           "       (SELECT ids[seq] AS period_id, seq"
+                           "          FROM (SELECT ids, generate_subscripts(ids, 1) AS seq"
+                           "                  FROM (SELECT CAST(:period_ids AS INTEGER[]) AS ids) AS list"
+                           "               ) AS numbered"
+                           "       ) AS periods"
+                           " WHERE (itemsite_id=:itemsite_id)"
+                           " ORDER BY seq;");
+  dspFillMRPDetail.bindValue(":period_ids", "{" + periodIds.join(",") + "}");
+  dspFillMRPDetail.bindValue(":itemsite_id", _itemsite->id());
+  dspFillMRPDetail.exec();
+  if (dspFillMRPDetail.lastError().type() != QSqlError::NoError)
   {
-    XTreeWidgetItem *cursor = (XTreeWidgetItem*)selected[i];
-    counter++;
-    ParameterList params;
-    params.append("cursorId", cursor->id());
-    params.append("counter", counter);
-    params.append("itemsite_id", _itemsite->id());
-
-    MetaSQLQuery mql = mqlLoad("mrpDetail", "detail");
-    dspFillMRPDetail = mql.toQuery(params);
-    if (dspFillMRPDetail.first())
-    {
-      if (counter == 1)
-      {
-        runningFirmed = dspFillMRPDetail.value("firmedorders1").toDouble();
-        runningAvailability = (dspFillMRPDetail.value("itemsite_qtyonhand").toDouble() - dspFillMRPDetail.value("allocations1").toDouble() + dspFillMRPDetail.value("orders1").toDouble());
-
-        qoh                = new XTreeWidgetItem(_mrp, 0, QVariant(tr("Projected QOH")), dspFillMRPDetail.value("f_qoh"));
-        allocations        = new XTreeWidgetItem(_mrp, qoh, 0, QVariant(tr("Allocations")), formatQty(dspFillMRPDetail.value("allocations1").toDouble()));
-        orders             = new XTreeWidgetItem(_mrp, allocations,  0, QVariant(tr("Orders")), formatQty(dspFillMRPDetail.value("orders1").toDouble()));
-        availability       = new XTreeWidgetItem(_mrp, orders, 0, QVariant(tr("Availability")), formatQty(runningAvailability));
-        firmedAllocations  = new XTreeWidgetItem(_mrp, availability, 0, QVariant(tr("Firmed Allocations")), formatQty(dspFillMRPDetail.value("firmedallocations1").toDouble()));
-        firmedOrders       = new XTreeWidgetItem(_mrp, firmedAllocations, 0, QVariant(tr("Firmed Orders")), formatQty(runningFirmed));
-        firmedAvailability = new XTreeWidgetItem(_mrp, firmedOrders, 0, QVariant(tr("Firmed Availability")), formatQty( runningAvailability -
-                                                                                                            dspFillMRPDetail.value("firmedallocations1").toDouble() +
-                                                                                                            runningFirmed ) );
-      }
-      else
-      {
-        qoh->setText(counter, formatQty(runningAvailability));
-        allocations->setText(counter, formatQty(dspFillMRPDetail.value(QString("allocations%1").arg(counter)).toDouble()));
-        orders->setText(counter, formatQty(dspFillMRPDetail.value(QString("orders%1").arg(counter)).toDouble()));
+    systemError(this, dspFillMRPDetail.lastError().databaseText(), __FILE__, __LINE__);
+    return;
+  }
 
-        runningAvailability =  ( runningAvailability - dspFillMRPDetail.value(QString("allocations%1").arg(counter)).toDouble() +
-                                                       dspFillMRPDetail.value(QString("orders%1").arg(counter)).toDouble() );
-        availability->setText(counter, formatQty(runningAvailability));
+  TimePhasedBuckets buckets(selected.size());
+  int qoh                = buckets.addRow("qoh");
+  int allocations        = buckets.addRow("allocations");
+  int orders             = buckets.addRow("orders");
+  int availability       = buckets.addRow("availability");
+  int firmedAllocations  = buckets.addRow("firmedallocations");
+  int firmedOrders       = buckets.addRow("firmedorders");
+  int firmedAvailability = buckets.addRow("firmedavailability");
+
+  buckets.load(dspFillMRPDetail, "seq",
+               QStringList() << "itemsite_qtyonhand" << "allocations" << "orders"
+                             << "firmedallocations" << "firmedorders");
+
+  /* each period starts with what the one before it left available */
+  double *qohData          = buckets.rowData(qoh);
+  double *allocData        = buckets.rowData(allocations);
+  double *orderData        = buckets.rowData(orders);
+  double *availData        = buckets.rowData(availability);
+  double *firmedAllocData  = buckets.rowData(firmedAllocations);
+  double *firmedOrderData  = buckets.rowData(firmedOrders);
+  double *firmedAvailData  = buckets.rowData(firmedAvailability);
+  double  runningAvailability = buckets.value(buckets.row("itemsite_qtyonhand"), 0);
+  buckets.accumulate(firmedOrders);
+  for (int b = 0; b < buckets.bucketCount(); b++)
+  {
+    qohData[b]          = runningAvailability;
+    runningAvailability = runningAvailability - allocData[b] + orderData[b];
+    availData[b]        = runningAvailability;
+    firmedAvailData[b]  = runningAvailability - firmedAllocData[b] + firmedOrderData[b];
+  }
 
-        firmedAllocations->setText(counter, formatQty(dspFillMRPDetail.value(QString("firmedallocations%1").arg(counter)).toDouble()));
+  QStringList labels;
+  labels << tr("Projected QOH")      << tr("Allocations")
+         << tr("Orders")             << tr("Availability")
+         << tr("Firmed Allocations") << tr("Firmed Orders")
+         << tr("Firmed Availability");
 
-        runningFirmed += dspFillMRPDetail.value(QString("firmedorders%1").arg(counter)).toDouble();
-        firmedOrders->setText(counter, formatQty(runningFirmed));
-        firmedAvailability->setText(counter, formatQty( runningAvailability -
-                                                              dspFillMRPDetail.value(QString("firmedallocations%1").arg(counter)).toDouble() +
-                                                              runningFirmed ) );
-      }
-    }
+  XTreeWidgetItem *last = 0;
+  for (int r = qoh; r <= firmedAvailability; r++)
+  {
+    last = new XTreeWidgetItem(_mrp, last, 0, QVariant(labels.at(r)));
+    const double *values = buckets.rowData(r);
+    for (int b = 0; b < buckets.bucketCount(); b++)
+      last->setText(b + 1, formatQty(values[b]));
   }
 }
 
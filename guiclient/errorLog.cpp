@@ -8,21 +8,24 @@
  * to be bound by its terms.
  */
 
-#include <stdio.h>
-
 #include "errorLog.h"
 #include "guiclient.h"
 
 #include <QObject>
 #include <QVariant>
 #include <QMessageBox>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
 #include <QStringList>
 #include <QDateTime>
 #include <QSqlError>
 
+#include "messageLog.h"
 #include "xtsettings.h"
 
 static QStringList _errorList;
+static QMutex      _errorListLock;
 static errorLogListener * listener = 0;
 
 void errorLogListener::initialize()
@@ -42,8 +45,13 @@ errorLog::errorLog(QWidget* parent, const char * name, Qt::WFlags flags)
 {
   setupUi(this);
 
-  for(int i = 0; i < _errorList.size(); i++)
-    _errorLog->append(_errorList.at(i));
+  QStringList errors;
+  {
+    QMutexLocker locker(&_errorListLock);
+    errors = _errorList;
+  }
+  for(int i = 0; i < errors.size(); i++)
+    _errorLog->append(errors.at(i));
 
   _debug->setChecked(xtsettingsValue("catchQDebug").toBool());
   _warning->setChecked(xtsettingsValue("catchQWarning").toBool());
@@ -78,21 +86,25 @@ void errorLog::updateErrors(const QString & msg)
 void errorLog::toggleDebug(bool y)
 {
   xtsettingsSetValue("catchQDebug", y);
+  MessageLog::setCaught(QtDebugMsg, y);
 }
 
 void errorLog::toggleWarning(bool y)
 {
   xtsettingsSetValue("catchQWarning", y);
+  MessageLog::setCaught(QtWarningMsg, y);
 }
 
 void errorLog::toggleCritical(bool y)
 {
   xtsettingsSetValue("catchQCritical", y);
+  MessageLog::setCaught(QtCriticalMsg, y);
 }
 
 void errorLog::toggleFatal(bool y)
 {
   xtsettingsSetValue("catchQFatal", y);
+  MessageLog::setCaught(QtFatalMsg, y);
 }
 
 errorLogListener::errorLogListener(QObject * parent)
@@ -106,6 +118,27 @@ errorLogListener::~errorLogListener()
   XSqlQuery::removeErrorListener(this);
 }
 
+/* queries and messages can come from background threads, e.g. a
+   QueryThread, but the error notification button lives in the GUI
+ */
+static void appendError(const QString &msg)
+{
+  QMutexLocker locker(&_errorListLock);
+  _errorList.append(msg);
+  if(_errorList.size() > 20)
+    _errorList.removeFirst();
+}
+
+static void notifyNewError()
+{
+  if(!omfgThis)
+    return;
+  if(QThread::currentThread() == omfgThis->thread())
+    omfgThis->sNewErrorMessage();
+  else
+    QMetaObject::invokeMethod(omfgThis, "sNewErrorMessage", Qt::QueuedConnection);
+}
+
 void errorLogListener::error(const QString & sql, const QSqlError & error)
 {
   QString msg;
@@ -113,58 +146,32 @@ void errorLogListener::error(const QString & sql, const QSqlError & error)
   msg += " " + error.text();
   msg += "\n" + sql;
 
-  _errorList.append(msg);
-  if(_errorList.size() > 20)
-    _errorList.removeFirst();
+  appendError(msg);
 
   emit updated(msg);
-  if(omfgThis)
-    omfgThis->sNewErrorMessage();
+  notifyNewError();
 }
 
 void errorLogListener::clear()
 {
   bool blocked = blockSignals(true);
-  _errorList.clear();
+  {
+    QMutexLocker locker(&_errorListLock);
+    _errorList.clear();
+  }
   (void)blockSignals(blocked);
 }
 
-void xTupleMessageOutput(QtMsgType type, const char *pMsg)
+/* MessageLog hands every message to this on its writer thread, already
+   formatted, with whether the user wants to see that type here */
+void xTupleMessageOutput(QtMsgType type, const QString &msg, bool notify)
 {
-  QString msg;
-  msg = QDateTime::currentDateTime().toString();
-  bool notify = false;
   bool iserror= (type == QtCriticalMsg) || (type == QtFatalMsg);
 
-  switch (type) {
-    case QtDebugMsg:
-      notify = xtsettingsValue("catchQDebug").toBool();
-      msg += " Debug: ";
-      break;
-    case QtWarningMsg:
-      notify = xtsettingsValue("catchQWarning").toBool();
-      msg += " Warning: ";
-      break;
-    case QtCriticalMsg:
-      notify = xtsettingsValue("catchQCritical").toBool();
-      msg += " Critical: ";
-      break;
-    case QtFatalMsg:
-      notify = xtsettingsValue("catchQFatal").toBool();
-      msg += " Fatal: ";
-      //abort();
-      break;
-  }
-  msg += pMsg;
-  _errorList.append(msg);
-  if(_errorList.size() > 20)
-    _errorList.removeFirst();
+  appendError(msg);
 
   if(listener && notify)
     listener->updated(msg);
-  if(omfgThis && notify && iserror)
-    omfgThis->sNewErrorMessage();
-
-  printf("%s\n", qPrintable(msg));
+  if(notify && iserror)
+    notifyNewError();
 }
-
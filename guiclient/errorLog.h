@@ -37,7 +37,7 @@ protected slots:
 
 class errorLogListener : public QObject, public XSqlQueryErrorListener {
   Q_OBJECT
-  friend void xTupleMessageOutput(QtMsgType, const char*);
+  friend void xTupleMessageOutput(QtMsgType, const QString &, bool);
 
   public:
     errorLogListener(QObject * parent = 0);
@@ -10,31 +10,66 @@
 
 #include "getscreen.h"
 
-#define STARTCLASSLIST \
-  if(classname.isEmpty()) \
-    return 0;
-#define ENDCLASSLIST
+#include <QHash>
+
+#include "getscreen_headerlist.h"
+
+#define DEBUG false
+
+/* getscreen_classlist.h is expanded twice: once to write a factory
+   function for every class and once to list those functions by name.
+   the list is turned into a hash the first time a screen is asked for.
+ */
 #define CLASSITEM(cn) \
-  if(classname == #cn) { \
-    w = new cn(parent, #cn, wflags); \
+  static QWidget *xtCreate_##cn(QWidget *parent, Qt::WindowFlags wflags) \
+  { \
+    QWidget *w = new cn(parent, #cn, wflags); \
     w->setObjectName(#cn); \
+    return w; \
   }
-    
-#include "getscreen_headerlist.h"
+#include "getscreen_classlist.h"
+#undef CLASSITEM
 
-QWidget * xtGetScreen(const QString & classname, QWidget * parent, Qt::WindowFlags wflags, const QString & objectname)
+struct xtScreenEntry
 {
-  QWidget * w = 0;
+  const char      *name;
+  xtScreenFactory  factory;
+};
 
-STARTCLASSLIST
+#define CLASSITEM(cn) { #cn, xtCreate_##cn },
+static const xtScreenEntry _builtinScreens[] = {
 #include "getscreen_classlist.h"
-/* Added in as an aliased name */
-  if(classname == "AdatabaseInformation") {
-    w = new databaseInformation(parent, "databaseInformation", wflags);
-    w->setObjectName("databaseInformation");
+  { 0, 0 }
+};
+#undef CLASSITEM
+
+static QHash<QString, xtScreenFactory> &screenRegistry()
+{
+  static QHash<QString, xtScreenFactory> registry;
+  if (registry.isEmpty())
+  {
+    for (int i = 0; _builtinScreens[i].name; i++)
+      registry.insert(QString::fromLatin1(_builtinScreens[i].name),
+                      _builtinScreens[i].factory);
+    /* Added in as an aliased name */
+    registry.insert("AdatabaseInformation", xtCreate_databaseInformation);
+
+    if (DEBUG)
+      qDebug("screenRegistry() %d screens", registry.size());
   }
-ENDCLASSLIST
+  return registry;
+}
 
+QWidget * xtGetScreen(const QString & classname, QWidget * parent, Qt::WindowFlags wflags, const QString & objectname)
+{
+  if(classname.isEmpty())
+    return 0;
+
+  xtScreenFactory factory = screenRegistry().value(classname, 0);
+  if (! factory)
+    return 0;
+
+  QWidget * w = factory(parent, wflags);
   if(w)
   {
     if(!objectname.isEmpty())
@@ -44,3 +79,45 @@ ENDCLASSLIST
   return w;
 }
 
+/*! Make xtGetScreen() build \a classname by calling \a factory, replacing
+    any screen already registered with that name. Returns false if either
+    is empty.
+ */
+bool xtRegisterScreen(const QString &classname, xtScreenFactory factory)
+{
+  if (classname.isEmpty() || ! factory)
+    return false;
+
+  screenRegistry().insert(classname, factory);
+  return true;
+}
+
+/*! Make \a alias open the screen registered as \a classname. Returns
+    false if there is no such screen.
+ */
+bool xtRegisterScreenAlias(const QString &alias, const QString &classname)
+{
+  if (alias.isEmpty())
+    return false;
+
+  xtScreenFactory factory = screenRegistry().value(classname, 0);
+  if (! factory)
+    return false;
+
+  screenRegistry().insert(alias, factory);
+  return true;
+}
+
+bool xtScreenExists(const QString &classname)
+{
+  return screenRegistry().contains(classname);
+}
+
+/*! Return the name of every screen xtGetScreen() can build, sorted.
+ */
+QStringList xtScreenNames()
+{
+  QStringList names = screenRegistry().keys();
+  names.sort();
+  return names;
+}
@@ -11,9 +11,16 @@
 #ifndef __GETSCREEN_H__
 #define __GETSCREEN_H__
 
+#include <QStringList>
 #include <QWidget>
 
+typedef QWidget *(*xtScreenFactory)(QWidget *, Qt::WindowFlags);
+
 QWidget * xtGetScreen(const QString &, QWidget *, Qt::WindowFlags = 0, const QString & = QString::null);
 
-#endif
+bool        xtRegisterScreen(const QString &, xtScreenFactory);
+bool        xtRegisterScreenAlias(const QString &, const QString &);
+bool        xtScreenExists(const QString &);
+QStringList xtScreenNames();
 
+#endif
@@ -42,6 +42,7 @@
 #include <QBuffer>
 #include <QDesktopServices>
 #include <QScriptEngineDebugger>
+#include <QSet>
 
 #include <parameter.h>
 #include <dbtools.h>
@@ -55,6 +56,7 @@
 #include "xmainwindow.h"
 #include "xdialog.h"
 #include "errorLog.h"
+#include "messageLog.h"
 #include "errorReporter.h"
 
 #include "systemMessage.h"
@@ -107,7 +109,7 @@ Metrics       *_metrics=0;
 Preferences   *_preferences=0;
 Privileges    *_privileges=0;
 Metricsenc    *_metricsenc=0;
-QList<QString> _hotkeyList;
+QSet<QString> _hotkeyList;
 
 bool _evaluation;
 
@@ -548,6 +550,7 @@ GUIClient::~GUIClient()
 {
   QApplication::closeAllWindows();
 
+  MessageLog::flush();
   errorLogListener::destroy();
   //omfgThis = 0;
 
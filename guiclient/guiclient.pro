@@ -925,6 +925,7 @@ HEADERS = ../common/format.h                    \
           menuSchedule.h                \
           menuSystem.h                  \
           menuWindow.h                  \
+          messageLog.h                  \
           miscCheck.h                   \
           miscVoucher.h                 \
           openPurchaseOrder.h           \
@@ -1074,6 +1075,7 @@ HEADERS = ../common/format.h                    \
           scrapTrans.h                          \
           scrapWoMaterialFromWIP.h              \
           scriptablePrivate.h                   \
+          scriptcache.h                         \
           scriptEditor.h                        \
           scripts.h                             \
           scripttoolbox.h                       \
@@ -1085,6 +1087,7 @@ HEADERS = ../common/format.h                    \
           selectPayments.h                      \
           selectShippedOrders.h                 \
           selectedPayments.h                    \
+          sessionBootstrap.h                    \
           setup.h                               \
           shipOrder.h                           \
           shipTo.h                              \
@@ -1143,6 +1146,7 @@ HEADERS = ../common/format.h                    \
           termses.h                     \
           thawItemSitesByClassCode.h    \
           timeoutHandler.h              \
+          timePhasedBuckets.h           \
           todoCalendarControl.h         \
           todoItem.h                    \
           todoList.h                    \
@@ -1533,6 +1537,7 @@ SOURCES = absoluteCalendarItem.cpp              \
           menuSchedule.cpp              \
           menuSystem.cpp                \
           menuWindow.cpp                \
+          messageLog.cpp                \
           miscCheck.cpp                 \
           miscVoucher.cpp               \
           openPurchaseOrder.cpp         \
@@ -1682,6 +1687,7 @@ SOURCES = absoluteCalendarItem.cpp              \
           scrapTrans.cpp                        \
           scrapWoMaterialFromWIP.cpp            \
           scriptablePrivate.cpp                 \
+          scriptcache.cpp                       \
           scriptEditor.cpp                      \
           scripts.cpp                           \
           scripttoolbox.cpp                     \
@@ -1693,6 +1699,7 @@ SOURCES = absoluteCalendarItem.cpp              \
           selectPayments.cpp                    \
           selectShippedOrders.cpp               \
           selectedPayments.cpp                  \
+          sessionBootstrap.cpp                  \
           setup.cpp                             \
           shipOrder.cpp                         \
           shipTo.cpp                            \
@@ -1751,6 +1758,7 @@ SOURCES = absoluteCalendarItem.cpp              \
           termses.cpp                           \
           thawItemSitesByClassCode.cpp          \
           timeoutHandler.cpp                    \
+          timePhasedBuckets.cpp                 \
           todoCalendarControl.cpp               \
           todoItem.cpp                          \
           todoList.cpp                          \
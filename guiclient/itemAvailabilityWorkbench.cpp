@@ -10,7 +10,9 @@
 
 #include "itemAvailabilityWorkbench.h"
 
+#include <QAbstractButton>
 #include <QCloseEvent>
+#include <QPair>
 #include <QMessageBox>
 #include <QSqlError>
 #include <QVariant>
@@ -322,6 +324,43 @@ void itemAvailabilityWorkbench::populate()
   _itemMaster->findChild<QWidget*>("_sold")->setEnabled(false);
   
   sFillList();
+  sPrefetch();
+}
+
+/* start the queries for the displays the user can see but isn't looking
+   at yet on the shared background connections, so flipping to them later
+   shows the rows without waiting. prices by customer needs a customer so
+   it's left alone.
+ */
+void itemAvailabilityWorkbench::sPrefetch()
+{
+  if (!_metrics->boolean("ItemWorkbenchPrefetch") || !_item->isValid())
+    return;
+
+  QList<QPair<display*, QAbstractButton*> > pages;
+  if (_tab->indexOf(_availabilityTab) >= 0)
+    pages << qMakePair((display*)_dspInventoryAvailability, (QAbstractButton*)_availabilityButton)
+          << qMakePair((display*)_dspRunningAvailability,   (QAbstractButton*)_runningAvailabilityButton)
+          << qMakePair((display*)_dspInventoryLocator,      (QAbstractButton*)_locationDetailButton);
+  if (_tab->indexOf(_bomTab) >= 0)
+    pages << qMakePair((display*)_dspCostedIndentedBOM,    (QAbstractButton*)_costedIndentedBOMButton)
+          << qMakePair((display*)_dspSingleLevelWhereUsed, (QAbstractButton*)_whereUsedButton);
+  if (_tab->indexOf(_historyTab) >= 0)
+    pages << qMakePair((display*)_dspInventoryHistory,       (QAbstractButton*)_inventoryHistoryButton)
+          << qMakePair((display*)_dspPoItemReceivingsByItem, (QAbstractButton*)_receivingHistoryButton)
+          << qMakePair((display*)_dspSalesHistory,           (QAbstractButton*)_salesHistoryButton);
+  if (_tab->indexOf(_ordersTab) >= 0)
+    pages << qMakePair((display*)_dspPoItemsByItem,     (QAbstractButton*)_purchaseOrderItemsButton)
+          << qMakePair((display*)_dspSalesOrdersByItem, (QAbstractButton*)_salesOrderItemsButton)
+          << qMakePair((display*)_dspQuotesByItem,      (QAbstractButton*)_quoteItemsButton);
+
+  for (int i = 0; i < pages.size(); i++)
+  {
+    display *page = pages.at(i).first;
+    if (pages.at(i).second->isHidden() || page->isVisible())
+      continue;
+    page->prefetch();
+  }
 }
 
 void itemAvailabilityWorkbench::sFillList()
@@ -45,6 +45,7 @@ public slots:
     virtual void populate();
     virtual void sFillList();
     virtual void sHandleButtons();
+    virtual void sPrefetch();
 
 protected slots:
     virtual void languageChange();
@@ -122,6 +122,8 @@
 #include "splashconst.h"
 #include "xtsettings.h"
 #include "welcomeStub.h"
+#include "sessionBootstrap.h"
+#include "messageLog.h"
 
 #include <QtPlugin>
 Q_IMPORT_PLUGIN(xTuplePlugin)
@@ -130,7 +132,7 @@ QString __password;
 
 #define DEBUG false
 
-extern void xTupleMessageOutput(QtMsgType type, const char *msg);
+extern void xTupleMessageOutput(QtMsgType type, const QString &msg, bool notify);
 
 // helps determine which edition we're running & what splash screen to present
 struct editionDesc {
@@ -163,12 +165,14 @@ int main(int argc, char *argv[])
   bool    havePasswd      = false;
   bool    forceWelcomeStub= false;
 
-  qInstallMsgHandler(xTupleMessageOutput);
+  MessageLog::install(xTupleMessageOutput);
+  StartupTimer::start();
   QApplication app(argc, argv);
   app.setOrganizationDomain("xTuple.com");
   app.setOrganizationName("xTuple");
   app.setApplicationName("xTuple");
   app.setApplicationVersion(_Version);
+  MessageLog::loadSettings();
 
 #if QT_VERSION >= 0x040400
   // This is the correct place for this call but on versions less
@@ -288,6 +292,7 @@ int main(int argc, char *argv[])
       }
     }
   }
+  StartupTimer::phase("login");
 
   // TODO: can/should we compose the splash screen on the fly from parts?
   QList<editionDesc> edition;
@@ -496,6 +501,8 @@ int main(int argc, char *argv[])
     }
   }
 
+  StartupTimer::phase("edition and license checks");
+
   bool disallowMismatch = false;
   bool shouldCheckForUpdates = false;
   metric.exec("SELECT metric_value"
@@ -558,43 +565,72 @@ int main(int argc, char *argv[])
     }
   }
 
+  StartupTimer::phase("version check");
+
+  // read the metrics, preferences, privileges, locale, and packages in
+  // one round trip, or one piece at a time if that fails
   _splash->showMessage(QObject::tr("Loading Database Metrics"), SplashTextAlignment, SplashTextColor);
   qApp->processEvents();
-  _metrics = new Metrics();
+  SessionBootstrap bootstrap;
+  bootstrap.load(username);
+  StartupTimer::phase("session bootstrap");
+
+  if (bootstrap.isLoaded())
+    _metrics = new Metrics(bootstrap.metrics());
+  else
+    _metrics = new Metrics();
 
   _splash->showMessage(QObject::tr("Loading User Preferences"), SplashTextAlignment, SplashTextColor);
   qApp->processEvents();
-  _preferences = new Preferences(username);
+  if (bootstrap.isLoaded())
+    _preferences = new Preferences(username, bootstrap.preferences());
+  else
+    _preferences = new Preferences(username);
 
   _splash->showMessage(QObject::tr("Loading User Privileges"), SplashTextAlignment, SplashTextColor);
   qApp->processEvents();
-  _privileges = new Privileges();
+  if (bootstrap.isLoaded())
+    _privileges = new Privileges(bootstrap.effectiveUser(), bootstrap.privileges());
+  else
+    _privileges = new Privileges();
+  StartupTimer::phase("metrics, preferences and privileges");
 
   // Load the translator and set the locale from the User's preferences
   _splash->showMessage(QObject::tr("Loading Translation Dictionary"), SplashTextAlignment, SplashTextColor);
   qApp->processEvents();
-  XSqlQuery langq("SELECT * "
-                  "FROM usr, locale LEFT OUTER JOIN"
-                  "     lang ON (locale_lang_id=lang_id) LEFT OUTER JOIN"
-                  "     country ON (locale_country_id=country_id) "
-                  "WHERE ( (usr_username=getEffectiveXtUser())"
-                  " AND (usr_locale_id=locale_id) );" );
-  if (langq.first())
+  QSqlRecord locale;
+  XSqlQuery  langq;
+  if (bootstrap.isLoaded())
+    locale = bootstrap.locale();
+  else
+  {
+    langq.exec("SELECT * "
+               "FROM usr, locale LEFT OUTER JOIN"
+               "     lang ON (locale_lang_id=lang_id) LEFT OUTER JOIN"
+               "     country ON (locale_country_id=country_id) "
+               "WHERE ( (usr_username=getEffectiveXtUser())"
+               " AND (usr_locale_id=locale_id) );" );
+    if (langq.first())
+      locale = langq.record();
+  }
+  if (! locale.isEmpty())
   {
+    setFormatLocale(locale);
+
     QStringList files;
-    if (!langq.value("locale_lang_file").toString().isEmpty())
-      files << langq.value("locale_lang_file").toString();
+    if (!locale.value("locale_lang_file").toString().isEmpty())
+      files << locale.value("locale_lang_file").toString();
 
     QString langext;
-    if (!langq.value("lang_abbr2").toString().isEmpty() && 
-        !langq.value("country_abbr").toString().isEmpty())
+    if (!locale.value("lang_abbr2").toString().isEmpty() && 
+        !locale.value("country_abbr").toString().isEmpty())
     {
-      langext = langq.value("lang_abbr2").toString() + "_" +
-                langq.value("country_abbr").toString().toLower();
+      langext = locale.value("lang_abbr2").toString() + "_" +
+                locale.value("country_abbr").toString().toLower();
     }
-    else if (!langq.value("lang_abbr2").toString().isEmpty())
+    else if (!locale.value("lang_abbr2").toString().isEmpty())
     {
-      langext = langq.value("lang_abbr2").toString();
+      langext = locale.value("lang_abbr2").toString();
     }
 
     if(!langext.isEmpty())
@@ -604,11 +640,16 @@ int main(int argc, char *argv[])
       files << "openrpt";
       files << "reports";
 
-      XSqlQuery pkglist("SELECT pkghead_name"
-                        "  FROM pkghead"
-                        " WHERE packageIsEnabled(pkghead_name);");
-      while(pkglist.next())
-        files << pkglist.value("pkghead_name").toString();
+      if (bootstrap.isLoaded())
+        files << bootstrap.packages();
+      else
+      {
+        XSqlQuery pkglist("SELECT pkghead_name"
+                          "  FROM pkghead"
+                          " WHERE packageIsEnabled(pkghead_name);");
+        while(pkglist.next())
+          files << pkglist.value("pkghead_name").toString();
+      }
     }
 
     if (files.size() > 0)
@@ -643,20 +684,20 @@ int main(int argc, char *argv[])
     /* set the locale to langabbr_countryabbr, langabbr, {lang# country#}, or
        lang#, depending on what information is available
      */
-    QString langAbbr = langq.value("lang_abbr2").toString();
-    QString cntryAbbr = langq.value("country_abbr").toString().toUpper();
+    QString langAbbr = locale.value("lang_abbr2").toString();
+    QString cntryAbbr = locale.value("country_abbr").toString().toUpper();
     if(cntryAbbr == "UK")
       cntryAbbr = "GB";
     if (! langAbbr.isEmpty() &&
         ! cntryAbbr.isEmpty())
       QLocale::setDefault(QLocale(langAbbr + "_" + cntryAbbr));
     else if (! langAbbr.isEmpty())
-      QLocale::setDefault(QLocale(langq.value("lang_abbr2").toString()));
-    else if (langq.value("lang_qt_number").toInt() &&
-             langq.value("country_qt_number").toInt())
+      QLocale::setDefault(QLocale(locale.value("lang_abbr2").toString()));
+    else if (locale.value("lang_qt_number").toInt() &&
+             locale.value("country_qt_number").toInt())
       QLocale::setDefault(
-          QLocale(QLocale::Language(langq.value("lang_qt_number").toInt()),
-                  QLocale::Country(langq.value("country_qt_number").toInt())));
+          QLocale(QLocale::Language(locale.value("lang_qt_number").toInt()),
+                  QLocale::Country(locale.value("country_qt_number").toInt())));
     else
       QLocale::setDefault(QLocale::system());
 
@@ -670,6 +711,8 @@ int main(int argc, char *argv[])
     systemError(0, langq.lastError().databaseText(), __FILE__, __LINE__);
   }
 
+  StartupTimer::phase("translations and locale");
+
   qApp->processEvents();
   QString key;
 
@@ -721,6 +764,7 @@ int main(int argc, char *argv[])
   omfgThis = 0;
   omfgThis = new GUIClient(databaseURL, username);
   omfgThis->_key = key;
+  StartupTimer::phase("main window and menus");
 
   if (key.length() > 0) {
 	_splash->showMessage(QObject::tr("Loading Database Encryption Metrics"), SplashTextAlignment, SplashTextColor);
@@ -729,12 +773,20 @@ int main(int argc, char *argv[])
   }
   
   initializePlugin(_preferences, _metrics, _privileges, omfgThis->username(), omfgThis->workspace());
+  StartupTimer::phase("encryption metrics and widget plugin");
 
 // START code for updating the locale settings if they haven't been already
   XSqlQuery lc;
-  lc.exec("SELECT count(*) FROM metric WHERE metric_name='AutoUpdateLocaleHasRun';");
-  lc.first();
-  if(lc.value(0).toInt() == 0)
+  bool localeHasRun;
+  if (bootstrap.isLoaded())
+    localeHasRun = bootstrap.metrics().contains("AutoUpdateLocaleHasRun");
+  else
+  {
+    lc.exec("SELECT count(*) FROM metric WHERE metric_name='AutoUpdateLocaleHasRun';");
+    lc.first();
+    localeHasRun = lc.value(0).toInt() != 0;
+  }
+  if(!localeHasRun)
   {
     lc.exec("INSERT INTO metric (metric_name, metric_value) values('AutoUpdateLocaleHasRun', 't');");
     lc.exec("SELECT locale_id from locale;");
@@ -754,6 +806,7 @@ int main(int argc, char *argv[])
   if (omfgThis->_singleWindow.isEmpty())
   {
     omfgThis->setAttribute(Qt::WA_DeleteOnClose);
+    StartupTimer::finishOnFirstPaint(omfgThis);
     omfgThis->show();
   }
   // keep this synchronized with GUIClient and user.ui.h
@@ -785,32 +838,35 @@ int main(int argc, char *argv[])
   // be selected or created
   XSqlQuery baseCurrency;
   baseCurrency.prepare("SELECT COUNT(*) AS count FROM curr_symbol WHERE curr_base=TRUE;");
-  baseCurrency.exec();
-  if(baseCurrency.first())
+  if (bootstrap.baseCurrencyCount() != 1)    // not known to be set up yet
   {
-    if(baseCurrency.value("count").toInt() != 1)
+    baseCurrency.exec();
+    if(baseCurrency.first())
     {
-      currenciesDialog newdlg(0, "", TRUE);
-      newdlg.exec();
-      baseCurrency.exec();
-      if(baseCurrency.first())
+      if(baseCurrency.value("count").toInt() != 1)
       {
-        if(baseCurrency.value("count").toInt() != 1)
+        currenciesDialog newdlg(0, "", TRUE);
+        newdlg.exec();
+        baseCurrency.exec();
+        if(baseCurrency.first())
+        {
+          if(baseCurrency.value("count").toInt() != 1)
+            return -1;
+        }
+        else
+        {
+          systemError(0, baseCurrency.lastError().databaseText(), __FILE__, __LINE__);
+          // need to figure out appropriate return code for this...unusual error
           return -1;
-      }
-      else
-      {
-        systemError(0, baseCurrency.lastError().databaseText(), __FILE__, __LINE__);
-        // need to figure out appropriate return code for this...unusual error
-        return -1;
+        }
       }
     }
-  }
-  else
-  {
-    systemError(0, baseCurrency.lastError().databaseText(), __FILE__, __LINE__);
-    // need to figure out appropriate return code for this...unusual error
-    return -1;
+    else
+    {
+      systemError(0, baseCurrency.lastError().databaseText(), __FILE__, __LINE__);
+      // need to figure out appropriate return code for this...unusual error
+      return -1;
+    }
   }
 
   if(!omfgThis->singleCurrency() &&
@@ -0,0 +1,353 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include <stdio.h>
+
+#include "messageLog.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QVariant>
+
+#include "xtsettings.h"
+
+#define DEBUG false
+
+/* how many messages can wait for the writer before new ones are dropped */
+#define RING_SIZE 4096
+
+static MessageLog       *_log  = 0;
+static MessageLog::Sink  _sink = 0;
+static volatile int      _level = QtDebugMsg;
+static volatile bool     _caught[QtFatalMsg + 1] = { false, false, false, false };
+
+static const char *_prefix[QtFatalMsg + 1] = {
+  " Debug: ", " Warning: ", " Critical: ", " Fatal: "
+};
+
+int MessageLog::_enabled = 0xF;
+
+MessageLog::MessageLog()
+  : QThread(),
+    _ring(RING_SIZE),
+    _head(0),
+    _count(0),
+    _dropped(0),
+    _busy(false),
+    _stopping(false),
+    _fileMaxSize(0),
+    _fileKeep(0)
+{
+}
+
+/*! Start the writer thread and make this the message handler. Formatted
+    messages are passed to \a sink, on the writer thread, along with
+    whether their type is caught. Call this before anything is logged.
+ */
+void MessageLog::install(Sink sink)
+{
+  if (_log)
+    return;
+
+  _sink = sink;
+  _log  = new MessageLog();
+  _log->start();
+  qInstallMsgHandler(handler);
+}
+
+/*! Read the level, the caught types and the log file from the settings.
+    This needs the QApplication, so it has to wait until main() has made
+    one, and it arranges for shutdown() to run when the application
+    exits.
+ */
+void MessageLog::loadSettings()
+{
+  int level = xtsettingsValue("logLevel", int(QtDebugMsg)).toInt();
+  _level = qBound(int(QtDebugMsg), level, int(QtFatalMsg));
+
+  _caught[QtDebugMsg]    = xtsettingsValue("catchQDebug").toBool();
+  _caught[QtWarningMsg]  = xtsettingsValue("catchQWarning").toBool();
+  _caught[QtCriticalMsg] = xtsettingsValue("catchQCritical").toBool();
+  _caught[QtFatalMsg]    = xtsettingsValue("catchQFatal").toBool();
+  updateEnabled();
+
+  QString path = xtsettingsValue("logFile").toString();
+  if (! path.isEmpty())
+    setLogFile(path,
+               xtsettingsValue("logFileMaxSize", 1048576).toLongLong(),
+               xtsettingsValue("logFileCount", 5).toInt());
+
+  static bool registered = false;
+  if (! registered && QCoreApplication::instance())
+  {
+    qAddPostRoutine(shutdown);
+    registered = true;
+  }
+}
+
+/*! Write everything still waiting and stop the writer thread. Messages
+    logged after this are printed right away by the thread that logs them.
+ */
+void MessageLog::shutdown()
+{
+  MessageLog *log = _log;
+  if (! log)
+    return;
+
+  _log = 0;
+  {
+    QMutexLocker locker(&log->_mutex);
+    log->_stopping = true;
+    log->_ready.wakeOne();
+  }
+  log->wait(3000);
+  delete log;
+  _sink = 0;
+}
+
+/*! Wait up to \a msecs milliseconds for every message logged so far to
+    be written. Returns false if that took too long.
+ */
+bool MessageLog::flush(unsigned long msecs)
+{
+  MessageLog *log = _log;
+  if (! log || QThread::currentThread() == log)
+    return true;
+
+  QMutexLocker locker(&log->_mutex);
+  log->_ready.wakeOne();
+  while (log->_count > 0 || log->_busy)
+    if (! log->_drained.wait(&log->_mutex, msecs))
+      return false;
+  return true;
+}
+
+QtMsgType MessageLog::level()
+{
+  return QtMsgType(_level);
+}
+
+/*! Print and write to the log file only messages of \a type and worse.
+ */
+void MessageLog::setLevel(QtMsgType type)
+{
+  _level = type;
+  updateEnabled();
+}
+
+bool MessageLog::isCaught(QtMsgType type)
+{
+  return _caught[type];
+}
+
+/*! Set whether the sink should show messages of \a type. Caught messages
+    are kept even if they are below level().
+ */
+void MessageLog::setCaught(QtMsgType type, bool caught)
+{
+  _caught[type] = caught;
+  updateEnabled();
+}
+
+/*! Append messages to the file \a path as well as printing them. When it
+    grows past \a maxSize bytes it is renamed with the suffix .1, older
+    files move up by one, and up to \a keep of them are kept. An empty
+    \a path stops writing to a file.
+ */
+void MessageLog::setLogFile(const QString &path, qint64 maxSize, int keep)
+{
+  MessageLog *log = _log;
+  if (! log)
+    return;
+
+  QMutexLocker locker(&log->_mutex);
+  log->_filePath    = path;
+  log->_fileMaxSize = maxSize;
+  log->_fileKeep    = qMax(0, keep);
+  log->_ready.wakeOne();
+}
+
+void MessageLog::updateEnabled()
+{
+  int enabled = 1 << QtFatalMsg;
+  for (int type = QtDebugMsg; type < QtFatalMsg; type++)
+    if (type >= _level || _caught[type])
+      enabled |= 1 << type;
+  _enabled = enabled;
+}
+
+void MessageLog::handler(QtMsgType type, const char *msg)
+{
+  if (! isEnabled(type))
+    return;
+
+  MessageLog *log = _log;
+  if (log && QThread::currentThread() != log)
+  {
+    log->enqueue(type, msg);
+    if (type == QtFatalMsg)     // Qt aborts as soon as this returns
+      flush();
+    return;
+  }
+
+  /* before install(), after shutdown(), or from inside the writer: there
+     is nobody to hand the message to, so print it here */
+  printf("%s%s%s\n", qPrintable(QDateTime::currentDateTime().toString()),
+         _prefix[type], msg);
+  fflush(stdout);
+}
+
+/* the only work the logging thread does: copy the message into the ring */
+void MessageLog::enqueue(QtMsgType type, const char *msg)
+{
+  qint64     msecs = QDateTime::currentMSecsSinceEpoch();
+  QByteArray text(msg);
+
+  QMutexLocker locker(&_mutex);
+  if (_count == _ring.size())
+  {
+    _dropped++;
+    return;
+  }
+
+  Entry &entry = _ring[(_head + _count) % _ring.size()];
+  entry.type  = type;
+  entry.msecs = msecs;
+  entry.text  = text;
+  _count++;
+  _ready.wakeOne();
+}
+
+void MessageLog::run()
+{
+  QVector<Entry> batch;
+  batch.reserve(_ring.size());
+
+  forever
+  {
+    int     dropped;
+    QString path;
+    qint64  maxSize;
+    int     keep;
+    {
+      QMutexLocker locker(&_mutex);
+      while (_count == 0 && _dropped == 0 && ! _stopping && _filePath == _openPath)
+        _ready.wait(&_mutex);
+      if (_count == 0 && _dropped == 0 && _stopping)
+        break;
+
+      for (int i = 0; i < _count; i++)
+      {
+        Entry &entry = _ring[(_head + i) % _ring.size()];
+        batch.append(entry);
+        entry.text = QByteArray();
+      }
+      _head    = (_head + _count) % _ring.size();
+      _count   = 0;
+      dropped  = _dropped;
+      _dropped = 0;
+      _busy    = true;
+
+      path    = _filePath;
+      maxSize = _fileMaxSize;
+      keep    = _fileKeep;
+    }
+
+    if (path != _openPath)
+    {
+      _file.close();
+      _openPath = path;
+      openLogFile();
+    }
+
+    if (dropped)
+    {
+      Entry entry;
+      entry.type  = QtWarningMsg;
+      entry.msecs = QDateTime::currentMSecsSinceEpoch();
+      entry.text  = QString("%1 messages were dropped because the log could not keep up")
+                      .arg(dropped).toLocal8Bit();
+      write(entry);
+    }
+
+    for (int i = 0; i < batch.size(); i++)
+      write(batch.at(i));
+    batch.clear();
+
+    fflush(stdout);
+    if (_file.isOpen())
+    {
+      _file.flush();
+      if (maxSize > 0 && _file.size() > maxSize)
+        rotateLogFile(keep);
+    }
+
+    QMutexLocker locker(&_mutex);
+    _busy = false;
+    if (_count == 0)
+      _drained.wakeAll();
+  }
+
+  _file.close();
+
+  QMutexLocker locker(&_mutex);
+  _busy = false;
+  _drained.wakeAll();
+}
+
+/* runs on the writer thread */
+void MessageLog::write(const Entry &entry)
+{
+  QString msg = QDateTime::fromMSecsSinceEpoch(entry.msecs).toString()
+              + _prefix[entry.type] + QString::fromLocal8Bit(entry.text);
+
+  if (entry.type >= _level)
+  {
+    printf("%s\n", qPrintable(msg));
+    if (_file.isOpen())
+      _file.write(msg.toUtf8().append('\n'));
+  }
+
+  if (_sink)
+    _sink(entry.type, msg, _caught[entry.type]);
+}
+
+void MessageLog::openLogFile()
+{
+  if (_openPath.isEmpty())
+    return;
+
+  _file.setFileName(_openPath);
+  if (! _file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+    printf("Could not open the log file %s: %s\n",
+           qPrintable(_openPath), qPrintable(_file.errorString()));
+  else if (DEBUG)
+    printf("MessageLog::openLogFile() appending to %s\n", qPrintable(_openPath));
+}
+
+/* file.log -> file.log.1 -> file.log.2 ... keeping at most keep of them */
+void MessageLog::rotateLogFile(int keep)
+{
+  _file.close();
+
+  if (keep > 0)
+  {
+    QFile::remove(QString("%1.%2").arg(_openPath).arg(keep));
+    for (int i = keep - 1; i > 0; i--)
+      QFile::rename(QString("%1.%2").arg(_openPath).arg(i),
+                    QString("%1.%2").arg(_openPath).arg(i + 1));
+    QFile::rename(_openPath, _openPath + ".1");
+  }
+  else
+    QFile::remove(_openPath);
+
+  openLogFile();
+}
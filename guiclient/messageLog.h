@@ -0,0 +1,94 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __MESSAGELOG_H__
+#define __MESSAGELOG_H__
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+/* The handler for qDebug(), qWarning(), qCritical() and qFatal().
+
+   The thread that logs a message only checks whether its type is wanted,
+   stamps it with the time, and puts it in a fixed-size ring. A writer
+   thread takes messages off the ring, formats them, prints them, appends
+   them to the log file if there is one, and hands them to the sink, which
+   is how the Error Log window sees them. If the ring fills up, messages
+   are dropped and counted rather than making the caller wait.
+
+   Which types are wanted is kept in memory. A type is wanted if it is at
+   or above level(), in which case it is printed, or if it is caught, in
+   which case the sink is told to show it. Callers building expensive
+   debug output can check isEnabled() first so it costs nothing when
+   nobody is listening.
+*/
+class MessageLog : public QThread
+{
+  public:
+    typedef void (*Sink)(QtMsgType, const QString &, bool);
+
+    static void install(Sink sink = 0);
+    static void loadSettings();
+    static void shutdown();
+    static bool flush(unsigned long msecs = 2000);
+
+    static bool      isEnabled(QtMsgType type) { return _enabled & (1 << type); }
+    static QtMsgType level();
+    static void      setLevel(QtMsgType type);
+    static bool      isCaught(QtMsgType type);
+    static void      setCaught(QtMsgType type, bool caught);
+    static void      setLogFile(const QString &path, qint64 maxSize = 1048576, int keep = 5);
+
+  protected:
+    MessageLog();
+    virtual void run();
+
+  private:
+    struct Entry
+    {
+      QtMsgType  type;
+      qint64     msecs;
+      QByteArray text;
+    };
+
+    static void handler(QtMsgType type, const char *msg);
+    static void updateEnabled();
+
+    void enqueue(QtMsgType type, const char *msg);
+    void write(const Entry &entry);
+    void openLogFile();
+    void rotateLogFile(int keep);
+
+    static int     _enabled;    // bit n set if QtMsgType n is wanted
+
+    QMutex         _mutex;
+    QWaitCondition _ready;
+    QWaitCondition _drained;
+    QVector<Entry> _ring;
+    int            _head;       // oldest entry not yet written
+    int            _count;
+    int            _dropped;
+    bool           _busy;
+    bool           _stopping;
+
+    QString        _filePath;   // settings, guarded by _mutex
+    qint64         _fileMaxSize;
+    int            _fileKeep;
+
+    QFile          _file;       // used only by the writer thread
+    QString        _openPath;
+};
+
+#endif
@@ -21,6 +21,7 @@
 #include "guiErrorCheck.h"
 #include "jsHighlighter.h"
 #include "package.h"
+#include "scriptcache.h"
 #include "storedProcErrorLookup.h"
 
 #define DEBUG false
@@ -272,6 +273,7 @@ bool scriptEditor::sSaveToDB()
   }
 
   _document->setModified(false);
+  ScriptCache::instance()->clear();   // this script, or one that #includes it
   if (_package->id() != _pkgheadidOrig &&
       QMessageBox::question(this, tr("Move to different package?"),
                             tr("Do you want to move this script "
@@ -15,6 +15,8 @@
 #include <QScriptEngine>
 #include <QScriptEngineDebugger>
 
+#include "messageLog.h"
+#include "scriptcache.h"
 #include "scripttoolbox.h"
 #include "../scriptapi/qeventproto.h"
 #include "../scriptapi/parameterlistsetup.h"
@@ -56,29 +58,33 @@ QScriptEngine *ScriptablePrivate::engine()
 
 void ScriptablePrivate::loadScript(const QString& oName)
 {
-  qDebug() << "Looking for a script " << oName;
-  XSqlQuery scriptq;
-  scriptq.prepare("SELECT script_source, script_order"
-            "  FROM script"
-            " WHERE((script_name=:script_name)"
-            "   AND (script_enabled))"
-            " ORDER BY script_order;");
-  scriptq.bindValue(":script_name", oName);
-  scriptq.exec();
-  while(scriptq.next())
+  loadScripts(QStringList() << oName);
+}
+
+/* evaluate the scripts for all of the names, in order, looking them up
+   with one trip to the ScriptCache
+ */
+void ScriptablePrivate::loadScripts(const QStringList &names)
+{
+  QList<QStringList> scripts = ScriptCache::instance()->scripts(names);
+  for (int i = 0; i < names.size(); i++)
   {
-    if(engine())
+    if (MessageLog::isEnabled(QtDebugMsg))
+      qDebug() << "Looking for a script " << names.at(i);
+    for (int j = 0; j < scripts.at(i).size(); j++)
     {
-      QString script = scriptHandleIncludes(scriptq.value("script_source").toString());
-      QScriptValue result = _engine->evaluate(script, _parent->objectName());
-      if (_engine->hasUncaughtException())
+      if(engine())
       {
-        int line = _engine->uncaughtExceptionLineNumber();
-        qDebug() << "uncaught exception at line" << line << ":" << result.toString();
+        QScriptValue result = _engine->evaluate(scripts.at(i).at(j), _parent->objectName());
+        if (_engine->hasUncaughtException())
+        {
+          int line = _engine->uncaughtExceptionLineNumber();
+          qDebug() << "uncaught exception at line" << line << ":" << result.toString();
+        }
       }
+      else
+        qDebug() << "could not initialize engine";
     }
-    else
-      qDebug() << "could not initialize engine";
   }
 }
 
@@ -110,8 +116,7 @@ void ScriptablePrivate::loadScriptEngine()
   }
 
   scriptList.removeDuplicates();
-  for (int i = 0; i < scriptList.size(); ++i)
-    loadScript(scriptList.at(i));
+  loadScripts(scriptList);
 }
 
 enum SetResponse ScriptablePrivate::callSet(const ParameterList & params)
@@ -17,6 +17,7 @@ class QScriptEngineDebugger;
 class QEvent;
 
 #include <QString>
+#include <QStringList>
 
 #include "guiclient.h"
 #include "parameter.h"
@@ -29,6 +30,7 @@ class ScriptablePrivate
 
     QScriptEngine *engine();
     void loadScript(const QString&);
+    void loadScripts(const QStringList&);
     void loadScriptEngine();
 
     enum SetResponse callSet(const ParameterList &);
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "scriptcache.h"
+
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlError>
+
+#include "scripttoolbox.h"
+#include "xsqlquery.h"
+
+#define DEBUG false
+
+#define NOTIFYNAME "scriptUpdated"
+
+ScriptCache *ScriptCache::instance()
+{
+  static ScriptCache *cache = 0;
+  if (! cache)
+    cache = new ScriptCache();
+  return cache;
+}
+
+ScriptCache::ScriptCache(QObject *parent)
+  : QObject(parent),
+    _dirty(false),
+    _hits(0),
+    _misses(0)
+{
+  QSqlDatabase::database().driver()->subscribeToNotification(NOTIFYNAME);
+  QObject::connect(QSqlDatabase::database().driver(), SIGNAL(notification(const QString&)),
+                   this, SLOT(sNotified(const QString &)));
+}
+
+/*! Return the sources of the enabled scripts for each of \a names, in
+    the same order as \a names, each list in script_order. A name with
+    no scripts gets an empty list.
+ */
+QList<QStringList> ScriptCache::scripts(const QStringList &names)
+{
+  if (_dirty)
+    clear();
+
+  QStringList missing;
+  for (int i = 0; i < names.size(); i++)
+  {
+    if (_scripts.contains(names.at(i)))
+      _hits++;
+    else if (! missing.contains(names.at(i)))
+      missing.append(names.at(i));
+  }
+
+  if (! missing.isEmpty())
+  {
+    _misses += missing.size();
+
+    QStringList placeholders;
+    for (int i = 0; i < missing.size(); i++)
+      placeholders.append(QString(":name%1").arg(i));
+
+    XSqlQuery scriptq;
+    scriptq.prepare("SELECT script_name, script_source"
+                    "  FROM script"
+                    " WHERE((script_name IN (" + placeholders.join(", ") + "))"
+                    "   AND (script_enabled))"
+                    " ORDER BY script_name, script_order;");
+    for (int i = 0; i < missing.size(); i++)
+      scriptq.bindValue(placeholders.at(i), missing.at(i));
+    scriptq.exec();
+
+    // don't remember a failed lookup as "no scripts"
+    if (scriptq.lastError().type() == QSqlError::NoError)
+    {
+      for (int i = 0; i < missing.size(); i++)
+        _scripts.insert(missing.at(i), QStringList());
+    }
+
+    while (scriptq.next())
+      _scripts[scriptq.value("script_name").toString()]
+          .append(scriptHandleIncludes(scriptq.value("script_source").toString()));
+
+    if (DEBUG)
+      qDebug("ScriptCache::scripts() fetched %d names, %d hits, %d misses",
+             missing.size(), _hits, _misses);
+  }
+
+  QList<QStringList> result;
+  for (int i = 0; i < names.size(); i++)
+    result.append(_scripts.value(names.at(i)));
+  return result;
+}
+
+void ScriptCache::clear()
+{
+  if (DEBUG)
+    qDebug("ScriptCache::clear() %d names, %d hits, %d misses",
+           _scripts.size(), _hits, _misses);
+  _scripts.clear();
+  _dirty = false;
+}
+
+void ScriptCache::sNotified(const QString &note)
+{
+  if (note == NOTIFYNAME)
+    _dirty = true;
+}
@@ -0,0 +1,59 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __SCRIPTCACHE_H__
+#define __SCRIPTCACHE_H__
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+/* The enabled scripts for each script name, with their #includes already
+   expanded, kept for the session. Every window looks up scripts for each
+   class it inherits from and each part of its object name, almost always
+   finding none, so names without scripts are remembered too. Names that
+   aren't cached yet are fetched together in a single query.
+
+   Any change to a script can change what another script #includes, so the
+   whole cache is dropped whenever a script is saved or deleted here. The
+   database doesn't send the scriptUpdated notification yet; once a trigger
+   on the script table does, changes made by other clients will drop the
+   cache too.
+*/
+class ScriptCache : public QObject
+{
+  Q_OBJECT
+
+  public:
+    static ScriptCache *instance();
+
+    QList<QStringList> scripts(const QStringList &names);
+
+    int hits()   const { return _hits;   }
+    int misses() const { return _misses; }
+
+  public slots:
+    void clear();
+
+  protected slots:
+    void sNotified(const QString &note);
+
+  private:
+    ScriptCache(QObject *parent = 0);
+
+    QHash<QString, QStringList> _scripts;  // name -> sources in script_order
+    bool _dirty;
+    int  _hits;
+    int  _misses;
+};
+
+#endif
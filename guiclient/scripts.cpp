@@ -20,6 +20,7 @@
 #include "errorReporter.h"
 #include "guiclient.h"
 #include "scriptEditor.h"
+#include "scriptcache.h"
 
 scripts::scripts(QWidget* parent, const char* name, Qt::WFlags fl)
     : XWidget(parent, name, fl)
@@ -92,6 +93,7 @@ void scripts::sDelete()
                              delq, __FILE__, __LINE__))
       return;
 
+    ScriptCache::instance()->clear();
     sFillList();
   }
 }
@@ -43,6 +43,7 @@
 #include "xdialog.h"
 #include "xmainwindow.h"
 #include "xtreewidget.h"
+#include "xtreewidgetexporter.h"
 #include "display.h"
 #include "xuiloader.h"
 #include "getscreen.h"
@@ -1248,6 +1249,32 @@ void ScriptToolbox::setLastWindow(QWidget * lw)
   _lastWindow = lw;
 }
 
+/** @brief Make a name open one of the core application windows.
+
+    After this call, openWindow(alias) opens the same core window as
+    openWindow(classname). This lets a package give an existing window
+    another name, or point a name at a different core window.
+
+    @param alias     The new name
+    @param classname The name of the core application class to open
+
+    @return false if classname is not a core application window
+  */
+bool ScriptToolbox::registerScreenAlias(const QString & alias, const QString & classname)
+{
+  return xtRegisterScreenAlias(alias, classname);
+}
+
+/** @brief The names of all of the core application windows.
+
+    @return The sorted list of names openWindow accepts without looking
+            for a %uiform
+  */
+QStringList ScriptToolbox::screenNames()
+{
+  return xtScreenNames();
+}
+
 /** @brief Open a new scripted or core application window.
 
     This method opens a new window on the display. It can be defined
@@ -1402,6 +1429,49 @@ void ScriptToolbox::populateXTreeWidget(QWidget * tree, XSqlQuery pSql, bool pUs
     xt->populate(pSql, pUseAltId);
 }
 
+/** @brief Write the visible rows and columns of an XTreeWidget to a file.
+
+    The rows are streamed to the file as the tree is walked.
+
+    @param tree     The XTreeWidget to export
+    @param filename The file to write
+    @param format   One of csv, tsv, html, or odt. If empty the format
+                    is chosen from the suffix of \c filename.
+    @return true if the file was written
+  */
+bool ScriptToolbox::exportXTreeWidget(QWidget * tree, const QString & filename, const QString & format)
+{
+  XTreeWidget *xt = qobject_cast<XTreeWidget*>(tree);
+  if (! xt)
+    return false;
+
+  XTreeWidgetExporter exporter(xt);
+  XTreeWidgetExporter::Format fmt = XTreeWidgetExporter::formatForSuffix(format);
+  if (! exporter.exportFile(filename, fmt))
+  {
+    qWarning("exportXTreeWidget(%s) failed: %s", qPrintable(filename),
+             qPrintable(exporter.errorString()));
+    return false;
+  }
+  return true;
+}
+
+/** @brief Create an XTreeWidgetExporter for the given XTreeWidget.
+
+    Use this instead of exportXTreeWidget() to connect to the exporter's
+    progress signals or cancel a long export.
+
+    @param tree The XTreeWidget to export, which also owns the exporter
+  */
+QObject * ScriptToolbox::createXTreeWidgetExporter(QWidget * tree)
+{
+  XTreeWidget *xt = qobject_cast<XTreeWidget*>(tree);
+  if (! xt)
+    return 0;
+
+  return new XTreeWidgetExporter(xt, xt);
+}
+
 /** @brief Load the given QWebView with the given URL. */
 void ScriptToolbox::loadQWebView(QWidget * webView, const QString & url)
 {
@@ -153,9 +153,13 @@ class ScriptToolbox : public QObject
     QWidget * lastWindow() const;
     QWidget * openWindow(const QString pname, QWidget *parent = 0, Qt::WindowModality modality = Qt::NonModal, Qt::WindowFlags flags = 0);
     QWidget * newDisplay(const QString pname, QWidget *parent = 0, Qt::WindowModality modality = Qt::NonModal, Qt::WindowFlags flags = 0);
+    bool        registerScreenAlias(const QString & alias, const QString & classname);
+    QStringList screenNames();
 
     void addColumnXTreeWidget(QWidget * tree, const QString &, int, int, bool = true, const QString = QString(), const QString = QString());
     void populateXTreeWidget(QWidget * tree, XSqlQuery pSql, bool = FALSE);
+    bool exportXTreeWidget(QWidget * tree, const QString & filename, const QString & format = QString());
+    QObject * createXTreeWidgetExporter(QWidget * tree);
 
     void loadQWebView(QWidget * webView, const QString & url);
 
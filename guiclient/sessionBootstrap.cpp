@@ -0,0 +1,181 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "sessionBootstrap.h"
+
+#include <QEvent>
+#include <QSqlError>
+#include <QSqlField>
+#include <QVariant>
+#include <QWidget>
+
+#include "xsqlquery.h"
+
+#define DEBUG false
+
+/* the columns of the user's locale that main() and the format functions
+   use, in the order the query below returns them */
+static const char *localeColumns[] = {
+  "locale_lang_file",       "lang_abbr2",              "country_abbr",
+  "lang_qt_number",         "country_qt_number",
+  "locale_error_color",     "locale_warning_color",    "locale_emphasis_color",
+  "locale_altemphasis_color", "locale_expired_color",  "locale_future_color",
+  "locale_cost_scale",      "locale_curr_scale",       "locale_extprice_scale",
+  "locale_percent_scale",   "locale_purchprice_scale", "locale_qty_scale",
+  "locale_qtyper_scale",    "locale_salesprice_scale", "locale_uomratio_scale",
+  "locale_weight_scale",
+  0
+};
+
+SessionBootstrap::SessionBootstrap()
+  : _loaded(false),
+    _baseCurrencies(-1)
+{
+}
+
+/*! Read everything for \a username, the name the user logged in with, in
+    a single query. Returns false and leaves the bootstrap empty if the
+    query fails.
+ */
+bool SessionBootstrap::load(const QString &username)
+{
+  QStringList names;
+  QStringList values;
+  for (int i = 0; localeColumns[i]; i++)
+  {
+    names  << QString("'%1'").arg(localeColumns[i]);
+    values << QString("CAST(%1 AS TEXT)").arg(localeColumns[i]);
+  }
+
+  XSqlQuery bootq;
+  bootq.prepare("SELECT 'user' AS kind, 'effective' AS key, getEffectiveXtUser() AS value"
+                " UNION ALL "
+                "SELECT 'metric', metric_name, metric_value FROM metric"
+                " UNION ALL "
+                "SELECT 'usrpref', usrpref_name, usrpref_value"
+                "  FROM usrpref"
+                " WHERE (usrpref_username=:username)"
+                " UNION ALL "
+                "SELECT 'priv', priv_name, TEXT('t')"
+                "  FROM usrpriv, priv"
+                " WHERE((usrpriv_priv_id=priv_id)"
+                "   AND (usrpriv_username=getEffectiveXtUser()))"
+                " UNION ALL "
+                "SELECT 'priv', priv_name, TEXT('t')"
+                "  FROM priv, grppriv, usrgrp"
+                " WHERE((usrgrp_grp_id=grppriv_grp_id)"
+                "   AND (grppriv_priv_id=priv_id)"
+                "   AND (usrgrp_username=getEffectiveXtUser()))"
+                " UNION ALL "
+                "SELECT 'package', pkghead_name, NULL"
+                "  FROM pkghead"
+                " WHERE packageIsEnabled(pkghead_name)"
+                " UNION ALL "
+                "SELECT 'basecurr', 'count', CAST(COUNT(*) AS TEXT)"
+                "  FROM curr_symbol"
+                " WHERE curr_base"
+                " UNION ALL "
+                "SELECT 'locale', UNNEST(ARRAY[" + names.join(",") + "]),"
+                "       UNNEST(ARRAY[" + values.join(",") + "])"
+                "  FROM usr, locale LEFT OUTER JOIN"
+                "       lang ON (locale_lang_id=lang_id) LEFT OUTER JOIN"
+                "       country ON (locale_country_id=country_id)"
+                " WHERE((usr_username=getEffectiveXtUser())"
+                "   AND (usr_locale_id=locale_id));");
+  bootq.bindValue(":username", username);
+  if (! bootq.exec())
+  {
+    qWarning("SessionBootstrap::load() failed, reading the session piece by piece: %s",
+             qPrintable(bootq.lastError().databaseText()));
+    return false;
+  }
+
+  while (bootq.next())
+  {
+    QString kind  = bootq.value("kind").toString();
+    QString key   = bootq.value("key").toString();
+    QVariant value = bootq.value("value");
+
+    if (kind == "metric")
+      _metrics.insert(key, value.toString());
+    else if (kind == "usrpref")
+      _preferences.insert(key, value.toString());
+    else if (kind == "priv")
+      _privileges.insert(key, value.toString());
+    else if (kind == "locale")
+    {
+      _locale.append(QSqlField(key, QVariant::String));
+      _locale.setValue(key, value);
+    }
+    else if (kind == "package")
+      _packages.append(key);
+    else if (kind == "basecurr")
+      _baseCurrencies = value.toInt();
+    else if (kind == "user")
+      _effectiveUser = value.toString();
+  }
+
+  if (DEBUG)
+    qDebug("SessionBootstrap::load() %d metrics, %d preferences, %d privileges, "
+           "%d packages, locale %s",
+           _metrics.size(), _preferences.size(), _privileges.size(),
+           _packages.size(), _locale.isEmpty() ? "missing" : "found");
+
+  _loaded = true;
+  return true;
+}
+
+QTime StartupTimer::_clock;
+int   StartupTimer::_last = 0;
+
+StartupTimer::StartupTimer(QObject *parent)
+  : QObject(parent)
+{
+}
+
+/*! Start the clock. Call this as early in main() as possible.
+ */
+void StartupTimer::start()
+{
+  _clock.start();
+  _last = 0;
+}
+
+/*! Log that the step called \a name just finished, with how long it took
+    and how long it's been since start().
+ */
+void StartupTimer::phase(const QString &name)
+{
+  if (! _clock.isValid())
+    return;
+
+  int now = _clock.elapsed();
+  qDebug("Startup: %-36s %6d ms (total %d ms)", qPrintable(name), now - _last, now);
+  _last = now;
+}
+
+/*! Log the last step once \a window has been painted for the first time.
+ */
+void StartupTimer::finishOnFirstPaint(QWidget *window)
+{
+  if (window)
+    window->installEventFilter(new StartupTimer(window));
+}
+
+bool StartupTimer::eventFilter(QObject *watched, QEvent *event)
+{
+  if (event->type() == QEvent::Paint)
+  {
+    phase("first paint");
+    watched->removeEventFilter(this);
+    deleteLater();
+  }
+  return false;
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __SESSIONBOOTSTRAP_H__
+#define __SESSIONBOOTSTRAP_H__
+
+#include <QObject>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QTime>
+
+#include "metrics.h"
+
+class QWidget;
+
+/* Everything the client reads about the session before it can open the
+   main window -- metrics, the user's preferences and privileges, the
+   user's locale, the enabled packages, and how many base currencies
+   there are -- fetched in one query instead of one round trip for each.
+
+   If load() fails, say because the database is older than the query
+   expects, callers should fall back to reading each piece on its own.
+*/
+class SessionBootstrap
+{
+  public:
+    SessionBootstrap();
+
+    bool load(const QString &username);
+    bool isLoaded() const { return _loaded; }
+
+    QString     effectiveUser()     const { return _effectiveUser; }
+    MetricMap   metrics()           const { return _metrics; }
+    MetricMap   preferences()       const { return _preferences; }
+    MetricMap   privileges()        const { return _privileges; }
+    QSqlRecord  locale()            const { return _locale; }
+    QStringList packages()          const { return _packages; }
+    int         baseCurrencyCount() const { return _baseCurrencies; }
+
+  private:
+    bool        _loaded;
+    QString     _effectiveUser;
+    MetricMap   _metrics;
+    MetricMap   _preferences;
+    MetricMap   _privileges;
+    QSqlRecord  _locale;
+    QStringList _packages;
+    int         _baseCurrencies;
+};
+
+/* Writes how long each step of starting up took to the log, from the
+   time the application started to the first time the main window is
+   painted, so slow startups can be tracked down.
+*/
+class StartupTimer : public QObject
+{
+  Q_OBJECT
+
+  public:
+    static void start();
+    static void phase(const QString &name);
+    static void finishOnFirstPaint(QWidget *window);
+
+  protected:
+    StartupTimer(QObject *parent = 0);
+    bool eventFilter(QObject *watched, QEvent *event);
+
+  private:
+    static QTime _clock;
+    static int   _last;
+};
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "timePhasedBuckets.h"
+
+#include <QSqlField>
+
+#include <xsqlquery.h>
+
+#define DEBUG false
+
+static bool readRows(XSqlQuery &query, QSqlRecord &fields, QList<QVariantList> &rows)
+{
+  rows.clear();
+  if (! query.isActive())
+    return false;
+
+  fields = query.record();
+  int fieldCount = fields.count();
+  while (query.next())
+  {
+    QVariantList row;
+    row.reserve(fieldCount);
+    for (int i = 0; i < fieldCount; i++)
+      row.append(query.value(i));
+    rows.append(row);
+  }
+  return true;
+}
+
+TimePhasedBuckets::TimePhasedBuckets(int buckets)
+  : _buckets(qMax(0, buckets))
+{
+}
+
+/*! Remove every row and start over with \a buckets periods.
+ */
+void TimePhasedBuckets::clear(int buckets)
+{
+  _buckets = qMax(0, buckets);
+  _names.clear();
+  _rows.clear();
+  _values.clear();
+}
+
+/*! Add a row of zeros called \a name and return its index. Unnamed rows
+    can only be reached by index.
+ */
+int TimePhasedBuckets::addRow(const QString &name)
+{
+  int row = _names.size();
+  _names.append(name);
+  if (! name.isEmpty())
+    _rows.insert(name, row);
+  _values.resize(_values.size() + _buckets);
+  return row;
+}
+
+int TimePhasedBuckets::row(const QString &name) const
+{
+  return _rows.value(name, -1);
+}
+
+QString TimePhasedBuckets::rowName(int row) const
+{
+  return _names.value(row);
+}
+
+double TimePhasedBuckets::value(int row, int bucket) const
+{
+  if (row < 0 || row >= rowCount() || bucket < 0 || bucket >= _buckets)
+    return 0.0;
+  return _values.at(row * _buckets + bucket);
+}
+
+void TimePhasedBuckets::setValue(int row, int bucket, double value)
+{
+  if (row < 0 || row >= rowCount() || bucket < 0 || bucket >= _buckets)
+    return;
+  _values[row * _buckets + bucket] = value;
+}
+
+/*! Return the bucketCount() values of \a row, which are contiguous.
+ */
+double *TimePhasedBuckets::rowData(int row)
+{
+  return _values.data() + row * _buckets;
+}
+
+const double *TimePhasedBuckets::rowData(int row) const
+{
+  return _values.constData() + row * _buckets;
+}
+
+/*! Read a result with one record per bucket. \a bucketColumn holds the
+    bucket number, counting from \a base, and each of \a columns becomes
+    the row of the same name, added if it isn't there yet. Records for
+    buckets out of range are ignored. Returns false if the query failed.
+ */
+bool TimePhasedBuckets::load(XSqlQuery &query, const QString &bucketColumn,
+                             const QStringList &columns, int base)
+{
+  if (! query.isActive())
+    return false;
+
+  QVector<int> rows;
+  for (int i = 0; i < columns.size(); i++)
+  {
+    int existing = row(columns.at(i));
+    rows.append(existing >= 0 ? existing : addRow(columns.at(i)));
+  }
+
+  int loaded = 0;
+  while (query.next())
+  {
+    int bucket = query.value(bucketColumn).toInt() - base;
+    if (bucket < 0 || bucket >= _buckets)
+      continue;
+    for (int i = 0; i < columns.size(); i++)
+      _values[rows.at(i) * _buckets + bucket] = query.value(columns.at(i)).toDouble();
+    loaded++;
+  }
+
+  if (DEBUG)
+    qDebug("TimePhasedBuckets::load() %d of %d buckets for %d rows",
+           loaded, _buckets, columns.size());
+  return true;
+}
+
+/*! Read every record of \a query into \a fields and \a rows, in the
+    form XTreeWidget::populate() takes, and load the \a bucketColumns of
+    each record as a row of buckets, replacing what was here. Returns
+    false if the query failed.
+ */
+bool TimePhasedBuckets::loadColumns(XSqlQuery &query, const QStringList &bucketColumns,
+                                    QSqlRecord &fields, QList<QVariantList> &rows)
+{
+  if (! readRows(query, fields, rows))
+    return false;
+
+  loadColumns(fields, rows, bucketColumns);
+  return true;
+}
+
+/*! Replace what's here with one row per entry in \a rows, holding the
+    values of its \a bucketColumns. Columns missing from \a fields and
+    NULL values load as zero.
+ */
+void TimePhasedBuckets::loadColumns(const QSqlRecord &fields, const QList<QVariantList> &rows,
+                                    const QStringList &bucketColumns)
+{
+  clear(bucketColumns.size());
+
+  QVector<int> fieldIdx(_buckets);
+  for (int b = 0; b < _buckets; b++)
+    fieldIdx[b] = fields.indexOf(bucketColumns.at(b));
+
+  _names.reserve(rows.size());
+  _values.resize(rows.size() * _buckets);
+  double *values = _values.data();
+  for (int r = 0; r < rows.size(); r++)
+  {
+    const QVariantList &row = rows.at(r);
+    _names.append(QString());
+    for (int b = 0; b < _buckets; b++, values++)
+      *values = (fieldIdx.at(b) >= 0) ? row.value(fieldIdx.at(b)).toDouble() : 0.0;
+  }
+
+  if (DEBUG)
+    qDebug("TimePhasedBuckets::loadColumns() %d rows of %d buckets",
+           rows.size(), _buckets);
+}
+
+/*! Read every record of \a query into \a fields and \a rows for
+    XTreeWidget::populate(), the way loadColumns() does, and apply the
+    \a options to them:
+
+    Cumulative replaces the \a bucketColumns of each row with running
+    totals. LineTotal adds a linetotal column with each row's sum, with
+    \a numericRole as its xtnumericrole if that isn't empty and a total
+    at the bottom of the list. HideZeroRows adds an xthiddenrole column
+    that hides rows whose buckets add up to zero.
+
+    Without options the rows are passed through and nothing is loaded
+    here. Returns false if the query failed.
+ */
+bool TimePhasedBuckets::loadList(XSqlQuery &query, const QStringList &bucketColumns, int options,
+                                 QSqlRecord &fields, QList<QVariantList> &rows,
+                                 const QString &numericRole)
+{
+  if (options == NoOptions)
+    return readRows(query, fields, rows);
+
+  if (! loadColumns(query, bucketColumns, fields, rows))
+    return false;
+
+  QVector<double> totals = rowTotals();
+
+  if (options & Cumulative)
+  {
+    accumulate();
+
+    QVector<int> fieldIdx(_buckets);
+    for (int b = 0; b < _buckets; b++)
+      fieldIdx[b] = fields.indexOf(bucketColumns.at(b));
+
+    const double *values = _values.constData();
+    for (int r = 0; r < rows.size(); r++)
+      for (int b = 0; b < _buckets; b++, values++)
+        if (fieldIdx.at(b) >= 0)
+          rows[r][fieldIdx.at(b)] = *values;
+  }
+
+  if (options & LineTotal)
+  {
+    fields.append(QSqlField("linetotal", QVariant::Double));
+    if (! numericRole.isEmpty())
+      fields.append(QSqlField("linetotal_xtnumericrole", QVariant::String));
+    fields.append(QSqlField("linetotal_xttotalrole", QVariant::Int));
+  }
+  if (options & HideZeroRows)
+    fields.append(QSqlField("xthiddenrole", QVariant::Bool));
+
+  for (int r = 0; r < rows.size(); r++)
+  {
+    QVariantList &row = rows[r];
+    if (options & LineTotal)
+    {
+      row << totals.at(r);
+      if (! numericRole.isEmpty())
+        row << numericRole;
+      row << 0;
+    }
+    if (options & HideZeroRows)
+      row << qFuzzyIsNull(totals.at(r));
+  }
+
+  return true;
+}
+
+/*! Replace each value in \a row with the running total up to and
+    including its bucket, starting from \a start.
+ */
+void TimePhasedBuckets::accumulate(int row, double start)
+{
+  if (row < 0 || row >= rowCount())
+    return;
+
+  double *values = rowData(row);
+  double  sum    = start;
+  for (int b = 0; b < _buckets; b++)
+  {
+    sum      += values[b];
+    values[b] = sum;
+  }
+}
+
+/*! Replace every row with its running totals.
+ */
+void TimePhasedBuckets::accumulate()
+{
+  double *values = _values.data();
+  for (int r = 0; r < rowCount(); r++, values += _buckets)
+    for (int b = 1; b < _buckets; b++)
+      values[b] += values[b - 1];
+}
+
+/*! Return the sum of the buckets in each row, in row order.
+ */
+QVector<double> TimePhasedBuckets::rowTotals() const
+{
+  QVector<double> totals(rowCount(), 0.0);
+  const double   *values = _values.constData();
+  for (int r = 0; r < totals.size(); r++)
+  {
+    double sum = 0.0;
+    for (int b = 0; b < _buckets; b++)
+      sum += *values++;
+    totals[r] = sum;
+  }
+  return totals;
+}
+
+/*! Return the sum of each bucket over every row, in bucket order.
+ */
+QVector<double> TimePhasedBuckets::columnTotals() const
+{
+  QVector<double> totals(_buckets, 0.0);
+  double         *sums   = totals.data();
+  const double   *values = _values.constData();
+  for (int r = 0; r < rowCount(); r++)
+    for (int b = 0; b < _buckets; b++)
+      sums[b] += *values++;
+  return totals;
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __TIMEPHASEDBUCKETS_H__
+#define __TIMEPHASEDBUCKETS_H__
+
+#include <QHash>
+#include <QList>
+#include <QSqlRecord>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+class XSqlQuery;
+
+/* Quantities by period: named rows across a fixed number of buckets,
+   kept as one dense block of doubles. Time-phased screens fetch every
+   bucket in a single query, load the rows here, and do their running
+   balances as loops over contiguous memory before anything is formatted
+   for display.
+
+   Results with one column per bucket, the way the time-phased displays
+   get them, load with one matrix row per result row instead. loadList()
+   does that for a list and adds whatever the Options ask for, so screens
+   get their totals and hidden rows the same way.
+*/
+class TimePhasedBuckets
+{
+  public:
+    enum Option
+    {
+      NoOptions    = 0x00,
+      Cumulative   = 0x01,  // show each bucket as the running total to date
+      LineTotal    = 0x02,  // add a linetotal column with the sum of the buckets
+      HideZeroRows = 0x04   // hide rows whose buckets add up to zero
+    };
+
+    TimePhasedBuckets(int buckets = 0);
+
+    void    clear(int buckets);
+    int     bucketCount() const { return _buckets; }
+    int     rowCount()    const { return _names.size(); }
+
+    int     addRow(const QString &name = QString());
+    int     row(const QString &name) const;
+    QString rowName(int row) const;
+
+    double        value(int row, int bucket) const;
+    void          setValue(int row, int bucket, double value);
+    double       *rowData(int row);
+    const double *rowData(int row) const;
+
+    bool    load(XSqlQuery &query, const QString &bucketColumn,
+                 const QStringList &columns, int base = 1);
+    bool    loadColumns(XSqlQuery &query, const QStringList &bucketColumns,
+                        QSqlRecord &fields, QList<QVariantList> &rows);
+    void    loadColumns(const QSqlRecord &fields, const QList<QVariantList> &rows,
+                        const QStringList &bucketColumns);
+    bool    loadList(XSqlQuery &query, const QStringList &bucketColumns, int options,
+                     QSqlRecord &fields, QList<QVariantList> &rows,
+                     const QString &numericRole = QString());
+
+    void            accumulate(int row, double start = 0.0);
+    void            accumulate();
+    QVector<double> rowTotals() const;
+    QVector<double> columnTotals() const;
+
+  private:
+    int              _buckets;
+    QStringList      _names;
+    QHash<QString, int> _rows;
+    QVector<double>  _values;
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include "customCommand.h"
 #include "package.h"
 #include "scriptEditor.h"
+#include "scriptcache.h"
 #include "storedProcErrorLookup.h"
 #include "xTupleDesigner.h"
 #include "xuiloader.h"
@@ -438,6 +439,7 @@ void uiform::sScriptDelete()
                "WHERE (script_id=:script_id);" );
     uiformScriptDelete.bindValue(":script_id", _script->id());
     uiformScriptDelete.exec();
+    ScriptCache::instance()->clear();
   }
 
   sFillList();
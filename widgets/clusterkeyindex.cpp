@@ -0,0 +1,365 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "clusterkeyindex.h"
+
+#include <QApplication>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlRecord>
+#include <QTime>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "querythread.h"
+#include "widgets.h"
+
+#define DEBUG false
+
+/* how long to wait after a change notification before reloading, so a
+   burst of updates costs one snapshot instead of one per row */
+#define RELOADDELAY 2000
+
+QHash<QString, ClusterKeyIndex*> ClusterKeyIndex::_indexes;
+QList<ClusterKeyIndex*>          ClusterKeyIndex::_queue;
+ClusterKeyIndex                 *ClusterKeyIndex::_current = 0;
+
+/* every index loads through the same connection, one after the other */
+static QueryThread *loaderThread()
+{
+  static QueryThread *thread = 0;
+  if (! thread)
+  {
+    thread = new QueryThread(qApp);
+    thread->setStreaming(true);
+    thread->setFirstChunk(1000);
+    thread->setMaxChunk(10000);
+  }
+  return thread;
+}
+
+bool ClusterKeyIndex::enabled()
+{
+  return _x_metrics && _x_metrics->boolean("ClusterKeyIndex");
+}
+
+/*! Return the index called \a name, creating it and starting its load
+    if this is the first time it's been asked for. Return 0 if the
+    indexes are turned off or there is no index by that name.
+ */
+ClusterKeyIndex *ClusterKeyIndex::index(const QString &name)
+{
+  if (! enabled())
+    return 0;
+
+  ClusterKeyIndex *result = _indexes.value(name);
+  if (result)
+    return result;
+
+  QString     sql;
+  QStringList tables;
+  if (name == "item")
+  {
+    sql = "SELECT item_id AS id, item_number AS number,"
+          "       item_descrip1 AS name, item_descrip2 AS description,"
+          "       item_upccode AS upc, item_type AS type,"
+          "       item_active AS active, item_sold AS flag"
+          "  FROM item"
+          " UNION ALL "
+          "SELECT item_id, itemalias_number,"
+          "       CASE WHEN LENGTH(itemalias_descrip1) > 1 THEN itemalias_descrip1 ELSE item_descrip1 END,"
+          "       CASE WHEN LENGTH(itemalias_descrip2) > 1 THEN itemalias_descrip1 ELSE item_descrip2 END,"
+          "       NULL, item_type, item_active, item_sold"
+          "  FROM item"
+          "  JOIN itemalias ON (itemalias_item_id=item_id);";
+    tables << "item" << "itemalias";
+  }
+  else if (name == "cust")
+  {
+    sql = "SELECT cust_id AS id, cust_number AS number, cust_name AS name,"
+          "       addr_line1 AS description, NULL::TEXT AS upc, 'C' AS type,"
+          "       cust_active AS active, false AS flag"
+          "  FROM custinfo"
+          "  LEFT OUTER JOIN cntct ON (cust_cntct_id=cntct_id)"
+          "  LEFT OUTER JOIN addr  ON (cntct_addr_id=addr_id)"
+          " UNION ALL "
+          "SELECT prospect_id, prospect_number, prospect_name,"
+          "       addr_line1, NULL, 'P', prospect_active, false"
+          "  FROM prospect"
+          "  LEFT OUTER JOIN cntct ON (prospect_cntct_id=cntct_id)"
+          "  LEFT OUTER JOIN addr  ON (cntct_addr_id=addr_id);";
+    tables << "custinfo" << "prospect";
+  }
+  else if (name == "vend")
+  {
+    sql = "SELECT vend_id AS id, vend_number AS number, vend_name AS name,"
+          "       NULL::TEXT AS description, NULL::TEXT AS upc, NULL::TEXT AS type,"
+          "       vend_active AS active, false AS flag"
+          "  FROM vendinfo"
+          "  JOIN vendtype ON (vend_vendtype_id=vendtype_id);";
+    tables << "vendinfo";
+  }
+  else if (name == "crmacct")
+  {
+    sql = "SELECT crmacct_id AS id, crmacct_number AS number, crmacct_name AS name,"
+          "       NULL::TEXT AS description, NULL::TEXT AS upc, NULL::TEXT AS type,"
+          "       crmacct_active AS active, false AS flag"
+          "  FROM crmacct;";
+    tables << "crmacct";
+  }
+  else
+    return 0;
+
+  result = new ClusterKeyIndex(name, sql, tables, qApp);
+  _indexes.insert(name, result);
+  result->reload();
+  return result;
+}
+
+/*! Start loading all of the indexes, if they're turned on. This is meant
+    to be called once the user has logged in.
+ */
+void ClusterKeyIndex::preload()
+{
+  index("item");
+  index("cust");
+  index("vend");
+  index("crmacct");
+}
+
+ClusterKeyIndex::ClusterKeyIndex(const QString &name, const QString &sql,
+                                 const QStringList &tables, QObject *parent)
+  : QObject(parent),
+    _name(name),
+    _sql(sql),
+    _tables(tables),
+    _ready(false),
+    _request(-1)
+{
+  _reloadTimer = new QTimer(this);
+  _reloadTimer->setSingleShot(true);
+  _reloadTimer->setInterval(RELOADDELAY);
+  connect(_reloadTimer, SIGNAL(timeout()), this, SLOT(reload()));
+
+  QueryThread *thread = loaderThread();
+  connect(thread, SIGNAL(rowsReady(int)),     this, SLOT(sRowsReady(int)));
+  connect(thread, SIGNAL(queryFinished(int)), this, SLOT(sFinished(int)));
+  connect(thread, SIGNAL(queryFailed(int, const QString&)),
+          this,   SLOT(sFailed(int, const QString&)));
+
+  QSqlDriver *driver = QSqlDatabase::database().driver();
+  connect(driver, SIGNAL(notification(const QString&)),
+          this,   SLOT(sNotified(const QString&)));
+  foreach (QString table, _tables)
+    driver->subscribeToNotification(table + "Updated");
+}
+
+/*! Return the entries whose number, or UPC code if \a key is Upc, starts
+    with \a prefix, in order, stopping after \a limit entries if \a limit
+    isn't negative. \a complete is set to true if every match was
+    returned. Nothing is returned while the index is loading.
+ */
+QList<ClusterKeyIndex::Entry> ClusterKeyIndex::find(const QString &prefix, Qt::CaseSensitivity cs,
+                                                    Key key, int limit, bool *complete) const
+{
+  QList<Entry> result;
+  if (complete)
+    *complete = false;
+  if (! _ready || prefix.isEmpty())
+    return result;
+
+  const QVector<KeyRef> &keys = (key == Upc) ? _upcs : _numbers;
+  KeyRef lower = { prefix.toCaseFolded(), -1 };
+  QVector<KeyRef>::const_iterator it = std::lower_bound(keys.constBegin(), keys.constEnd(), lower);
+  for (; it != keys.constEnd() && it->folded.startsWith(lower.folded); ++it)
+  {
+    const Entry &entry = _entries.at(it->entry);
+    if (cs == Qt::CaseSensitive &&
+        ! (key == Upc ? entry.upc : entry.number).startsWith(prefix))
+      continue;
+    if (limit >= 0 && result.size() >= limit)
+      return result;
+    result.append(entry);
+  }
+
+  if (complete)
+    *complete = true;
+  return result;
+}
+
+/*! Return the id the server would pick for \a text from \a candidates,
+    the matches left after the caller applied its own filters, or -1 if
+    that can't be decided here. The server orders by number, which only
+    its collation knows, so the answer is either the one record whose
+    number is exactly \a text or, if \a complete, the only record left.
+ */
+int ClusterKeyIndex::resolve(const QString &text, const QList<Entry> &candidates,
+                             bool complete, Key key)
+{
+  QSet<int> ids;
+  QSet<int> exact;
+  bool      caseExact = false;
+  for (int i = 0; i < candidates.size(); i++)
+  {
+    const QString &value = (key == Upc) ? candidates.at(i).upc : candidates.at(i).number;
+    ids.insert(candidates.at(i).id);
+    if (value.compare(text, Qt::CaseInsensitive) == 0)
+    {
+      exact.insert(candidates.at(i).id);
+      caseExact = caseExact || value == text;
+    }
+  }
+
+  if (exact.size() == 1 && caseExact)
+    return *exact.constBegin();
+  if (exact.isEmpty() && complete && ids.size() == 1)
+    return *ids.constBegin();
+  return -1;
+}
+
+/*! Throw away what the index holds and load it again from the database.
+ */
+void ClusterKeyIndex::reload()
+{
+  _ready = false;
+  _reloadTimer->stop();
+  if (_current == this || _queue.contains(this))
+  {
+    if (_current == this)   // what's coming back is already out of date
+    {
+      _request = -1;
+      _current = 0;
+      _queue.prepend(this);
+      startNext();
+    }
+    return;
+  }
+
+  _queue.append(this);
+  if (! _current)
+    startNext();
+}
+
+void ClusterKeyIndex::startNext()
+{
+  if (_queue.isEmpty())
+    return;
+
+  _current = _queue.takeFirst();
+  _current->_loading.clear();
+  _current->_request = loaderThread()->exec(_current->_sql, ParameterList());
+  if (DEBUG)
+    qDebug("ClusterKeyIndex::startNext() loading %s as request %d",
+           qPrintable(_current->_name), _current->_request);
+}
+
+void ClusterKeyIndex::sNotified(const QString &note)
+{
+  if (! note.endsWith("Updated"))
+    return;
+
+  QString table = note.left(note.length() - QString("Updated").length()).toLower();
+  if (! _tables.contains(table))
+    return;
+
+  if (DEBUG)
+    qDebug("ClusterKeyIndex::sNotified(%s) %s is stale",
+           qPrintable(note), qPrintable(_name));
+  _ready = false;
+  _reloadTimer->start();
+}
+
+void ClusterKeyIndex::sRowsReady(int request)
+{
+  if (request != _request || _request < 0)
+    return;
+
+  QSqlRecord          fields;
+  QList<QVariantList> rows;
+  if (! loaderThread()->takeRows(request, fields, rows))
+    return;
+
+  int id     = fields.indexOf("id");
+  int number = fields.indexOf("number");
+  int name   = fields.indexOf("name");
+  int descr  = fields.indexOf("description");
+  int upc    = fields.indexOf("upc");
+  int type   = fields.indexOf("type");
+  int active = fields.indexOf("active");
+  int flag   = fields.indexOf("flag");
+
+  _loading.reserve(_loading.size() + rows.size());
+  for (int r = 0; r < rows.size(); r++)
+  {
+    const QVariantList &row = rows.at(r);
+    Entry entry;
+    entry.id          = row.value(id).toInt();
+    entry.number      = row.value(number).toString();
+    entry.name        = row.value(name).toString();
+    entry.description = row.value(descr).toString();
+    entry.upc         = row.value(upc).toString();
+    entry.type        = row.value(type).toString();
+    entry.active      = row.value(active).toBool();
+    entry.flag        = row.value(flag).toBool();
+    _loading.append(entry);
+  }
+}
+
+void ClusterKeyIndex::sFinished(int request)
+{
+  if (request != _request || _request < 0)
+    return;
+
+  sRowsReady(request);
+
+  QTime clock;
+  clock.start();
+
+  _entries = _loading;
+  _loading.clear();
+  _numbers.clear();
+  _upcs.clear();
+  _numbers.reserve(_entries.size());
+  for (int i = 0; i < _entries.size(); i++)
+  {
+    KeyRef number = { _entries.at(i).number.toCaseFolded(), i };
+    _numbers.append(number);
+    if (! _entries.at(i).upc.isEmpty())
+    {
+      KeyRef upc = { _entries.at(i).upc.toCaseFolded(), i };
+      _upcs.append(upc);
+    }
+  }
+  std::sort(_numbers.begin(), _numbers.end());
+  std::sort(_upcs.begin(), _upcs.end());
+
+  _request = -1;
+  _ready   = ! _reloadTimer->isActive();  // a change arrived while loading
+  if (DEBUG)
+    qDebug("ClusterKeyIndex::sFinished() %s has %d numbers and %d upc codes, indexed in %d ms",
+           qPrintable(_name), _numbers.size(), _upcs.size(), clock.elapsed());
+
+  _current = 0;
+  startNext();
+}
+
+void ClusterKeyIndex::sFailed(int request, const QString &msg)
+{
+  if (request != _request || _request < 0)
+    return;
+
+  qWarning("ClusterKeyIndex could not load %s: %s", qPrintable(_name), qPrintable(msg));
+  _request = -1;
+  _loading.clear();
+  _current = 0;
+  startNext();
+}
@@ -0,0 +1,110 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __CLUSTERKEYINDEX_H__
+#define __CLUSTERKEYINDEX_H__
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QTimer;
+
+/* A copy in memory of the numbers in one of the big master tables,
+   mapping each number to its id, name, description, and active flag, so
+   the cluster line edits can turn what the user typed into an id without
+   asking the server. The indexes are item, cust (customers and
+   prospects), vend, and crmacct.
+
+   Each index is loaded on a connection of its own when the user logs in,
+   or the first time it's asked for, and stays unusable until the load
+   finishes. When the database sends <table>Updated for a table the index
+   was built from, the index stops answering and reloads itself a moment
+   later. Callers must treat a miss as "ask the server": the snapshot may
+   be a little behind, and a filter the index can't express may apply.
+
+   The indexes are only used if the ClusterKeyIndex metric is set.
+*/
+class ClusterKeyIndex : public QObject
+{
+  Q_OBJECT
+
+  public:
+    /* type is item_type for items and C or P for customers and
+       prospects; flag is item_sold for items */
+    struct Entry
+    {
+      int     id;
+      QString number;
+      QString name;
+      QString description;
+      QString upc;
+      QString type;
+      bool    active;
+      bool    flag;
+    };
+
+    enum Key { Number, Upc };
+
+    static bool             enabled();
+    static ClusterKeyIndex *index(const QString &name);
+    static void             preload();
+
+    QString name()    const { return _name; }
+    bool    isReady() const { return _ready; }
+    int     size()    const { return _entries.size(); }
+
+    QList<Entry> find(const QString &prefix, Qt::CaseSensitivity cs,
+                      Key key = Number, int limit = -1, bool *complete = 0) const;
+    static int   resolve(const QString &text, const QList<Entry> &candidates,
+                         bool complete, Key key = Number);
+
+  public slots:
+    void reload();
+
+  protected slots:
+    void sNotified(const QString &note);
+    void sRowsReady(int request);
+    void sFinished(int request);
+    void sFailed(int request, const QString &msg);
+
+  private:
+    ClusterKeyIndex(const QString &name, const QString &sql,
+                    const QStringList &tables, QObject *parent = 0);
+
+    struct KeyRef
+    {
+      QString folded;
+      int     entry;
+      bool operator<(const KeyRef &other) const { return folded < other.folded; }
+    };
+
+    static void startNext();
+
+    QString         _name;
+    QString         _sql;
+    QStringList     _tables;
+    bool            _ready;
+    int             _request;
+    QTimer         *_reloadTimer;
+    QVector<Entry>  _entries;
+    QVector<KeyRef> _numbers;
+    QVector<KeyRef> _upcs;
+    QVector<Entry>  _loading;
+
+    static QHash<QString, ClusterKeyIndex*> _indexes;
+    static QList<ClusterKeyIndex*>          _queue;
+    static ClusterKeyIndex                 *_current;
+};
+
+#endif
@@ -165,6 +165,7 @@ CRMAcctLineEdit::CRMAcctLineEdit(QWidget* pParent, const char* pName) :
   setEditOwnPriv("MaintainPersonalCRMAccounts");
   setViewOwnPriv("ViewPersonalCRMAccounts");
 
+  _keyIndexName = "crmacct";
   setSubtype(Crmacct);
 }
 
@@ -41,6 +41,7 @@ CLineEdit::CLineEdit(QWidget *pParent, const char *pName) :
   setViewPriv("ViewCustomerMasters");
   setNewPriv("MaintainCustomerMasters");
 
+  _keyIndexName = "cust";
   _query = " SELECT * FROM ( "
            "  SELECT cust_id AS id, "
            "         cust_number AS number, "
@@ -238,7 +239,39 @@ void CLineEdit::setType(CLineEditTypes pType)
     break;
   }
   list.removeDuplicates();
-  setExtraClause(list.join(" AND "));
+  _typeClause = list.join(" AND ");
+  setExtraClause(_typeClause);
+}
+
+/* the clauses setType() builds only test things the index knows */
+bool CLineEdit::keyIndexUsable() const
+{
+  return ! _keyIndexName.isEmpty() &&
+         (_extraClause.isEmpty() || ! _strict || _extraClause == _typeClause);
+}
+
+bool CLineEdit::keyIndexAccepts(const ClusterKeyIndex::Entry &entry) const
+{
+  if (! VirtualClusterLineEdit::keyIndexAccepts(entry))
+    return false;
+  if (_extraClause.isEmpty() || ! _strict)
+    return true;
+
+  switch (_type)
+  {
+  case ActiveCustomers:
+    return entry.active && entry.type == "C";
+  case AllCustomers:
+    return entry.type == "C";
+  case ActiveProspects:
+    return entry.active && entry.type == "P";
+  case AllProspects:
+    return entry.type == "P";
+  case ActiveCustomersAndProspects:
+    return entry.active;
+  default:
+    return true;
+  }
 }
 
 VirtualList* CLineEdit::listFactory()
@@ -73,6 +73,9 @@ class XTUPLEWIDGETS_EXPORT CLineEdit : public VirtualClusterLineEdit
     void            sUpdateMenu();
 
   protected:
+    bool keyIndexUsable() const;
+    bool keyIndexAccepts(const ClusterKeyIndex::Entry &entry) const;
+
     QAction* _modeSep;
     QAction* _modeAct;
 
@@ -83,6 +86,7 @@ class XTUPLEWIDGETS_EXPORT CLineEdit : public VirtualClusterLineEdit
   private:
     CLineEditTypes	_type;
     CRMAcctLineEdit::CRMAcctSubtype _subtype;
+    QString             _typeClause;
     int                 _crmacctId;
     bool                _canEdit;
     bool                _editMode;
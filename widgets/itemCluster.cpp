@@ -18,6 +18,7 @@
 #include "itemcluster.h"
 #include "itemAliasList.h"
 #include "xsqltablemodel.h"
+#include "xtreewidgetsearchindex.h"
 
 #define DEBUG false
 
@@ -144,6 +145,52 @@ QString buildItemLineEditQuery(const QString pPre, const QStringList pClauses, c
   return sql;
 }
 
+/* the item ItemLineEdit::sParse would find for pText by number or UPC
+   code, from the item ClusterKeyIndex, or -1 if only the server can say.
+   pNone is set if no item of pType starts with pText at all, which is
+   when sParse moves on from numbers to UPC codes. */
+static int itemIndexLookup(const QString &pText, const unsigned int pType,
+                           ClusterKeyIndex::Key pKey, bool *pNone = 0)
+{
+  if (pNone)
+    *pNone = false;
+
+  ClusterKeyIndex *index = ClusterKeyIndex::index("item");
+  if (! index || ! index->isReady() ||
+      (pType & (ItemLineEdit::cLocationControlled | ItemLineEdit::cLotSerialControlled |
+                ItemLineEdit::cDefaultLocation    | ItemLineEdit::cActive)))
+    return -1;
+
+  QString types;
+  if (pType & ItemLineEdit::cPurchased)      types += "P";
+  if (pType & ItemLineEdit::cManufactured)   types += "M";
+  if (pType & ItemLineEdit::cPhantom)        types += "F";
+  if (pType & ItemLineEdit::cBreeder)        types += "B";
+  if (pType & ItemLineEdit::cCoProduct)      types += "C";
+  if (pType & ItemLineEdit::cByProduct)      types += "Y";
+  if (pType & ItemLineEdit::cReference)      types += "R";
+  if (pType & ItemLineEdit::cCosting)        types += "S";
+  if (pType & ItemLineEdit::cTooling)        types += "T";
+  if (pType & ItemLineEdit::cOutsideProcess) types += "O";
+  if (pType & ItemLineEdit::cPlanning)       types += "L";
+  if (pType & ItemLineEdit::cKit)            types += "K";
+
+  bool complete = false;
+  QList<ClusterKeyIndex::Entry> candidates;
+  foreach (ClusterKeyIndex::Entry entry, index->find(pText, Qt::CaseSensitive, pKey, 64, &complete))
+  {
+    if ((! types.isEmpty() && ! types.contains(entry.type)) ||
+        ((pType & ItemLineEdit::cSold) && ! entry.flag) ||
+        ((pType & ItemLineEdit::cItemActive) && ! entry.active))
+      continue;
+    candidates.append(entry);
+  }
+
+  if (pNone)
+    *pNone = complete && candidates.isEmpty();
+  return ClusterKeyIndex::resolve(pText, candidates, complete, pKey);
+}
+
 QString buildItemLineEditTitle(const unsigned int pType, const QString pPost)
 {
   QString caption;
@@ -422,7 +469,7 @@ void ItemLineEdit::silentSetId(const int pId)
     if (completer())
     {
       disconnect(this, SIGNAL(textChanged(QString)), this, SLOT(sHandleCompleter()));
-      static_cast<QSqlQueryModel* >(completer()->model())->setQuery(QSqlQuery());
+      clearCompleter();
     }
 
     _itemNumber = item.value("item_number").toString();
@@ -538,30 +585,32 @@ void ItemLineEdit::sCopy()
   return;
 }
 
-void ItemLineEdit::sHandleCompleter()
+VirtualClusterLineEdit::CompleterQuery ItemLineEdit::completerQuery(const QString &prefix)
 {
-  if (DEBUG) qDebug("%s::sHandleCompleter() entered", qPrintable(objectName()));
-  if (!hasFocus())
-    return;
-
-  QString stripped = text().trimmed().toUpper();
-  if (stripped.isEmpty())
-    return;
+  if (DEBUG) qDebug("%s::completerQuery(%s) entered", qPrintable(objectName()), qPrintable(prefix));
 
-  int width = 0;
-  QSqlQueryModel* model = static_cast<QSqlQueryModel *>(_completer->model());
-  QTreeView * view = static_cast<QTreeView *>(_completer->popup());
-  _parsed = true;
-  XSqlQuery numQ;
+  CompleterQuery query;
+  QString        match;
+  if (completerMode() == PrefixMatch)
+  {
+    QString escaped = prefix;
+    escaped.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+    query.params.append("searchString", escaped + "%");
+    match = "(%1 LIKE <? value(\"searchString\") ?>)";
+  }
+  else
+  {
+    query.params.append("searchString", prefix);
+    match = "(POSITION(<? value(\"searchString\") ?> IN %1)=1)";
+  }
 
   if (_useQuery)
   {
-    numQ.prepare(QString("SELECT *"
-                         "  FROM (%1) data"
-                         " WHERE (POSITION(:number IN item_number)=1)"
-                         " LIMIT 10")
-                 .arg(QString(_sql)).remove(";"));
-    numQ.bindValue(":number", stripped);
+    query.sql = QString("SELECT *"
+                        "  FROM (%1) data"
+                        " WHERE %2"
+                        " LIMIT 10")
+                .arg(QString(_sql).remove(";"), match.arg("item_number"));
   }
   else
   {
@@ -571,44 +620,17 @@ void ItemLineEdit::sHandleCompleter()
 
     QStringList clauses;
     clauses = _extraClauses;
-    clauses << "((POSITION(:searchString IN item_number) = 1)"
-            " OR (POSITION(:searchString IN item_upccode) = 1))";
-    numQ.prepare(buildItemLineEditQuery(pre, clauses, QString::null, _type, true)
-                              .replace(";"," ORDER BY item_number LIMIT 10;"));
-    numQ.bindValue(":searchString", QString(text().trimmed().toUpper()));
-  }
-
-  numQ.exec();
-  if (numQ.first())
-  {
-    int numberCol = numQ.record().indexOf("item_number");
-    int descripCol = numQ.record().indexOf("itemdescrip");
-    model->setQuery(numQ);
-    _completer->setCompletionPrefix(stripped);
-    for (int i = 0; i < model->columnCount(); i++)
-    {
-      if ( (i == numberCol) ||
-           (i == descripCol) )
-      {
-        view->resizeColumnToContents(i);
-        width += view->columnWidth(i);
-      }
-      else
-        view->hideColumn(i);
-    }
+    clauses << "(" + match.arg("item_number") + " OR " + match.arg("item_upccode") + ")";
+    query.sql = buildItemLineEditQuery(pre, clauses, QString::null, _type, true)
+                              .replace(";"," ORDER BY item_number LIMIT 10;");
+    query.matched << "description";
   }
-  else
-    model->setQuery(QSqlQuery());
-
-  if (width > 350)
-    width = 350;
 
-  QRect rect;
-  rect.setHeight(height());
-  rect.setWidth(width);
-  rect.setBottomLeft(QPoint(0, height() - 2));
-  _completer->complete(rect);
-  _parsed = false;
+  query.idColumn = "item_id";
+  query.shown << "item_number" << "itemdescrip";
+  query.matched.prepend("item_number");
+  query.caseSensitivity = Qt::CaseSensitive;
+  return query;
 }
 
 void ItemLineEdit::sUpdateMenu()
@@ -840,6 +862,21 @@ void ItemLineEdit::sParse()
     }
     else
     {
+      if (_extraClauses.isEmpty())
+      {
+        bool noNumber = false;
+        int  itemid   = itemIndexLookup(text().trimmed().toUpper(), _type,
+                                        ClusterKeyIndex::Number, &noNumber);
+        if (itemid < 0 && noNumber)
+          itemid = itemIndexLookup(text().trimmed().toUpper(), _type,
+                                   ClusterKeyIndex::Upc);
+        if (itemid > 0)
+        {
+          setId(itemid);
+          return;
+        }
+      }
+
       XSqlQuery item;
 
       QString pre( "SELECT DISTINCT item_id, item_number AS number, "
@@ -1020,6 +1057,8 @@ itemList::itemList(QWidget* pParent, Qt::WindowFlags pFlags ) :
   _listTab->addColumn(tr("Item Number"), 100, Qt::AlignLeft, true);
   _listTab->addColumn(tr("Description"),  -1, Qt::AlignLeft, true);
   _listTab->addColumn(tr("Bar Code"),    100, Qt::AlignLeft, true);
+
+  _searchIndex = new XTreeWidgetSearchIndex(_listTab, QList<int>() << 0 << 1 << 2, this);
 }
 
 void itemList::set(const ParameterList &pParams)
@@ -1080,17 +1119,11 @@ void itemList::sSearch(const QString &pTarget)
 
   _listTab->clearSelection();
 
-  int i;
-  for (i = 0; i < _listTab->topLevelItemCount(); i++)
-    if (_listTab->topLevelItem(i)->text(0).startsWith(pTarget, Qt::CaseInsensitive) ||
-        _listTab->topLevelItem(i)->text(1).startsWith(pTarget, Qt::CaseInsensitive) ||
-        _listTab->topLevelItem(i)->text(2).startsWith(pTarget, Qt::CaseInsensitive))
-      break;
-
-  if (i < _listTab->topLevelItemCount())
+  QTreeWidgetItem *found = _searchIndex->startsWith(pTarget);
+  if (found)
   {
-    _listTab->setCurrentItem(_listTab->topLevelItem(i));
-    _listTab->scrollToItem(_listTab->topLevelItem(i));
+    _listTab->setCurrentItem(found);
+    _listTab->scrollToItem(found);
   }
 }
 
@@ -30,6 +30,7 @@ class QMouseEvent;
 class ItemLineEditDelegate;
 class itemList;
 class itemSearch;
+class XTreeWidgetSearchIndex;
 
 class XTUPLEWIDGETS_EXPORT itemList : public VirtualList
 {
@@ -54,6 +55,7 @@ private:
     bool _useQuery;
     QString _sql;
     QStringList _extraClauses;
+    XTreeWidgetSearchIndex *_searchIndex;
 };
 
 class XTUPLEWIDGETS_EXPORT itemSearch : public VirtualSearch
@@ -162,7 +164,6 @@ friend class ItemLineEditDelegate;
     Q_INVOKABLE bool    isFractional();
 
   public slots:
-    void sHandleCompleter();
     void sInfo();
     void sCopy();
     void sList();
@@ -191,6 +192,9 @@ friend class ItemLineEditDelegate;
     void warehouseIdChanged(int);
     void valid(bool);
 
+  protected:
+    CompleterQuery completerQuery(const QString &prefix);
+
   protected slots:
     itemList* listFactory();
     itemSearch* searchFactory();
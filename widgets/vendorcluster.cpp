@@ -21,6 +21,7 @@ VendorLineEdit::VendorLineEdit(QWidget *pParent, const char *pName) :
   setViewPriv("ViewVendors");
   setNewPriv("MaintainVendors");
 
+  _keyIndexName = "vend";
   _query = "SELECT vend_id AS id, vend_number AS number, vend_name AS name, vendtype_code AS type,"
            "       addr.*,"
            "       formatAddr(addr_line1, addr_line2, addr_line3, '', '') AS street,"
@@ -8,25 +8,51 @@
  * to be bound by its terms.
  */
 
+#include <QApplication>
 #include <QDebug>
 #include <QGridLayout>
 #include <QHBoxLayout>
 #include <QKeySequence>
 #include <QMessageBox>
+#include <QRegExp>
 #include <QSqlError>
+#include <QSqlField>
 #include <QSqlRecord>
+#include <QStandardItemModel>
+#include <QTimer>
 #include <QVBoxLayout>
 
 #include "xlineedit.h"
 #include "xcheckbox.h"
 #include "xsqlquery.h"
 #include "xsqltablemodel.h"
+#include "querythread.h"
 #include "shortcuts.h"
 
 #include "virtualCluster.h"
 
 #define DEBUG false
 
+#define COMPLETERDELAY  150   // ms to wait for the next keystroke
+#define COMPLETERLIMIT   10   // rows shown in the completer popup
+#define COMPLETERCACHE    8   // prefixes remembered per line edit
+#define KEYINDEXLIMIT    64   // index entries examined per lookup
+
+/* every VirtualClusterLineEdit shares one worker connection for its
+   type-ahead queries. only one of them has the focus at a time, and
+   starting a new query abandons whatever the last keystroke asked for.
+ */
+static QueryThread *completerThread()
+{
+  static QueryThread *thread = 0;
+  if (! thread)
+  {
+    thread = new QueryThread(qApp);
+    thread->setFirstChunk(COMPLETERLIMIT);
+  }
+  return thread;
+}
+
 void VirtualCluster::init()
 {
     _number = 0;
@@ -286,6 +312,14 @@ VirtualClusterLineEdit::VirtualClusterLineEdit(QWidget* pParent,
     _completer = 0;
     _showInactive = false;
     _completerId = 0;
+    _completerMode = RegexMatch;
+    _completerTimer = 0;
+    _completerRequest = -1;
+    _completerQueries = 0;
+    _completerHits = 0;
+    _completerTotalMs = 0;
+    _completerMaxMs = 0;
+    _completerLastMs = 0;
 
     setTableAndColumnNames(pTabName, pIdColumn, pNumberColumn, pNameColumn, pDescripColumn, pActiveColumn);
 
@@ -303,7 +337,10 @@ VirtualClusterLineEdit::VirtualClusterLineEdit(QWidget* pParent,
     {
       if (!_x_metrics->boolean("DisableAutoComplete"))
       {
-        QSqlQueryModel* hints = new QSqlQueryModel(this);
+        if (_x_metrics->value("AutoCompleteMode") == "prefix")
+          _completerMode = PrefixMatch;
+
+        QStandardItemModel* hints = new QStandardItemModel(this);
         _completer = new QCompleter(hints,this);
         _completer->setWidget(this);
         QTreeView* view = new QTreeView(this);
@@ -318,6 +355,17 @@ VirtualClusterLineEdit::VirtualClusterLineEdit(QWidget* pParent,
         connect(this, SIGNAL(textEdited(QString)), this, SLOT(sHandleCompleter()));
         connect(_completer, SIGNAL(highlighted(QString)), this, SLOT(setText(QString)));
         connect(_completer, SIGNAL(highlighted(const QModelIndex &)), this, SLOT(completerHighlighted(const QModelIndex &)));
+
+        _completerTimer = new QTimer(this);
+        _completerTimer->setSingleShot(true);
+        _completerTimer->setInterval(COMPLETERDELAY);
+        connect(_completerTimer, SIGNAL(timeout()), this, SLOT(sCompleterTimeout()));
+
+        QueryThread *thread = completerThread();
+        connect(thread, SIGNAL(rowsReady(int)),     this, SLOT(sCompleterRowsReady(int)));
+        connect(thread, SIGNAL(queryFinished(int)), this, SLOT(sCompleterFinished(int)));
+        connect(thread, SIGNAL(queryFailed(int, const QString&)),
+                this,   SLOT(sCompleterFailed(int, const QString&)));
       }
     }
 
@@ -500,59 +548,334 @@ void VirtualClusterLineEdit::setMenu(QMenu *menu)
   _menu = menu;
 }
 
+/* wait for the user to stop typing before looking anything up, so a fast
+   typist doesn't start a query per keystroke
+ */
 void VirtualClusterLineEdit::sHandleCompleter()
 {
-  if (!hasFocus())
+  if (!hasFocus() || !_completer)
     return;
 
   QString stripped = text().trimmed().toUpper();
   if (stripped.isEmpty())
     return;
 
-  int width = 0;
-  QSqlQueryModel* model = static_cast<QSqlQueryModel *>(_completer->model());
-  QTreeView * view = static_cast<QTreeView *>(_completer->popup());
-  _parsed = true;
-  XSqlQuery numQ;
-  numQ.prepare(_query + _numClause +
-               (_extraClause.isEmpty() || !_strict ? "" : " AND " + _extraClause) +
-               ((_hasActive && ! _showInactive) ? _activeClause : "") +
-               QString(" ORDER BY %1 LIMIT 10;").arg(_numColName));
-  numQ.bindValue(":number", "^" + stripped);
-  numQ.exec();
-  if (numQ.first())
+  _completerText = stripped;
+  _completerTimer->start();
+  _parsed = false;
+}
+
+/*! Return what the completer should run to find the records whose number
+    starts with \a prefix. Subclasses with a different query override this.
+ */
+VirtualClusterLineEdit::CompleterQuery VirtualClusterLineEdit::completerQuery(const QString &prefix)
+{
+  CompleterQuery query;
+  QString        numClause;
+  if (_completerMode == PrefixMatch)
+  {
+    /* LIKE 'prefix%' can use an index on the number column where the
+       regular expression can't, at the cost of matching case exactly */
+    QString escaped = prefix;
+    escaped.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+    numClause = QString(" AND (%1 LIKE <? value(\"number\") ?>) ").arg(_numColName);
+    query.params.append("number", escaped + "%");
+    query.caseSensitivity = Qt::CaseSensitive;
+  }
+  else
+  {
+    numClause = QString(_numClause).replace(":number", "<? value(\"number\") ?>");
+    query.params.append("number", "^" + prefix);
+    query.caseSensitivity = Qt::CaseInsensitive;
+  }
+
+  query.sql = _query + numClause +
+              (_extraClause.isEmpty() || !_strict ? "" : " AND " + _extraClause) +
+              ((_hasActive && ! _showInactive) ? _activeClause : "") +
+              QString(" ORDER BY %1 LIMIT %2;").arg(_numColName).arg(COMPLETERLIMIT);
+  query.idColumn = "id";
+  query.shown << "number";
+  if (_hasName)
+    query.shown << "name";
+  if (_hasDescription)
+    query.shown << "description";
+  query.matched << "number";
+  return query;
+}
+
+/* answer from the results for a shorter prefix if they were complete,
+   otherwise ask the database on the shared completer connection
+ */
+void VirtualClusterLineEdit::sCompleterTimeout()
+{
+  if (!hasFocus() || _completerText.isEmpty())
+    return;
+
+  QString        prefix = _completerText;
+  CompleterQuery query  = completerQuery(prefix);
+
+  int best = -1;
+  for (int i = 0; i < _completerCache.size(); i++)
+  {
+    const CompleterResult &cached = _completerCache.at(i);
+    if (cached.sql != query.sql || ! prefix.startsWith(cached.prefix, query.caseSensitivity))
+      continue;
+    if ((cached.complete || cached.prefix.length() == prefix.length()) &&
+        (best < 0 || cached.prefix.length() > _completerCache.at(best).prefix.length()))
+      best = i;
+  }
+
+  if (best >= 0)
   {
-    int numberCol = numQ.record().indexOf("number");
-    int nameCol = numQ.record().indexOf("name");
-    int descripCol = numQ.record().indexOf("description");
-    model->setQuery(numQ);
-    _completer->setCompletionPrefix(stripped);
+    CompleterResult cached = _completerCache.takeAt(best);
+    _completerCache.prepend(cached);
+    _completerHits++;
 
-    for (int i = 0; i < model->columnCount(); i++)
+    QList<int> matched;
+    for (int i = 0; i < query.matched.size(); i++)
+      matched << cached.fields.indexOf(query.matched.at(i));
+
+    QList<QVariantList> rows;
+    for (int r = 0; r < cached.rows.size() && rows.size() < COMPLETERLIMIT; r++)
     {
-      if ( (i != numberCol) &&
-           (!_hasName || i != nameCol ) &&
-           (!_hasDescription || i != descripCol) )
-      {
-        view->hideColumn(i);
-      }
+      for (int m = 0; m < matched.size(); m++)
+        if (matched.at(m) >= 0 &&
+            cached.rows.at(r).value(matched.at(m)).toString().startsWith(prefix, query.caseSensitivity))
+        {
+          rows.append(cached.rows.at(r));
+          break;
+        }
     }
 
-    view->resizeColumnToContents(numberCol);
-    width += view->columnWidth(numberCol);
-    if (_hasName)
+    if (DEBUG)
+      qDebug("%s::sCompleterTimeout(%s) answered from %s, %d rows",
+             qPrintable(objectName()), qPrintable(prefix),
+             qPrintable(cached.prefix), rows.size());
+
+    _completerRequest = -1;   // whatever is still running is stale now
+    showCompletions(prefix, query, cached.fields, rows);
+    return;
+  }
+
+  QSqlRecord          fields;
+  QList<QVariantList> rows;
+  if (keyIndexCompletions(prefix, query.caseSensitivity, fields, rows))
+  {
+    _completerRequest = -1;
+    showCompletions(prefix, query, fields, rows);
+    return;
+  }
+
+  _completerPrefix = prefix;
+  _completerQuery  = query;
+  _completerFields = QSqlRecord();
+  _completerRows.clear();
+  _completerClock.start();
+  _completerRequest = completerThread()->exec(query.sql, query.params);
+}
+
+void VirtualClusterLineEdit::sCompleterRowsReady(int request)
+{
+  if (request != _completerRequest)
+    return;
+
+  QSqlRecord          fields;
+  QList<QVariantList> rows;
+  if (completerThread()->takeRows(request, fields, rows))
+  {
+    _completerFields = fields;
+    _completerRows  += rows;
+  }
+}
+
+void VirtualClusterLineEdit::sCompleterFinished(int request)
+{
+  if (request != _completerRequest)
+    return;
+
+  sCompleterRowsReady(request);
+  _completerRequest = -1;
+
+  _completerLastMs   = _completerClock.elapsed();
+  _completerTotalMs += _completerLastMs;
+  _completerMaxMs    = qMax(_completerMaxMs, _completerLastMs);
+  _completerQueries++;
+
+  if (DEBUG)
+    qDebug("%s::sCompleterFinished(%s) %d rows in %d ms",
+           qPrintable(objectName()), qPrintable(_completerPrefix),
+           _completerRows.size(), _completerLastMs);
+
+  CompleterResult result;
+  result.sql      = _completerQuery.sql;
+  result.prefix   = _completerPrefix;
+  result.fields   = _completerFields;
+  result.rows     = _completerRows;
+  result.complete = _completerRows.size() < COMPLETERLIMIT;
+  _completerCache.prepend(result);
+  while (_completerCache.size() > COMPLETERCACHE)
+    _completerCache.removeLast();
+
+  if (_completerText == _completerPrefix)
+    showCompletions(_completerPrefix, _completerQuery, _completerFields, _completerRows);
+  else if (_completerText.startsWith(_completerPrefix) && hasFocus())
+    sCompleterTimeout();    // the user kept typing; maybe we can answer from this
+}
+
+void VirtualClusterLineEdit::sCompleterFailed(int request, const QString &msg)
+{
+  if (request != _completerRequest)
+    return;
+
+  _completerRequest = -1;
+  qWarning("%s could not look up completions for %s: %s",
+           qPrintable(objectName()), qPrintable(_completerPrefix), qPrintable(msg));
+}
+
+/*! Return how the type-ahead completer has performed for this line edit:
+    the number of queries run, the number of lookups answered from
+    earlier results, and the last, average, and longest query times in
+    milliseconds.
+ */
+QVariantMap VirtualClusterLineEdit::completerStats() const
+{
+  QVariantMap stats;
+  stats.insert("queries",   _completerQueries);
+  stats.insert("cacheHits", _completerHits);
+  stats.insert("lastMs",    _completerLastMs);
+  stats.insert("averageMs", _completerQueries ? _completerTotalMs / _completerQueries : 0);
+  stats.insert("maxMs",     _completerMaxMs);
+  return stats;
+}
+
+/* empty the completer and forget anything still being looked up */
+void VirtualClusterLineEdit::clearCompleter()
+{
+  if (! _completer)
+    return;
+
+  _completerTimer->stop();
+  _completerRequest = -1;
+  QAbstractItemModel *model = _completer->model();
+  model->removeRows(0, model->rowCount());
+}
+
+/*! Return true if this line edit may look its numbers up in its
+    ClusterKeyIndex. That's only safe if the index knows about every
+    condition the query would apply, so by default a strict extra clause
+    sends the lookup to the server.
+ */
+bool VirtualClusterLineEdit::keyIndexUsable() const
+{
+  return ! _keyIndexName.isEmpty() && (_extraClause.isEmpty() || ! _strict);
+}
+
+/*! Return true if \a entry would pass the conditions the query applies.
+ */
+bool VirtualClusterLineEdit::keyIndexAccepts(const ClusterKeyIndex::Entry &entry) const
+{
+  return entry.active || ! _hasActive || _showInactive;
+}
+
+/* the id sParse would find for text, or -1 if only the server can say */
+int VirtualClusterLineEdit::keyIndexLookup(const QString &text)
+{
+  ClusterKeyIndex *index = keyIndexUsable() ? ClusterKeyIndex::index(_keyIndexName) : 0;
+  if (! index || ! index->isReady() || text.contains(QRegExp("[\\\\.^$|?*+()\\[\\]{}]")))
+    return -1;
+
+  bool complete = false;
+  QList<ClusterKeyIndex::Entry> candidates;
+  foreach (ClusterKeyIndex::Entry entry, index->find(text, Qt::CaseInsensitive,
+                                                     ClusterKeyIndex::Number,
+                                                     KEYINDEXLIMIT, &complete))
+    if (keyIndexAccepts(entry))
+      candidates.append(entry);
+
+  int id = ClusterKeyIndex::resolve(text, candidates, complete);
+  if (DEBUG)
+    qDebug("%s::keyIndexLookup(%s) found %d of %d candidates",
+           qPrintable(objectName()), qPrintable(text), id, candidates.size());
+  return id;
+}
+
+/* the completer rows for prefix straight from the ClusterKeyIndex, in
+   the shape completerQuery() would return them; false if the index
+   can't answer */
+bool VirtualClusterLineEdit::keyIndexCompletions(const QString &prefix, Qt::CaseSensitivity cs,
+                                                 QSqlRecord &fields, QList<QVariantList> &rows)
+{
+  ClusterKeyIndex *index = keyIndexUsable() ? ClusterKeyIndex::index(_keyIndexName) : 0;
+  if (! index || ! index->isReady() ||
+      (cs == Qt::CaseInsensitive && prefix.contains(QRegExp("[\\\\.^$|?*+()\\[\\]{}]"))))
+    return false;
+
+  bool complete = false;
+  QList<ClusterKeyIndex::Entry> found = index->find(prefix, cs, ClusterKeyIndex::Number,
+                                                    KEYINDEXLIMIT, &complete);
+  for (int i = 0; i < found.size() && rows.size() < COMPLETERLIMIT; i++)
+  {
+    if (! keyIndexAccepts(found.at(i)))
+      continue;
+    QVariantList row;
+    row << found.at(i).id << found.at(i).number
+        << found.at(i).name << found.at(i).description;
+    rows.append(row);
+  }
+  if (rows.size() < COMPLETERLIMIT && ! complete)
+  {
+    rows.clear();
+    return false;
+  }
+
+  fields.append(QSqlField("id",          QVariant::Int));
+  fields.append(QSqlField("number",      QVariant::String));
+  fields.append(QSqlField("name",        QVariant::String));
+  fields.append(QSqlField("description", QVariant::String));
+  return true;
+}
+
+void VirtualClusterLineEdit::showCompletions(const QString &prefix, const CompleterQuery &query,
+                                             const QSqlRecord &fields, const QList<QVariantList> &rows)
+{
+  if (! hasFocus())
+    return;
+
+  int width = 0;
+  QStandardItemModel* model = static_cast<QStandardItemModel *>(_completer->model());
+  QTreeView * view = static_cast<QTreeView *>(_completer->popup());
+  _parsed = true;
+
+  QList<int> cols;
+  cols << qMax(0, fields.indexOf(query.idColumn));
+  for (int i = 0; i < query.shown.size(); i++)
+    cols << fields.indexOf(query.shown.at(i));
+
+  model->clear();
+  model->setColumnCount(cols.size());
+  for (int r = 0; r < rows.size(); r++)
+  {
+    QList<QStandardItem *> items;
+    for (int c = 0; c < cols.size(); c++)
     {
-      view->resizeColumnToContents(nameCol);
-      width += view->columnWidth(nameCol);
+      QStandardItem *item = new QStandardItem();
+      item->setData(rows.at(r).value(cols.at(c)), Qt::DisplayRole);
+      items << item;
     }
-    if (_hasDescription)
+    model->appendRow(items);
+  }
+
+  if (rows.size())
+  {
+    _completer->setCompletionPrefix(prefix);
+    view->hideColumn(0);
+    for (int c = 1; c < cols.size(); c++)
     {
-      view->resizeColumnToContents(descripCol);
-      width += view->columnWidth(descripCol);
+      view->showColumn(c);
+      view->resizeColumnToContents(c);
+      width += view->columnWidth(c);
     }
   }
-  else
-    model->setQuery(QSqlQuery());
 
   if (width > 350)
     width = 350;
@@ -733,8 +1056,7 @@ void VirtualClusterLineEdit::silentSetId(const int pId)
     idQ.exec();
     if (idQ.first())
     {
-      if (_completer)
-        static_cast<QSqlQueryModel* >(_completer->model())->setQuery(QSqlQuery());
+      clearCompleter();
 
       _id = pId;
       _valid = true;
@@ -782,11 +1104,17 @@ void VirtualClusterLineEdit::sParse()
     else if (! _parsed)
     {
       QString stripped = text().trimmed().toUpper();
+      int     indexed  = keyIndexLookup(stripped);
       if (stripped.length() == 0)
       {
         _parsed = true;
 	setId(-1);
       }
+      else if (indexed > 0)
+      {
+        _valid = true;
+        setId(indexed);
+      }
       else
       {
         XSqlQuery numQ;
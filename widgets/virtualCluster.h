@@ -12,6 +12,7 @@
 #define virtCluster_h
 
 #include "widgets.h"
+#include "clusterkeyindex.h"
 #include "guiclientinterface.h"
 #include "parameter.h"
 #include "xlineedit.h"
@@ -31,10 +32,14 @@
 #include <QMenu>
 #include <QPushButton>
 #include <QSqlQueryModel>
+#include <QSqlRecord>
+#include <QTime>
 #include <QVBoxLayout>
 #include <QWidget>
 
 class QGridLayout;
+class QStandardItemModel;
+class QTimer;
 class VirtualClusterLineEdit;
 
 #define ID              1
@@ -158,6 +163,7 @@ class XTUPLEWIDGETS_EXPORT VirtualInfo : public QDialog
 class XTUPLEWIDGETS_EXPORT VirtualClusterLineEdit : public XLineEdit
 {
     Q_OBJECT
+    Q_ENUMS(CompleterMode)
     
     friend class VirtualCluster;
     friend class VirtualInfo;
@@ -184,6 +190,11 @@ class XTUPLEWIDGETS_EXPORT VirtualClusterLineEdit : public XLineEdit
        Q_INVOKABLE inline virtual QString name()        const { return _name; }
        Q_INVOKABLE inline virtual QString description() const { return _description; }
 
+       enum CompleterMode { RegexMatch, PrefixMatch };
+       Q_INVOKABLE inline CompleterMode completerMode() const { return _completerMode; }
+       Q_INVOKABLE inline void setCompleterMode(CompleterMode p) { _completerMode = p; _completerCache.clear(); }
+       Q_INVOKABLE QVariantMap completerStats() const;
+
     public slots:
         virtual void clear();
         virtual QString extraClause() const { return _extraClause; }
@@ -230,6 +241,10 @@ class XTUPLEWIDGETS_EXPORT VirtualClusterLineEdit : public XLineEdit
         bool isStrict() const { return _strict; }
 
         virtual void completerHighlighted(const QModelIndex &);
+        virtual void sCompleterTimeout();
+        virtual void sCompleterRowsReady(int);
+        virtual void sCompleterFinished(int);
+        virtual void sCompleterFailed(int, const QString &);
 
     signals:
         void newId(int);
@@ -241,6 +256,27 @@ class XTUPLEWIDGETS_EXPORT VirtualClusterLineEdit : public XLineEdit
         virtual void focusInEvent(QFocusEvent * event);
         virtual void resizeEvent(QResizeEvent *e);
 
+        /* what the type-ahead completer runs for a prefix: MetaSQL text
+           and its parameters, the id column, the columns to show, and
+           the columns the prefix is matched against */
+        struct CompleterQuery
+        {
+          QString             sql;
+          ParameterList       params;
+          QString             idColumn;
+          QStringList         shown;
+          QStringList         matched;
+          Qt::CaseSensitivity caseSensitivity;
+        };
+        virtual CompleterQuery completerQuery(const QString &prefix);
+        void clearCompleter();
+
+        /* subclasses whose numbers are in a ClusterKeyIndex set
+           _keyIndexName, and override these if their extra clause can
+           be checked against the index entries */
+        virtual bool keyIndexUsable() const;
+        virtual bool keyIndexAccepts(const ClusterKeyIndex::Entry &entry) const;
+
         QAction* _infoAct;
         QAction* _openAct;
         QAction* _copyAct;
@@ -262,6 +298,7 @@ class XTUPLEWIDGETS_EXPORT VirtualClusterLineEdit : public XLineEdit
         QString _nameColName;
         QString _descripColName;
         QString _activeColName;
+        QString _keyIndexName;
         QString _uiName;
         QString _editPriv;
         QString _newPriv;
@@ -279,8 +316,38 @@ class XTUPLEWIDGETS_EXPORT VirtualClusterLineEdit : public XLineEdit
 
     private:
         void positionMenuLabel();
+        int  keyIndexLookup(const QString &text);
+        bool keyIndexCompletions(const QString &prefix, Qt::CaseSensitivity cs,
+                                 QSqlRecord &fields, QList<QVariantList> &rows);
+        void showCompletions(const QString &prefix, const CompleterQuery &query,
+                             const QSqlRecord &fields, const QList<QVariantList> &rows);
 
         QString _cText;
+
+        struct CompleterResult
+        {
+          QString             sql;
+          QString             prefix;
+          QSqlRecord          fields;
+          QList<QVariantList> rows;
+          bool                complete;   // fewer rows than the limit
+        };
+
+        CompleterMode          _completerMode;
+        QTimer                *_completerTimer;
+        QString                _completerText;
+        int                    _completerRequest;
+        QString                _completerPrefix;
+        CompleterQuery         _completerQuery;
+        QSqlRecord             _completerFields;
+        QList<QVariantList>    _completerRows;
+        QList<CompleterResult> _completerCache;   // most recent first
+        QTime                  _completerClock;
+        int                    _completerQueries;
+        int                    _completerHits;
+        int                    _completerTotalMs;
+        int                    _completerMaxMs;
+        int                    _completerLastMs;
 };
 
 /*
@@ -9,6 +9,7 @@
  */
 
 #include "widgets.h"
+#include "clusterkeyindex.h"
 
 #include "xtupleplugin.h"
 
@@ -193,4 +194,6 @@ void initializePlugin(Preferences *pPreferences, Metrics *pMetrics, Privileges *
   _x_workspace = pWorkspace;
   _x_privileges = pPrivileges;
   _x_username = pUsername;
+
+  ClusterKeyIndex::preload();
 }
@@ -118,6 +118,7 @@ SOURCES += widgets.cpp \
     alarms.cpp \
     aropencluster.cpp \
     calendarTools.cpp \
+    clusterkeyindex.cpp \
     cmheadcluster.cpp \
     comment.cpp \
     comments.cpp \
@@ -184,6 +185,7 @@ SOURCES += widgets.cpp \
     workcenterCluster.cpp \
     xcheckbox.cpp \
     xcombobox.cpp \
+    xcomboboxcache.cpp \
     xdatawidgetmapper.cpp \
     xdoccopysetter.cpp \
     xdoublevalidator.cpp \
@@ -197,7 +199,11 @@ SOURCES += widgets.cpp \
     xtextedit.cpp \
     xtreeview.cpp \
     xtreewidget.cpp \
+    xtreewidgetexporter.cpp \
+    xtreewidgetpopulateplan.cpp \
     xtreewidgetprogress.cpp \
+    xtreewidgetresultset.cpp \
+    xtreewidgetsearchindex.cpp \
     xurllabel.cpp \
 
 HEADERS += widgets.h \
@@ -208,6 +214,7 @@ HEADERS += widgets.h \
     alarms.h \
     aropencluster.h \
     calendarTools.h \
+    clusterkeyindex.h \
     cmheadcluster.h \
     comment.h \
     comments.h \
@@ -275,6 +282,7 @@ HEADERS += widgets.h \
     workcentercluster.h \
     xcheckbox.h \
     xcombobox.h \
+    xcomboboxcache.h \
     xcomboboxprivate.h \
     xdatawidgetmapper.h \
     xdoccopysetter.h \
@@ -289,7 +297,11 @@ HEADERS += widgets.h \
     xtextedit.h \
     xtreeview.h \
     xtreewidget.h \
+    xtreewidgetexporter.h \
+    xtreewidgetpopulateplan.h \
     xtreewidgetprogress.h \
+    xtreewidgetresultset.h \
+    xtreewidgetsearchindex.h \
     xurllabel.h \
 
 FORMS += alarmMaint.ui \
@@ -15,6 +15,7 @@
 
 #include "guiclientinterface.h"
 #include "widgets.h"
+#include "xcomboboxcache.h"
 
 #include <xsqlquery.h>
 
@@ -165,6 +166,7 @@ class XTUPLEWIDGETS_EXPORT XComboBox : public QComboBox
   protected:
     QString      currentDefault();
     void         mousePressEvent(QMouseEvent *);
+    void         populate(const QList<XComboBoxCache::Row> &, int = -1);
 
     bool              _allowNull;
     XComboBoxPrivate *_data;
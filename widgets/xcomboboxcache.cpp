@@ -0,0 +1,149 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "xcomboboxcache.h"
+
+#include <QRegExp>
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlError>
+
+#include "xsqlquery.h"
+
+#define DEBUG false
+
+/* the tables named after FROM or JOIN in a query, without their schema */
+static QStringList tablesIn(const QString &sql)
+{
+  QStringList tables;
+  QRegExp     from("\\b(?:FROM|JOIN)\\s+(?:\\w+\\.)?(\\w+)", Qt::CaseInsensitive);
+  for (int pos = from.indexIn(sql); pos >= 0; pos = from.indexIn(sql, pos + from.matchedLength()))
+  {
+    QString table = from.cap(1).toLower();
+    if (! tables.contains(table))
+      tables.append(table);
+  }
+  return tables;
+}
+
+XComboBoxCache *XComboBoxCache::instance()
+{
+  static XComboBoxCache *cache = 0;
+  if (! cache)
+    cache = new XComboBoxCache();
+  return cache;
+}
+
+XComboBoxCache::XComboBoxCache(QObject *parent)
+  : QObject(parent),
+    _hits(0),
+    _misses(0)
+{
+  QObject::connect(QSqlDatabase::database().driver(), SIGNAL(notification(const QString&)),
+                   this, SLOT(sNotified(const QString &)));
+}
+
+/*! Return the id, text, and code of each row \a sql selects for the
+    XComboBoxTypes \a type, running the query only if this type hasn't
+    been loaded yet or the cached rows came from different SQL. \a ok is
+    set to false if the query fails; failures are not cached.
+ */
+QList<XComboBoxCache::Row> XComboBoxCache::rows(int type, const QString &sql, bool *ok)
+{
+  if (ok)
+    *ok = true;
+  if (sql.isEmpty())
+    return QList<Row>();
+
+  QHash<int, Entry>::const_iterator cached = _cache.constFind(type);
+  if (cached != _cache.constEnd() && cached.value().sql == sql)
+  {
+    _hits++;
+    return cached.value().rows;
+  }
+  _misses++;
+
+  Entry loaded;
+  loaded.sql    = sql;
+  loaded.tables = tablesIn(sql);
+
+  XSqlQuery query;
+  if (! query.exec(sql))
+  {
+    qWarning("XComboBoxCache::rows(%d) %s", type,
+             qPrintable(query.lastError().databaseText()));
+    if (ok)
+      *ok = false;
+    return loaded.rows;
+  }
+
+  while (query.next())
+  {
+    Row row;
+    row.id   = query.value(0).toInt();
+    row.text = query.value(1).toString();
+    row.code = query.value(2).toString();
+    loaded.rows.append(row);
+  }
+
+  QSqlDriver *driver = QSqlDatabase::database().driver();
+  foreach (QString table, loaded.tables)
+  {
+    if (! _subscribed.contains(table))
+    {
+      driver->subscribeToNotification(table + "Updated");
+      _subscribed.insert(table);
+    }
+  }
+
+  if (DEBUG)
+    qDebug("XComboBoxCache::rows(%d) loaded %d rows from %s, %d hits, %d misses",
+           type, loaded.rows.size(), qPrintable(loaded.tables.join(",")),
+           _hits, _misses);
+
+  _cache.insert(type, loaded);
+  return loaded.rows;
+}
+
+void XComboBoxCache::clear()
+{
+  _cache.clear();
+}
+
+/*! Forget the rows for \a type so the next combo box of that type
+    queries the database again.
+ */
+void XComboBoxCache::invalidate(int type)
+{
+  _cache.remove(type);
+}
+
+void XComboBoxCache::sNotified(const QString &note)
+{
+  if (! note.endsWith("Updated"))
+    return;
+
+  QString table = note.left(note.length() - QString("Updated").length()).toLower();
+  if (! _subscribed.contains(table))
+    return;
+
+  QMutableHashIterator<int, Entry> it(_cache);
+  while (it.hasNext())
+  {
+    it.next();
+    if (it.value().tables.contains(table))
+    {
+      if (DEBUG)
+        qDebug("XComboBoxCache::sNotified(%s) dropping type %d",
+               qPrintable(note), it.key());
+      it.remove();
+    }
+  }
+}
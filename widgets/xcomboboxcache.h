@@ -0,0 +1,73 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __XCOMBOBOXCACHE_H__
+#define __XCOMBOBOXCACHE_H__
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/* The rows behind the fixed XComboBox types, loaded the first time a
+   combo box of each type is populated and shared by every XComboBox in
+   the application afterwards, so opening a window full of them doesn't
+   run a query per combo box.
+
+   Each entry remembers the tables its query reads. When the database
+   sends <table>Updated for one of them, such as uomUpdated or
+   cmnttypeUpdated, the entries that read that table are dropped and
+   reloaded the next time they're needed.
+*/
+class XComboBoxCache : public QObject
+{
+  Q_OBJECT
+
+  public:
+    struct Row
+    {
+      int     id;
+      QString text;
+      QString code;
+    };
+
+    static XComboBoxCache *instance();
+
+    QList<Row> rows(int type, const QString &sql, bool *ok = 0);
+
+    int hits()   const { return _hits;   }
+    int misses() const { return _misses; }
+
+  public slots:
+    void clear();
+    void invalidate(int type);
+
+  protected slots:
+    void sNotified(const QString &note);
+
+  private:
+    XComboBoxCache(QObject *parent = 0);
+
+    struct Entry
+    {
+      QString     sql;
+      QStringList tables;
+      QList<Row>  rows;
+    };
+
+    QHash<int, Entry> _cache;
+    QSet<QString>     _subscribed;
+    int               _hits;
+    int               _misses;
+};
+
+#endif
@@ -23,6 +23,7 @@ void setupXt(QScriptEngine *engine)
   glob.setProperty("TotalInitRole",   QScriptValue(engine, Xt::TotalInitRole),   QScriptValue::ReadOnly | QScriptValue::Undeletable);
   glob.setProperty("IndentRole",      QScriptValue(engine, Xt::IndentRole),      QScriptValue::ReadOnly | QScriptValue::Undeletable);
   glob.setProperty("DeletedRole",     QScriptValue(engine, Xt::DeletedRole),     QScriptValue::ReadOnly | QScriptValue::Undeletable);
+  glob.setProperty("RunningValueRole", QScriptValue(engine, Xt::RunningValueRole), QScriptValue::ReadOnly | QScriptValue::Undeletable);
 
   glob.setProperty("AllModules",         QScriptValue(engine, Xt::AllModules),      QScriptValue::ReadOnly | QScriptValue::Undeletable);
   glob.setProperty("AccountingModule",   QScriptValue(engine, Xt::AccountingModule),QScriptValue::ReadOnly | QScriptValue::Undeletable);
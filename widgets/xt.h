@@ -19,7 +19,8 @@ class Xt
     TotalSetRole,
     TotalInitRole,
     IndentRole,
-    DeletedRole
+    DeletedRole,
+    RunningValueRole
   };
 
   enum StandardModules
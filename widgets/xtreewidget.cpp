@@ -14,6 +14,7 @@
 
 #include <QAction>
 #include <QApplication>
+#include <QBuffer>
 #include <QAbstractItemView>
 #include <QClipboard>
 #include <QDate>
@@ -26,21 +27,30 @@
 #include <QMimeData>
 #include <QMouseEvent>
 #include <QProgressBar>
+#include <QProgressDialog>
 #include <QPushButton>
+#include <QScrollBar>
 #include <QSqlError>
+#include <QSqlField>
 #include <QSqlRecord>
 #include <QTextCharFormat>
 #include <QTextCursor>
 #include <QTextDocument>
-#include <QTextDocumentWriter>
 #include <QTextEdit>
 #include <QTextTable>
 #include <QTextTableCell>
 #include <QTextTableFormat>
+#include <QTreeWidgetItemIterator>
+#include <QThread>
+#include <QtConcurrentRun>
 #include <QtScript>
 #include <QMessageBox>
 
+#include "xtreewidgetpopulateplan.h"
+#include "xtreewidgetexporter.h"
 #include "xtreewidgetprogress.h"
+#include "xtreewidgetresultset.h"
+#include "xtreewidgetsearchindex.h"
 #include "xtsettings.h"
 #include "xsqlquery.h"
 #include "format.h"
@@ -50,27 +60,8 @@
 #define WORKERINTERVAL 0
 #define WORKERROWS     500
 
-/* make sure the colroles are kept in sync with
-   QStringList knownroles in populate() below,
-   both in count and order
-   */
-#define COLROLE_DISPLAY       0
-#define COLROLE_TEXTALIGNMENT 1
-#define COLROLE_BACKGROUND    2
-#define COLROLE_FOREGROUND    3
-#define COLROLE_TOOLTIP       4
-#define COLROLE_STATUSTIP     5
-#define COLROLE_FONT          6
-#define COLROLE_KEY           7
-#define COLROLE_RUNNING       8
-#define COLROLE_RUNNINGINIT   9
-#define COLROLE_GROUPRUNNING  10
-#define COLROLE_TOTAL         11
-#define COLROLE_NUMERIC       12
-#define COLROLE_NULL          13
-#define COLROLE_ID            14
-// make sure COLROLE_COUNT = last COLROLE + 1
-#define COLROLE_COUNT         15
+#define SORTPARALLELROWS 20000
+#define SORTMAXRUNS      8
 
 #define yesStr QObject::tr("Yes")
 #define noStr  QObject::tr("No")
@@ -79,26 +70,93 @@ GuiClientInterface *XTreeWidget::_guiClientInterface = 0;
 
 static QTreeWidgetItem *searchChildren(XTreeWidgetItem *item, int pId);
 
-// cint() and round() regarding Issue #8897
-#include <cmath>
+/* the populate() input adapters. XTreeWidgetQueryRows reads directly from
+   an XSqlQuery; XTreeWidgetListRows walks rows that have already been
+   copied out of a query, e.g. by a background thread.
+*/
+class XTreeWidgetQueryRows : public XTreeWidgetRows
+{
+  public:
+    XTreeWidgetQueryRows(XSqlQuery query) : _query(query) {}
+
+    int         at()        const { return _query.at(); }
+    int         count()     const { return _query.record().count(); }
+    bool        first()           { return _query.first(); }
+    bool        next()            { return _query.next(); }
+    QSqlRecord  record()    const { return _query.record(); }
+    bool        seek(int i)       { return _query.seek(i); }
+    int         size()      const { return _query.size(); }
+    QVariant    value(int i) const { return _query.value(i); }
+
+  private:
+    XSqlQuery _query;
+};
+
+class XTreeWidgetListRows : public XTreeWidgetRows
+{
+  public:
+    XTreeWidgetListRows(const QSqlRecord &record, const QList<QVariantList> &rows)
+      : _record(record), _rows(rows), _at(QSql::BeforeFirstRow) {}
+
+    int         at()        const { return _at; }
+    int         count()     const { return _record.count(); }
+    bool        first()           { return seek(0); }
+    bool        next()            { return seek(_at + 1); }
+    QSqlRecord  record()    const { return _record; }
+    int         size()      const { return _rows.size(); }
+
+    bool seek(int i)
+    {
+      if (i < 0)
+        _at = QSql::BeforeFirstRow;
+      else if (i >= _rows.size())
+        _at = QSql::AfterLastRow;
+      else
+        _at = i;
+      return (_at >= 0);
+    }
 
-static double cint(double x)
-{
-  double intpart, fractpart;
-  fractpart = modf(x, &intpart);
+    QVariant value(int i) const
+    {
+      if (_at < 0 || i < 0 || i >= _rows.at(_at).size())
+        return QVariant();
+      return _rows.at(_at).at(i);
+    }
 
-  if (fabs(fractpart) >= 0.5)
-    return x>=0 ? ceil(x) : floor(x);
-  else
-    return x<0 ? ceil(x) : floor(x);
-}
+  private:
+    QSqlRecord            _record;
+    QList<QVariantList>   _rows;
+    int                   _at;
+};
+
+/* the state of a Merge populate(). rows that were showing before are
+   matched to the new result by id and altId; matched rows are updated in
+   place, new rows are inserted and whatever is left over is deleted.
+   the selection, current row, expanded rows and scroll position are
+   remembered by key so they can be put back once the merge is done.
+*/
+typedef QPair<int, int> XTreeWidgetKey;
 
-static double round(double r, int places)
+static XTreeWidgetKey itemKey(const XTreeWidgetItem *item)
 {
-  double off=pow(10.0,places);
-  return cint(r*off)/off;
+  return qMakePair(item->id(), item->altId());
 }
 
+class XTreeWidgetMerge
+{
+  public:
+    XTreeWidgetMerge() : _flat(true), _hasCurrent(false), _scroll(0) {}
+
+    bool                                    _flat;    // false: tree, rebuilt instead of merged
+    QHash<XTreeWidgetKey, XTreeWidgetItem*> _old;     // unmatched rows from before
+    QList<XTreeWidgetItem*>                 _order;   // rows in new result order
+    QSet<XTreeWidgetKey>                    _selected;
+    QSet<XTreeWidgetKey>                    _expanded;
+    XTreeWidgetKey                          _current;
+    bool                                    _hasCurrent;
+    int                                     _scroll;
+};
+
 XTreeWidget::XTreeWidget(QWidget *pParent) :
   QTreeWidget(pParent)
 {
@@ -113,15 +171,18 @@ XTreeWidget::XTreeWidget(QWidget *pParent) :
   _sord    = Qt::AscendingOrder;
   _linear  = false;
   _alwaysLinear = true;
+  _resultSetBacked = false;
 
-  _colIdx     = 0;  // querycol = _colIdx[xtreecol]
-  _colRole    = 0;  // querycol = _colRole[xtreecol][roleid]
   _fieldCount = 0;
   _last       = 0;
-  for (int i = 0; i < ROWROLE_COUNT; i++)
-    _rowRole[i] = 0;
+  _populatePending = false;
+  _merge      = 0;
+  _searchIndex = 0;
   _progress = 0;
+  _progressExternal = false;
   _subtotals = 0;
+  _calculatedRows = 0;
+  _calculating = false;
 
   setUniformRowHeights(true); //#13439 speed improvement if all rows are known to be the same height
   setContextMenuPolicy(Qt::CustomContextMenu);
@@ -139,6 +200,10 @@ XTreeWidget::XTreeWidget(QWidget *pParent) :
   connect(header(),       SIGNAL(sectionResized(int, int, int)),
           this,     SLOT(sColumnSizeChanged(int, int, int)));
   connect(this,           SIGNAL(currentItemChanged(QTreeWidgetItem*, QTreeWidgetItem *)),  SLOT(sCurrentItemChanged(QTreeWidgetItem*, QTreeWidgetItem *)));
+  connect(model(), SIGNAL(rowsInserted(const QModelIndex&, int, int)),
+          this,    SLOT(sRowsChanged(const QModelIndex&, int, int)));
+  connect(model(), SIGNAL(rowsAboutToBeRemoved(const QModelIndex&, int, int)),
+          this,    SLOT(sRowsChanged(const QModelIndex&, int, int)));
   connect(this,           SIGNAL(itemChanged(QTreeWidgetItem*, int)),                       SLOT(sItemChanged(QTreeWidgetItem*, int)));
   connect(this,           SIGNAL(itemClicked(QTreeWidgetItem*, int)),                       SLOT(sItemClicked(QTreeWidgetItem*, int)));
   connect(&_workingTimer, SIGNAL(timeout()), this, SLOT(populateWorker()));
@@ -173,6 +238,7 @@ XTreeWidget::~XTreeWidget()
   qApp->restoreOverrideCursor();
 
   cleanupAfterPopulate();
+  delete _merge;
 
   if (_subtotals)
   {
@@ -235,28 +301,174 @@ void XTreeWidget::populate(XSqlQuery pQuery, bool pUseAltId, PopulateStyle popst
 
 void XTreeWidget::populate(XSqlQuery pQuery, int pIndex, bool pUseAltId, PopulateStyle popstyle)
 {
+  populate(QSharedPointer<XTreeWidgetRows>(new XTreeWidgetQueryRows(pQuery)),
+           pIndex, pUseAltId, popstyle);
+}
+
+/*! Populate the XTreeWidget from rows that have already been read from the
+    database, such as those collected by a QueryThread. \a pFields
+    describes the columns of each row in \a pRows, which are interpreted
+    exactly as the result of an XSqlQuery would be. Call this repeatedly
+    with \c Append to add rows as they arrive.
+ */
+void XTreeWidget::populate(const QSqlRecord &pFields, const QList<QVariantList> &pRows, int pIndex, bool pUseAltId, PopulateStyle popstyle)
+{
+  populate(QSharedPointer<XTreeWidgetRows>(new XTreeWidgetListRows(pFields, pRows)),
+           pIndex, pUseAltId, popstyle);
+}
+
+void XTreeWidget::populate(QSharedPointer<XTreeWidgetRows> pRows, int pIndex, bool pUseAltId, PopulateStyle popstyle)
+{
+  if (popstyle == Merge && _roles.size() <= 0)
+    popstyle = Replace;   // old-style populate has no id to merge on
+
   XTreeWidgetPopulateParams args;
-  args._workingQuery     = pQuery;
+  args._workingRows      = pRows;
   args._workingIndex     = pIndex;
   args._workingUseAlt    = pUseAltId;
   args._workingPopstyle  = popstyle;
 
-  pQuery.seek(-1);
+  pRows->seek(-1);
 
   if (popstyle == Replace)
   {
     clear();
     _workingParams.clear();
   }
+  else if (popstyle == Merge)
+  {
+    _workingTimer.stop();
+    _workingParams.clear();
+    _calculatedRows = 0;    // rows are changed in place
+  }
   _workingParams.append(args);
 
-  _linear = _alwaysLinear;
+  // a merge has to see the whole result before it can delete anything
+  _linear = _alwaysLinear || popstyle == Merge;
   if (_linear)
     populateWorker();
   else if (! _workingTimer.isActive())
     _workingTimer.start(WORKERINTERVAL);
 }
 
+/* work out how the fields in pRecord map onto the columns. the result is
+   kept and handed back again as long as the query has the same fields and
+   the columns haven't changed, which is the usual case for a display
+   being refreshed.
+ */
+QSharedPointer<XTreeWidgetPopulatePlan> XTreeWidget::populatePlan(const QSqlRecord &pRecord)
+{
+  QStringList keyparts;
+  for (int i = 0; i < pRecord.count(); i++)
+    keyparts << pRecord.fieldName(i) + ":" + QString::number(pRecord.field(i).type());
+  keyparts << (rootIsDecorated() ? "tree" : "list");
+  for (int wcol = 0; wcol < _roles.size(); wcol++)
+  {
+    QVariantMap *role = _roles.value(wcol);
+    keyparts << (role ? role->value("qteditrole").toString() : QString("<none>"))
+             << headerItem()->data(wcol, Xt::ScaleRole).toString()
+             << QString::number(headerItem()->textAlignment(wcol));
+  }
+  QString key = keyparts.join(",");
+
+  if (! _plan || _plan->key() != key)
+  {
+    if (DEBUG)
+      qDebug("%s::populatePlan() building %s", qPrintable(objectName()), qPrintable(key));
+
+    XTreeWidgetPopulatePlan *plan = new XTreeWidgetPopulatePlan(key, _roles.size());
+
+    // apply indent, hidden and delete roles to col 0 if the caller requested them
+    // keep synchronized with #define ROWROLE_* in xtreewidget.h
+    if (rootIsDecorated())
+      plan->_rowRole[ROWROLE_INDENT] = qMax(pRecord.indexOf("xtindentrole"), 0);
+    plan->_rowRole[ROWROLE_HIDDEN]  = qMax(pRecord.indexOf("xthiddenrole"),  0);
+    plan->_rowRole[ROWROLE_DELETED] = qMax(pRecord.indexOf("xtdeletedrole"), 0);
+
+    // Qt roles apply to a whole row by applying to each column
+    const QStringList &knownroles = XTreeWidgetPopulatePlan::knownRoles();
+    QVector<int> rowRoles(COLROLE_COUNT, 0);
+    for (int k = 0; k < knownroles.size(); k++)
+      if (knownroles.at(k).startsWith("qt"))
+        rowRoles[k] = qMax(pRecord.indexOf(knownroles.at(k)), 0);
+
+    for (int wcol = 0; wcol < _roles.size(); wcol++)
+    {
+      QVariantMap *role = _roles.value(wcol);
+      if (!role)
+      {
+        qWarning("XTreeWidget::populate() there is no role for column %d", wcol);
+        plan->_noRole.setBit(wcol);
+        continue;
+      }
+      QString colname = role->value("qteditrole").toString();
+      plan->_colIdx[wcol] = pRecord.indexOf(colname);
+
+      for (int k = 0; k < knownroles.size(); k++)
+      {
+        int field = rowRoles.at(k);
+        if (field > 0)
+          role->insert(knownroles.at(k), QString(knownroles.at(k)));
+
+        // apply column-specific roles second to override entire row settings
+        int colfield = pRecord.indexOf(colname + "_" + knownroles.at(k));
+        if (colfield >= 0)
+        {
+          field = colfield;
+          role->insert(knownroles.at(k), QString(colname + "_" + knownroles.at(k)));
+        }
+        plan->_colRole[wcol * COLROLE_COUNT + k] = field;
+      }
+
+      // Negative NUMERIC ROLE => default for column instead of column index
+      if (!plan->role(wcol, COLROLE_NUMERIC) &&
+          headerItem()->data(wcol, Xt::ScaleRole).isValid())
+      {
+        bool  ok;
+        int   tmpscale = headerItem()->data(wcol, Xt::ScaleRole).toInt(&ok);
+        if (ok)
+        {
+          plan->_colRole[wcol * COLROLE_COUNT + COLROLE_NUMERIC] = 0 - tmpscale;
+          plan->_fixedScale[wcol] = tmpscale;
+        }
+      }
+
+      // pick the formatter now instead of testing the value on every row
+      int numeric = plan->role(wcol, COLROLE_NUMERIC);
+      QVariant::Type rawtype = plan->_colIdx.at(wcol) >= 0 ?
+                               pRecord.field(plan->_colIdx.at(wcol)).type() :
+                               QVariant::Invalid;
+      if (numeric > 0)
+        plan->_format[wcol] = XTreeWidgetPopulatePlan::NumericFormat;
+      else if (numeric < 0 || rawtype == QVariant::Double)
+        plan->_format[wcol] = XTreeWidgetPopulatePlan::DoubleFormat;
+      else if (rawtype == QVariant::Bool)
+        plan->_format[wcol] = XTreeWidgetPopulatePlan::BoolFormat;
+
+      if (plan->role(wcol, COLROLE_DISPLAY))
+        plan->_displayType[wcol] = pRecord.field(plan->role(wcol, COLROLE_DISPLAY)).type();
+
+      plan->_hasScale.setBit(wcol, numeric ||
+                                   plan->role(wcol, COLROLE_RUNNING) ||
+                                   plan->role(wcol, COLROLE_TOTAL));
+      plan->_alignment[wcol] = headerItem()->textAlignment(wcol);
+    }
+
+    _plan = QSharedPointer<XTreeWidgetPopulatePlan>(plan);
+  }
+
+  // populateCalculatedColumns() finds running and total columns by these
+  for (int wcol = 0; wcol < _plan->columns(); wcol++)
+  {
+    if (_plan->role(wcol, COLROLE_TOTAL) > 0)
+      headerItem()->setData(wcol, Qt::UserRole, "xttotalrole");
+    else if (_plan->role(wcol, COLROLE_RUNNING) > 0)
+      headerItem()->setData(wcol, Qt::UserRole, "xtrunningrole");
+  }
+
+  return _plan;
+}
+
 void XTreeWidget::populateWorker()
 {
   if (_workingParams.isEmpty())
@@ -268,10 +480,10 @@ void XTreeWidget::populateWorker()
   }
 
   XTreeWidgetPopulateParams args = _workingParams.first();
-  XSqlQuery     pQuery     = args._workingQuery;
+  XTreeWidgetRows *pQuery = args._workingRows.data();
   int           pIndex     = args._workingIndex;
   bool          pUseAltId  = args._workingUseAlt;
-  //PopulateStyle popstyle   = args._workingPopstyle;
+  PopulateStyle popstyle   = args._workingPopstyle;
 
   QList<XTreeWidgetItem*> topLevelItems; //#13439
 
@@ -286,24 +498,24 @@ void XTreeWidget::populateWorker()
   {
     if (DEBUG)
       qDebug("%s::populate() old-style", qPrintable(objectName()));
-    if (pQuery.first())
+    if (pQuery->first())
     {
-      _fieldCount = pQuery.count();
+      _fieldCount = pQuery->count();
       do
       {
         if (pUseAltId)
-          _last = new XTreeWidgetItem(this, _last, pQuery.value(0).toInt(),
-                                     pQuery.value(1).toInt(),
-                                     pQuery.value(2).toString());
+          _last = new XTreeWidgetItem(this, _last, pQuery->value(0).toInt(),
+                                     pQuery->value(1).toInt(),
+                                     pQuery->value(2).toString());
         else
-          _last = new XTreeWidgetItem(this, _last, pQuery.value(0).toInt(),
-                                     pQuery.value(1));
+          _last = new XTreeWidgetItem(this, _last, pQuery->value(0).toInt(),
+                                     pQuery->value(1));
 
         if (_fieldCount > ((pUseAltId) ? 3 : 2))
           for (int col = ((pUseAltId) ? 3 : 2); col < _fieldCount; col++)
             _last->setText((col - ((pUseAltId) ? 2 : 1)),
-                          pQuery.value(col).toString());
-      } while (pQuery.next());
+                          pQuery->value(col).toString());
+      } while (pQuery->next());
     }
   }
 
@@ -311,156 +523,85 @@ void XTreeWidget::populateWorker()
      taking into account that some places call xsqlquery::first() before
      xtreewidget::populate()
    */
-  if (pQuery.at() == QSql::BeforeFirstRow || (pQuery.at() == 0 && ! _colIdx))
+  if (pQuery->at() == QSql::BeforeFirstRow || (pQuery->at() == 0 && ! _populatePlan))
   {
-    if (pQuery.first())
+    if (pQuery->first())
     {
       cleanupAfterPopulate(); // plug memory leaks if last populate() never finished
 
-      _fieldCount = pQuery.count();
-      // TODO: rewrite code to use a qmap or some other structure that
-      //       doesn't require initializing a Vector or new'd array values
-      _colIdx = new QVector<int>(_roles.size());
+      // rows appended to an earlier populate() carry on its tree, so a
+      // child whose parent came in the previous chunk still finds it
+      if (popstyle == Append)
+        _last = _appendLast;
 
-      _colRole = new QVector<int *>(_roles.size(), 0);
-      for (int ref = 0; ref < _roles.size(); ++ref)
-        (*_colRole)[ref] = new int[COLROLE_COUNT];
+      QSqlRecord  currRecord = pQuery->record();
+      _populatePlan = populatePlan(currRecord);
+      if (popstyle == Merge)
+        startMerge();
 
+      _fieldCount = pQuery->count();
       if (! _subtotals)
       {
         _subtotals = new QList<QMap<int, double> *>();
-        for (int i = 0; i < _fieldCount; i++)
+        for (int i = 0; i < qMax(_fieldCount, _roles.size()); i++)
           _subtotals->append(new QMap<int, double>());
       }
 
-      QSqlRecord  currRecord = pQuery.record();
-
-      // apply indent, hidden and delete roles to col 0 if the caller requested them
-      // keep synchronized with #define ROWROLE_* above
-      if (rootIsDecorated())
+      if (_resultSetBacked)
       {
-        _rowRole[ROWROLE_INDENT] = currRecord.indexOf("xtindentrole");
-        if (_rowRole[ROWROLE_INDENT] < 0)
-          _rowRole[ROWROLE_INDENT] = 0;
-      }
-      else
-        _rowRole[ROWROLE_INDENT] = 0;
-
-      _rowRole[ROWROLE_HIDDEN] = currRecord.indexOf("xthiddenrole");
-      if (_rowRole[ROWROLE_HIDDEN] < 0)
-        _rowRole[ROWROLE_HIDDEN] = 0;
-
-      _rowRole[ROWROLE_DELETED] = currRecord.indexOf("xtdeletedrole");
-      if (_rowRole[ROWROLE_DELETED] < 0)
-        _rowRole[ROWROLE_DELETED] = 0;
-
-      // keep synchronized with #define COLROLE_* above
-      // TODO: get rid of COLROLE_* above and replace this QStringList
-      // with a map or vector of known roles and their Qt:: role or Xt
-      // enum values
-      QStringList knownroles;
-      knownroles << "qtdisplayrole"      << "qttextalignmentrole"<<
-      "qtbackgroundrole"   << "qtforegroundrole"<<
-      "qttooltiprole"      << "qtstatustiprole"<<
-      "qtfontrole" << "xtkeyrole"<<
-      "xtrunningrole"      << "xtrunninginit"<<
-      "xtgrouprunningrole" << "xttotalrole"<<
-      "xtnumericrole" << "xtnullrole"<<
-      "xtidrole";
-      for (int wcol = 0; wcol < _roles.size(); wcol++)
-      {
-        QVariantMap *role = _roles.value(wcol);
-        if (!role)
+        QList<int> fields;
+        for (int wcol = 0; wcol < _populatePlan->columns(); wcol++)
         {
-          qWarning("XTreeWidget::populate() there is no role for column %d", wcol);
-          continue;
+          fields.append(_populatePlan->_colIdx.at(wcol));
+          for (int k = 0; k < COLROLE_COUNT; k++)
+            if (_populatePlan->role(wcol, k) > 0)
+              fields.append(_populatePlan->role(wcol, k));
         }
-        QString colname = role->value("qteditrole").toString();
-        (*_colIdx)[wcol] = currRecord.indexOf(colname);
 
-        for (int k = 0; k < knownroles.size(); k++)
-        {
-          // apply Qt roles to a whole row by applying to each column
-          (*_colRole)[wcol][k] = knownroles.at(k).startsWith("qt") ?
-                             currRecord.indexOf(knownroles.at(k)) :
-                             0;
-          if ((*_colRole)[wcol][k] > 0)
-          {
-            role->insert(knownroles.at(k),
-                          QString(knownroles.at(k)));
-          }
-          else
-            (*_colRole)[wcol][k] = 0;
-
-          // apply column-specific roles second to override entire row settings
-          if (currRecord.indexOf(colname + "_" + knownroles.at(k)) >=0)
-          {
-            (*_colRole)[wcol][k] = currRecord.indexOf(colname + "_" + knownroles.at(k));
-            role->insert(knownroles.at(k),
-                          QString(colname + "_" + knownroles.at(k)));
-            if (knownroles.at(k) == "xtrunningrole")
-              headerItem()->setData(wcol, Qt::UserRole, "xtrunningrole");
-            else if (knownroles.at(k) == "xttotalrole")
-                          headerItem()->setData(wcol, Qt::UserRole, "xttotalrole");
-          }
-        }
-
-        // Negative NUMERIC ROLE => default for column instead of column index
-        // see below
-        if (!(*_colRole)[wcol][COLROLE_NUMERIC] &&
-                          headerItem()->data(wcol, Xt::ScaleRole).isValid())
-        {
-          bool  ok;
-          int   tmpscale = headerItem()->data(wcol, Xt::ScaleRole).toInt(&ok);
-          if (ok)
-          {
-            if (DEBUG)
-              qDebug("setting _colRole[%d][COLROLE_NUMERIC]: %d", wcol, 0-tmpscale);
-            (*_colRole)[wcol][COLROLE_NUMERIC] = 0 - tmpscale;
-          }
-        }
+        _resultSet = QSharedPointer<XTreeWidgetResultSet>(new XTreeWidgetResultSet(currRecord, fields));
+        _resultSet->_plan = _populatePlan;
       }
 
-      if (_rowRole[ROWROLE_INDENT])
+      if (_populatePlan->_rowRole[ROWROLE_INDENT])
         setIndentation( 10);
       else
         setIndentation( 0);
 
       if (! _linear && ! _progress)
-      {
-        _progress = new XTreeWidgetProgress(this);
-        connect(_progress, SIGNAL(cancel()), &_workingTimer, SLOT(stop()));
-      }
-      if (_progress)
+        progress();
+      if (_progress && ! _progressExternal)
       {
         _progress->setValue(0);
-        _progress->setMaximum(pQuery.size());
+        _progress->setMaximum(pQuery->size());
         _progress->show();
       }
     }
+    else if (popstyle == Merge)
+      clear();  // nothing left to merge with
   }
 
-  int defaultScale = decimalPlaces("");
+  const XTreeWidgetPopulatePlan *plan = _populatePlan.data();
   int cnt = 0;
 
-  if (pQuery.at() >= 0) // if the query returned any rows at all
+  if (pQuery->at() >= 0) // if the query returned any rows at all
     do
     {
       ++cnt;
       if (!_linear && cnt % WORKERROWS == 0)
       {
         this->addTopLevelItems(topLevelItems); //#13439
-        _progress->setValue(pQuery.at());
+        if (! _progressExternal)
+          _progress->setValue(pQuery->at());
         return;
       }
 
-      int id         = pQuery.value(0).toInt();
-      int altId      = (pUseAltId) ? pQuery.value(1).toInt() : -1;
+      int id         = pQuery->value(0).toInt();
+      int altId      = (pUseAltId) ? pQuery->value(1).toInt() : -1;
       int indent     = 0;
       int lastindent = 0;
-      if (_rowRole[ROWROLE_INDENT])
+      if (plan->_rowRole[ROWROLE_INDENT])
       {
-        indent = pQuery.value(_rowRole[ROWROLE_INDENT]).toInt();
+        indent = pQuery->value(plan->_rowRole[ROWROLE_INDENT]).toInt();
         if (indent < 0)
           indent = 0;
         if (_last)
@@ -497,120 +638,76 @@ void XTreeWidget::populateWorker()
       }
       else
         parentItem = this;
+      if (! parentItem)
+      {
+        qWarning("%s::populate() row %d has indent %d but no parent, showing it at the top",
+                 qPrintable(objectName()), id, indent);
+        parentItem = this;
+      }
 
-      if (_rowRole[ROWROLE_INDENT])
+      if (plan->_rowRole[ROWROLE_INDENT])
         _last->setData(0, Xt::IndentRole, indent);
 
-      if (_rowRole[ROWROLE_HIDDEN])
+      if (plan->_rowRole[ROWROLE_HIDDEN])
       {
         if (DEBUG)
           qDebug("%s::populate() found xthiddenrole, value = %s",
                   qPrintable( objectName()),
-                  qPrintable( pQuery.value(_rowRole[ROWROLE_HIDDEN]).toString()));
-        _last->setHidden(pQuery.value(_rowRole[ROWROLE_HIDDEN]).toBool());
+                  qPrintable( pQuery->value(plan->_rowRole[ROWROLE_HIDDEN]).toString()));
+        _last->setHidden(pQuery->value(plan->_rowRole[ROWROLE_HIDDEN]).toBool());
+      }
+
+      if (_resultSet)
+      {
+        _last->_resultSet = _resultSet;
+        _last->_resultRow = _resultSet->appendRow(*pQuery);
       }
 
       bool allNull = (indent > 0);
-      for (int col = 0; col < _roles.size(); col++)
+      for (int col = 0; col < plan->columns(); col++)
       {
-        QVariantMap *role = _roles.value(col);
-        if (!role)
-        {
-          qWarning("XTreeWidget::populate() there is no role for column %d", col);
+        if (plan->_noRole.testBit(col))
           continue;
-        }
-
-        QVariant rawValue;
-        if(_colIdx->at(col) >=0)  //#13439 optimization - only try to retrieve value if index is valid
-          rawValue = pQuery.value(_colIdx->at(col));
 
-        _last->setData(col, Xt::RawRole, rawValue);
+        const int *colRole = plan->_colRole.constData() + col * COLROLE_COUNT;
 
-        // TODO: this isn't necessary for all columns so do less often?
-        int     scale        = defaultScale;
-        QString numericrole  = "";
-        if ((*_colRole)[col][COLROLE_NUMERIC])
-        {
-          // Negative NUMERIC ROLE => default for column instead of column index
-          // see above
-          if ((*_colRole)[col][COLROLE_NUMERIC] < 0)
-            scale = 0 - (*_colRole)[col][COLROLE_NUMERIC];
-          else
-          {
-            numericrole  = pQuery.value((*_colRole)[col][COLROLE_NUMERIC]).toString();
-            scale        = decimalPlaces(numericrole);
-          }
-        }
-
-        if ((*_colRole)[col][COLROLE_NUMERIC] ||
-            (*_colRole)[col][COLROLE_RUNNING] ||
-            (*_colRole)[col][COLROLE_TOTAL])
+        QVariant rawValue;
+        if(plan->_colIdx.at(col) >=0)  //#13439 optimization - only try to retrieve value if index is valid
+          rawValue = pQuery->value(plan->_colIdx.at(col));
+
+        /* with a result set behind the item, XTreeWidgetItem::data() builds
+           everything but the running totals, indent and deleted state on
+           demand. still set the last column so columnCount() is right.
+         */
+        if (! _resultSet || col == plan->columns() - 1)
+          _last->setData(col, Xt::RawRole, rawValue);
+
+        bool percent = false;
+        int  scale   = plan->scale(col, colRole[COLROLE_NUMERIC] > 0 ?
+                                        pQuery->value(colRole[COLROLE_NUMERIC]) :
+                                        QVariant(), &percent);
+
+        if (! _resultSet && plan->hasScale(col))
           _last->setData(col, Xt::ScaleRole, scale);
 
-        /* if qtdisplayrole IS NULL then let the raw value shine through.
-           this allows UNIONS to do interesting things, like put dates and
-           text into the same visual column without SQL errors.
-        */
-        if ((*_colRole)[col][COLROLE_DISPLAY] &&
-            !pQuery.value((*_colRole)[col][COLROLE_DISPLAY]).isNull())
-        {
-          /* this might not handle PostgreSQL NUMERICs properly
-             but at least it will try to handle INTEGERs and DOUBLEs
-             and it will avoid formatting sales order numbers with decimal
-             and group separators
-          */
-          QVariant field = pQuery.value((*_colRole)[col][COLROLE_DISPLAY]);
-          if (field.type() == QVariant::Int)
-            _last->setData(col, Qt::DisplayRole,
-                          QLocale().toString(field.toInt()));
-          else if (field.type() == QVariant::Double)
-            _last->setData(col, Qt::DisplayRole,
-                          QLocale().toString(field.toDouble(),
-                                             'f', scale));
-          else
-            _last->setData(col, Qt::DisplayRole, field.toString());
-        }
-        else if (rawValue.isNull())
-        {
-          _last->setData(col, Qt::DisplayRole,
-                        (*_colRole)[col][COLROLE_NULL] ?
-                        pQuery.value((*_colRole)[col][COLROLE_NULL]).toString() :
-                        "");
-        }
-        else if ((*_colRole)[col][COLROLE_NUMERIC] &&
-                 ((numericrole == "percent") ||
-                  (numericrole == "scrap")))
-        {
-          _last->setData(col, Qt::DisplayRole,
-                          QLocale().toString(rawValue.toDouble() * 100.0,
-                                           'f', scale));
-        }
-        else if ((*_colRole)[col][COLROLE_NUMERIC] || rawValue.type() == QVariant::Double)
-        {
-          // Issue #8897
-          _last->setData(col, Qt::DisplayRole,
-                          QLocale().toString(round(rawValue.toDouble(), scale),
-                                           'f', scale));
-        }
-        else if (rawValue.type() == QVariant::Bool)
-        {
+        QVariant display;
+        if (colRole[COLROLE_DISPLAY])
+          display = pQuery->value(colRole[COLROLE_DISPLAY]);
+
+        if (! _resultSet) // otherwise formatted on demand by XTreeWidgetItem::data()
           _last->setData(col, Qt::DisplayRole,
-                        rawValue.toBool() ? yesStr : noStr);
-        }
-        else
-        {
-          _last->setData(col, Qt::EditRole, rawValue);
-        }
+                         plan->format(col, rawValue, display,
+                                      colRole[COLROLE_NULL] ?
+                                        pQuery->value(colRole[COLROLE_NULL]) :
+                                        QVariant(),
+                                      scale, percent));
 
         if (indent)
         {
-          if (!(*_colRole)[col][COLROLE_DISPLAY] ||
-              ((*_colRole)[col][COLROLE_DISPLAY] &&
-               pQuery.value((*_colRole)[col][COLROLE_DISPLAY]).isNull()))
+          if (display.isNull())
             allNull &= (rawValue.isNull() || rawValue.toString().isEmpty());
           else
-            allNull &= pQuery.value((*_colRole)[col][COLROLE_DISPLAY]).isNull() ||
-                       pQuery.value((*_colRole)[col][COLROLE_DISPLAY]).toString().isEmpty();
+            allNull &= display.toString().isEmpty();
 
           if (DEBUG)
             qDebug("%s::populate() allNull = %d at %d for rawValue %s",
@@ -618,95 +715,99 @@ void XTreeWidget::populateWorker()
                     qPrintable( rawValue.toString()));
         }
 
-        if ((*_colRole)[col][COLROLE_FOREGROUND])
+        if (! _resultSet)
         {
-          QVariant fg = pQuery.value((*_colRole)[col][COLROLE_FOREGROUND]);
-          if (!fg.isNull())
-            _last->setData(col, Qt::ForegroundRole, namedColor(fg.toString()));
-        }
+          if (colRole[COLROLE_FOREGROUND])
+          {
+            QVariant fg = pQuery->value(colRole[COLROLE_FOREGROUND]);
+            if (!fg.isNull())
+              _last->setData(col, Qt::ForegroundRole, namedColor(fg.toString()));
+          }
 
-        if ((*_colRole)[col][COLROLE_BACKGROUND])
-        {
-          QVariant bg = pQuery.value((*_colRole)[col][COLROLE_BACKGROUND]);
-          if (!bg.isNull())
-            _last->setData(col, Qt::BackgroundRole, namedColor(bg.toString()));
-        }
+          if (colRole[COLROLE_BACKGROUND])
+          {
+            QVariant bg = pQuery->value(colRole[COLROLE_BACKGROUND]);
+            if (!bg.isNull())
+              _last->setData(col, Qt::BackgroundRole, namedColor(bg.toString()));
+          }
 
-        if ((*_colRole)[col][COLROLE_TEXTALIGNMENT])
-        {
-          QVariant alignment = pQuery.value((*_colRole)[col][COLROLE_TEXTALIGNMENT]);
-          if (!alignment.isNull())
-            _last->setData(col, Qt::TextAlignmentRole, alignment);
-        }
-        else
-          _last->setData(col, Qt::TextAlignmentRole, headerItem()->textAlignment(col));
+          if (colRole[COLROLE_TEXTALIGNMENT])
+          {
+            QVariant alignment = pQuery->value(colRole[COLROLE_TEXTALIGNMENT]);
+            if (!alignment.isNull())
+              _last->setData(col, Qt::TextAlignmentRole, alignment);
+          }
+          else
+            _last->setData(col, Qt::TextAlignmentRole, plan->_alignment.at(col));
 
-        if ((*_colRole)[col][COLROLE_TOOLTIP])
-        {
-          QVariant tooltip = pQuery.value((*_colRole)[col][COLROLE_TOOLTIP]);
-          if (!tooltip.isNull() )
-            _last->setData(col, Qt::ToolTipRole, tooltip);
-        }
+          if (colRole[COLROLE_TOOLTIP])
+          {
+            QVariant tooltip = pQuery->value(colRole[COLROLE_TOOLTIP]);
+            if (!tooltip.isNull() )
+              _last->setData(col, Qt::ToolTipRole, tooltip);
+          }
 
-        if ((*_colRole)[col][COLROLE_STATUSTIP])
-        {
-          QVariant statustip = pQuery.value((*_colRole)[col][COLROLE_STATUSTIP]);
-          if (!statustip.isNull())
-            _last->setData(col, Qt::StatusTipRole, statustip);
-        }
+          if (colRole[COLROLE_STATUSTIP])
+          {
+            QVariant statustip = pQuery->value(colRole[COLROLE_STATUSTIP]);
+            if (!statustip.isNull())
+              _last->setData(col, Qt::StatusTipRole, statustip);
+          }
 
-        if ((*_colRole)[col][COLROLE_FONT])
-        {
-          QVariant font = pQuery.value((*_colRole)[col][COLROLE_FONT]);
-          if (!font.isNull())
-            _last->setData(col, Qt::FontRole, font);
-        }
+          if (colRole[COLROLE_FONT])
+          {
+            QVariant font = pQuery->value(colRole[COLROLE_FONT]);
+            if (!font.isNull())
+              _last->setData(col, Qt::FontRole, font);
+          }
 
-        if ((*_colRole)[col][COLROLE_RUNNINGINIT])
-        {
-          QVariant runninginit = pQuery.value((*_colRole)[col][COLROLE_RUNNINGINIT]);
-          if (!runninginit.isNull())
-            _last->setData(col, Xt::RunningInitRole, runninginit);
-        }
+          if (colRole[COLROLE_RUNNINGINIT])
+          {
+            QVariant runninginit = pQuery->value(colRole[COLROLE_RUNNINGINIT]);
+            if (!runninginit.isNull())
+              _last->setData(col, Xt::RunningInitRole, runninginit);
+          }
 
-        if ((*_colRole)[col][COLROLE_ID])
-        {
-          QVariant id = pQuery.value((*_colRole)[col][COLROLE_ID]);
-          if (!id.isNull())
-            _last->setData(col, Xt::IdRole, id);
+          if (colRole[COLROLE_ID])
+          {
+            QVariant id = pQuery->value(colRole[COLROLE_ID]);
+            if (!id.isNull())
+              _last->setData(col, Xt::IdRole, id);
+          }
         }
 
-        if ((*_colRole)[col][COLROLE_RUNNING])
+        if (colRole[COLROLE_RUNNING])
         {
-          int set = pQuery.value((*_colRole)[col][COLROLE_RUNNING]).toInt();
+          int set = pQuery->value(colRole[COLROLE_RUNNING]).toInt();
           _last->setData(col, Xt::RunningSetRole, set);
           /* performance hack - populateCalculatedColumns will repeat this
              but only redraw if necessary. redraw is much slower than recalc. */
           if (! _subtotals->at(col)->contains(set))
           {
-            if ((*_colRole)[col][COLROLE_RUNNINGINIT])
-              (*_subtotals)[col]->insert(set, pQuery.value((*_colRole)[col][COLROLE_RUNNINGINIT]).toDouble());
+            if (colRole[COLROLE_RUNNINGINIT])
+              (*_subtotals)[col]->insert(set, pQuery->value(colRole[COLROLE_RUNNINGINIT]).toDouble());
             else
               (*_subtotals)[col]->insert(set, 0.0);
           }
           (*(*_subtotals)[col])[set] += rawValue.toDouble();
+          _last->setData(col, Xt::RunningValueRole, (*_subtotals)[col]->value(set));
           _last->setData(col, Qt::DisplayRole,
                          QLocale().toString((*_subtotals)[col]->value(set), 'f', scale));
         }
 
-        if ((*_colRole)[col][COLROLE_TOTAL])
+        if (colRole[COLROLE_TOTAL] && ! _resultSet)
         {
           _last->setData(col, Xt::TotalSetRole,
-                        pQuery.value((*_colRole)[col][COLROLE_TOTAL]).toInt());
+                        pQuery->value(colRole[COLROLE_TOTAL]).toInt());
         }
 
-        if (_rowRole[ROWROLE_DELETED])
+        if (plan->_rowRole[ROWROLE_DELETED])
         {
           if (DEBUG)
             qDebug("%s::populate() found xtdeleterole, value = %s",
                     qPrintable( objectName()),
-                    qPrintable( pQuery.value(_rowRole[ROWROLE_DELETED]).toString()));
-          if (pQuery.value(_rowRole[ROWROLE_DELETED]).toBool())
+                    qPrintable( pQuery->value(plan->_rowRole[ROWROLE_DELETED]).toString()));
+          if (pQuery->value(plan->_rowRole[ROWROLE_DELETED]).toBool())
           {
             _last->setData(col,Xt::DeletedRole, QVariant(true));
             QFont font = _last->font(col);
@@ -716,10 +817,10 @@ void XTreeWidget::populateWorker()
           }
         }
         /*
-        if ((*_colRole)[col][COLROLE_KEY])
-          _last->setData(col, KeyRole, pQuery.value((*_colRole)[col][COLROLE_KEY]));
-        if ((*_colRole)[col][COLROLE_GROUPRUNNING])
-          _last->setData(col, GroupRunningRole, pQuery.value((*_colRole)[col][COLROLE_GROUPRUNNING]));
+        if (colRole[COLROLE_KEY])
+          _last->setData(col, KeyRole, pQuery->value(colRole[COLROLE_KEY]));
+        if (colRole[COLROLE_GROUPRUNNING])
+          _last->setData(col, GroupRunningRole, pQuery->value(colRole[COLROLE_GROUPRUNNING]));
         */
       }
 
@@ -730,7 +831,25 @@ void XTreeWidget::populateWorker()
         _last->setHidden(true);
       }
 
-      if (qobject_cast<XTreeWidget*>(parentItem))
+      if (_merge && _merge->_flat)
+      {
+        bool hidden = plan->_rowRole[ROWROLE_HIDDEN] &&
+                      pQuery->value(plan->_rowRole[ROWROLE_HIDDEN]).toBool();
+        QHash<XTreeWidgetKey, XTreeWidgetItem*>::iterator old =
+                                            _merge->_old.find(qMakePair(id, altId));
+        if (old != _merge->_old.end())
+        {
+          XTreeWidgetItem *item = old.value();
+          _merge->_old.erase(old);
+          item->mergeFrom(_last);
+          if (item->isHidden() != hidden)
+            item->setHidden(hidden);
+          delete _last;
+          _last = item;
+        }
+        _merge->_order.append(_last);
+      }
+      else if (qobject_cast<XTreeWidget*>(parentItem))
       {
         //#13439 optimization - do not add items to 'this' until the very end
         if(parentItem == this)
@@ -741,11 +860,13 @@ void XTreeWidget::populateWorker()
       else if (qobject_cast<XTreeWidgetItem*>(parentItem))
         qobject_cast<XTreeWidgetItem*>(parentItem)->addChild(_last);
 
-    } while (pQuery.next());
+    } while (pQuery->next());
 
   this->addTopLevelItems(topLevelItems); //#13439
-
-  setId(pIndex);
+  if (_merge)
+    finishMerge();
+  else
+    setId(pIndex);
   emit valid(currentItem() != 0);
 
   // clean up. we won't reach here until the query is done, even if ! _linear
@@ -755,47 +876,242 @@ void XTreeWidget::populateWorker()
     if (_workingParams.size())
       _workingParams.takeFirst();
 
+    _appendLast = _last;
     cleanupAfterPopulate();
 
-    populateCalculatedColumns();
-    if (sortColumn() >= 0 && header()->isSortIndicatorShown())
-      sortItems(sortColumn(), header()->sortIndicatorOrder());
-
-    if (DEBUG)
-      qDebug("%s::populateWorker() done", qPrintable(objectName()));
-    emit populated();
+    // while somebody else is showing progress more rows are on the way,
+    // so leave the totals and sorting until hideProgress()
+    if (_progressExternal && ! _merge)
+      _populatePending = true;
+    else
+      finishPopulate();
   }
 
   if (_linear)
     qApp->restoreOverrideCursor();
 }
 
-void XTreeWidget::cleanupAfterPopulate()
+/* Get ready to merge a new result into the rows already showing.
+   Trees aren't merged: rows can move between parents and keys needn't be
+   unique across levels, so they're rebuilt and only the view state is
+   carried over.
+ */
+void XTreeWidget::startMerge()
 {
-  if (_progress)
-    _progress->hide();
+  delete _merge;
+  _merge = new XTreeWidgetMerge();
 
-  for (unsigned int i = 0; i < sizeof(_rowRole) / sizeof(_rowRole[0]); i++)
-    _rowRole[i] = 0;
+  _merge->_scroll = verticalScrollBar()->value();
+  if (currentItem())
+  {
+    _merge->_current    = itemKey(currentItem());
+    _merge->_hasCurrent = true;
+  }
+  for (QTreeWidgetItemIterator it(this); *it; ++it)
+  {
+    XTreeWidgetItem *item = dynamic_cast<XTreeWidgetItem*>(*it);
+    if (! item)
+      continue;
+    if (item->isSelected())
+      _merge->_selected.insert(itemKey(item));
+    if (item->isExpanded() && item->childCount() > 0)
+      _merge->_expanded.insert(itemKey(item));
+  }
 
-  _last = 0;
+  _merge->_flat = ! _populatePlan->_rowRole[ROWROLE_INDENT];
+  if (! _merge->_flat)
+  {
+    clear();
+    return;
+  }
+
+  // running sums start over, populateCalculatedColumns() keeps the totals rows
+  if (_subtotals)
+    for (int i = 0; i < _subtotals->size(); i++)
+      (*_subtotals)[i]->clear();
 
-  // TODO: get rid of this when the code is rewritten
-  //       as per above's todo about the QVector<int*>
-  if (_colRole)
+  // walk backwards so duplicate keys match in their original order
+  for (int row = topLevelItemCount() - 1; row >= 0; row--)
   {
-    for (int ref = 0; ref < _roles.size(); ++ref)
+    XTreeWidgetItem *item = topLevelItem(row);
+    if (item && item->data(0, Qt::UserRole).toString() != "totalrole")
+      _merge->_old.insertMulti(itemKey(item), item);
+  }
+
+  if (DEBUG)
+    qDebug("%s::startMerge() with %d rows", qPrintable(objectName()), _merge->_old.size());
+}
+
+/* Delete the rows that weren't in the new result and put the new ones in
+   place. If the rows that stayed are still in the same order the new rows
+   are inserted around them, otherwise the top level is rebuilt in the new
+   order, which is still far cheaper than recreating every item.
+ */
+void XTreeWidget::finishMerge()
+{
+  if (! _merge->_flat)
+    return;
+
+  if (DEBUG)
+    qDebug("%s::finishMerge() %d rows, %d deleted", qPrintable(objectName()),
+           _merge->_order.size(), _merge->_old.size());
+
+  QList<XTreeWidgetItem*> gone = _merge->_old.values();
+  _merge->_old.clear();
+  qDeleteAll(gone);
+
+  bool inOrder = true;
+  for (int i = 0, row = 0; inOrder && i < _merge->_order.size(); i++)
+  {
+    XTreeWidgetItem *item = _merge->_order.at(i);
+    if (item->treeWidget() == this)
+      inOrder = (QTreeWidget::topLevelItem(row++) == item);
+  }
+
+  if (inOrder)
+  {
+    for (int i = 0; i < _merge->_order.size(); i++)
     {
-      if ((*_colRole)[ref])
-        delete [] (*_colRole)[ref];
+      XTreeWidgetItem *item = _merge->_order.at(i);
+      if (item->treeWidget() != this)
+        insertTopLevelItem(i, item);
     }
-    delete _colRole;
-    _colRole = 0;
   }
+  else
+  {
+    QList<QTreeWidgetItem *> totals;
+    while (topLevelItemCount() > 0 &&
+           QTreeWidget::topLevelItem(topLevelItemCount() - 1)->data(0, Qt::UserRole).toString() == "totalrole")
+      totals.prepend(takeTopLevelItem(topLevelItemCount() - 1));
+    QTreeWidget::invisibleRootItem()->takeChildren();
+
+    QList<QTreeWidgetItem *> ordered;
+    ordered.reserve(_merge->_order.size() + totals.size());
+    for (int i = 0; i < _merge->_order.size(); i++)
+      ordered.append(_merge->_order.at(i));
+    ordered += totals;
+    QTreeWidget::addTopLevelItems(ordered);
+  }
+  _merge->_order.clear();
+}
+
+/* Put the selection, current row, expanded rows and scroll position back
+   the way they were before the merge. Only rows whose state differs are
+   touched so the usual selection signals fire only for real changes.
+ */
+void XTreeWidget::restoreMergedState()
+{
+  XTreeWidgetMerge *merge = _merge;
+  _merge = 0;
+
+  XTreeWidgetItem *current = 0;
+  for (QTreeWidgetItemIterator it(this); *it; ++it)
+  {
+    XTreeWidgetItem *item = dynamic_cast<XTreeWidgetItem*>(*it);
+    if (! item)
+      continue;
+
+    XTreeWidgetKey key = itemKey(item);
+    if (item->childCount() > 0 && merge->_expanded.contains(key) != item->isExpanded())
+      item->setExpanded(! item->isExpanded());
+    if (merge->_selected.contains(key) != item->isSelected())
+      item->setSelected(! item->isSelected());
+    if (merge->_hasCurrent && ! current && key == merge->_current)
+      current = item;
+  }
+
+  if (current && current != currentItem())
+    selectionModel()->setCurrentIndex(indexFromItem(current), QItemSelectionModel::NoUpdate);
+  verticalScrollBar()->setValue(merge->_scroll);
+
+  delete merge;
+  emit valid(currentItem() != 0);
+}
+
+XTreeWidgetProgress *XTreeWidget::progress()
+{
+  if (! _progress)
+  {
+    _progress = new XTreeWidgetProgress(this);
+    connect(_progress, SIGNAL(cancel()), &_workingTimer, SLOT(stop()));
+    connect(_progress, SIGNAL(cancel()), this, SIGNAL(populateCanceled()));
+  }
+  return _progress;
+}
+
+/*! Show the progress bar on behalf of whatever is feeding rows to
+    populate() a piece at a time. The bar stays visible until
+    hideProgress() is called and its cancel button emits
+    populateCanceled().
+ */
+void XTreeWidget::setProgress(int value, int maximum)
+{
+  _progressExternal = true;
+  progress()->setMaximum(maximum);
+  _progress->setValue(value);
+  _progress->show();
+}
+
+void XTreeWidget::hideProgress()
+{
+  _progressExternal = false;
+  if (_progress)
+    _progress->hide();
+
+  // if a chunk is still being added it finishes the populate itself
+  if (_populatePending && _workingParams.isEmpty())
+    finishPopulate();
+}
+
+/*! Stop adding rows, drop any populate() calls still waiting their turn,
+    and hide the progress bar. Whatever rows are already in the list are
+    kept and get their totals and sorting as if the populate had ended
+    there.
+ */
+void XTreeWidget::cancelPopulate()
+{
+  _workingTimer.stop();
+  bool pending = _populatePending || ! _workingParams.isEmpty();
+  _workingParams.clear();
+  cleanupAfterPopulate();
+
+  _progressExternal = false;
+  if (_progress)
+    _progress->hide();
+
+  if (pending)
+    finishPopulate();
+}
+
+/* the work done once all of the rows are in, however many populate()
+   calls it took to add them */
+void XTreeWidget::finishPopulate()
+{
+  _populatePending = false;
 
-  if (_colIdx)
-    delete _colIdx;
-  _colIdx = 0;
+  populateCalculatedColumns();
+  if (sortColumn() >= 0 && header()->isSortIndicatorShown())
+    sortItems(sortColumn(), header()->sortIndicatorOrder());
+  if (_merge)
+    restoreMergedState();
+
+  if (DEBUG)
+    qDebug("%s::finishPopulate() done", qPrintable(objectName()));
+  emit populated();
+}
+
+void XTreeWidget::cleanupAfterPopulate()
+{
+  if (_progress && ! _progressExternal)
+    _progress->hide();
+
+  _last = 0;
+
+  if (_resultSet)
+    _resultSet->squeeze();
+  _resultSet.clear();
+
+  _populatePlan.clear();
 
   _fieldCount = 0;
 }
@@ -1073,6 +1389,166 @@ bool XTreeWidgetItem::operator>(const XTreeWidgetItem &other) const
   return !(this < other || this == other);
 }
 */
+
+/* sortItems() extracts one of these per top-level row before sorting so
+   the comparisons work on plain values instead of re-reading QVariants.
+   rank orders mixed columns roughly the way XTreeWidgetItem::operator<
+   does: numbers (and dates) first, then text, then anything we don't
+   know how to compare.
+*/
+class XTreeWidgetSortKey
+{
+  public:
+    XTreeWidgetItem *item;
+    int     rank;
+    double  number;
+    QString text;
+};
+
+typedef bool (*XTreeWidgetSortLessThan)(const XTreeWidgetSortKey &, const XTreeWidgetSortKey &);
+
+static XTreeWidgetSortKey sortKey(XTreeWidgetItem *item, int column)
+{
+  XTreeWidgetSortKey key;
+  key.item   = item;
+  key.rank   = 0;
+  key.number = 0.0;
+
+  QVariant value = item->data(column, Xt::RawRole);
+  switch (value.type())
+  {
+    case QVariant::Bool:
+      key.number = value.toBool() ? 1.0 : 0.0;
+      break;
+
+    case QVariant::Date:
+      key.number = value.toDate().toJulianDay();
+      break;
+
+    case QVariant::DateTime:
+      if (value.toDateTime().isValid())
+        key.number = value.toDateTime().toMSecsSinceEpoch();
+      else
+        key.number = -std::numeric_limits<double>::max();
+      break;
+
+    case QVariant::Time:
+      key.number = QTime(0, 0).msecsTo(value.toTime());
+      break;
+
+    case QVariant::Double:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+      key.number = value.toDouble();
+      break;
+
+    case QVariant::String:
+      key.number = value.toString().toDouble();
+      if (key.number == 0.0)
+      {
+        key.rank = 1;
+        key.text = value.toString();
+      }
+      break;
+
+    default:
+      key.rank = 2;
+  }
+
+  return key;
+}
+
+static bool sortKeyLessThan(const XTreeWidgetSortKey &a, const XTreeWidgetSortKey &b)
+{
+  if (a.rank != b.rank)
+    return a.rank < b.rank;
+  else if (a.rank == 0)
+    return a.number < b.number;
+  else if (a.rank == 1)
+    return a.text < b.text;
+  return false;
+}
+
+static bool sortKeyGreaterThan(const XTreeWidgetSortKey &a, const XTreeWidgetSortKey &b)
+{
+  return sortKeyLessThan(b, a);
+}
+
+static void sortKeyRange(XTreeWidgetSortKey *begin, XTreeWidgetSortKey *end,
+                         XTreeWidgetSortLessThan lessThan)
+{
+  qStableSort(begin, end, lessThan);
+}
+
+// stable merge of the sorted runs src[begin, middle) and src[middle, end)
+static void mergeSortKeys(const QVector<XTreeWidgetSortKey> &src,
+                          QVector<XTreeWidgetSortKey> &dst,
+                          int begin, int middle, int end,
+                          XTreeWidgetSortLessThan lessThan)
+{
+  int left  = begin;
+  int right = middle;
+  int out   = begin;
+  while (left < middle && right < end)
+  {
+    if (lessThan(src.at(right), src.at(left)))
+      dst[out++] = src.at(right++);
+    else
+      dst[out++] = src.at(left++);
+  }
+  while (left < middle)
+    dst[out++] = src.at(left++);
+  while (right < end)
+    dst[out++] = src.at(right++);
+}
+
+/* stable merge sort of the keys. big lists are cut into runs that are
+   sorted on separate threads and then merged back together here.
+*/
+static void sortKeys(QVector<XTreeWidgetSortKey> &keys, XTreeWidgetSortLessThan lessThan)
+{
+  int runs = 1;
+  if (keys.size() >= SORTPARALLELROWS)
+    while (runs * 2 <= QThread::idealThreadCount() && runs < SORTMAXRUNS)
+      runs *= 2;
+
+  if (runs <= 1)
+  {
+    qStableSort(keys.begin(), keys.end(), lessThan);
+    return;
+  }
+
+  XTreeWidgetSortKey *data = keys.data();  // detach before the threads see it
+  QVector<int> bounds;
+  for (int i = 0; i <= runs; i++)
+    bounds.append((int)((qint64)keys.size() * i / runs));
+
+  QList<QFuture<void> > futures;
+  for (int i = 0; i < runs; i++)
+    futures.append(QtConcurrent::run(sortKeyRange,
+                                     data + bounds.at(i), data + bounds.at(i + 1),
+                                     lessThan));
+  for (int i = 0; i < futures.size(); i++)
+    futures[i].waitForFinished();
+
+  QVector<XTreeWidgetSortKey> merged(keys.size());
+  for (int width = 1; width < runs; width *= 2)
+  {
+    for (int i = 0; i < runs; i += 2 * width)
+      mergeSortKeys(keys, merged, bounds.at(i), bounds.at(i + width),
+                    bounds.at(i + 2 * width), lessThan);
+    keys.swap(merged);
+  }
+}
+
+/* Sort the top-level items on the raw values of the given column.
+   Each row's key is extracted once, the keys are merge sorted and the
+   items are put back in a single pass. Child items move with their
+   parents. The total row is dropped here and rebuilt by
+   populateCalculatedColumns().
+*/
 void XTreeWidget::sortItems(int column, Qt::SortOrder order)
 {
   int previd = id();
@@ -1090,176 +1566,221 @@ void XTreeWidget::sortItems(int column, Qt::SortOrder order)
 
   header()->setSortIndicator(column, order);
 
-  // simple insertion sort using binary search to find the right insertion pt
   QString totalrole("totalrole");
-  int     itemcount      = topLevelItemCount();
-  XTreeWidgetItem *prev  = dynamic_cast<XTreeWidgetItem *>(topLevelItem(0));
-  for (int i = 1; i < itemcount; i++)
+  QList<QTreeWidgetItem *> expanded;
+  QList<QTreeWidgetItem *> pending;
+  for (int i = 0; i < topLevelItemCount(); i++)
+    if (QTreeWidget::topLevelItem(i)->childCount() > 0)
+      pending.append(QTreeWidget::topLevelItem(i));
+  while (! pending.isEmpty())
+  {
+    QTreeWidgetItem *parent = pending.takeLast();
+    if (parent->isExpanded())
+      expanded.append(parent);
+    for (int i = 0; i < parent->childCount(); i++)
+      if (parent->child(i)->childCount() > 0)
+        pending.append(parent->child(i));
+  }
+
+  QList<QTreeWidgetItem *> taken = QTreeWidget::invisibleRootItem()->takeChildren();
+  QList<QTreeWidgetItem *> totals;
+
+  QVector<XTreeWidgetSortKey> keys;
+  keys.reserve(taken.size());
+  for (int i = 0; i < taken.size(); i++)
   {
-    XTreeWidgetItem *item = dynamic_cast<XTreeWidgetItem *>(topLevelItem(i));
+    XTreeWidgetItem *item = dynamic_cast<XTreeWidgetItem *>(taken.at(i));
     if (!item)
-    {
       qWarning("removing a non-XTreWidgetItem from an XTreeWidget");
-      takeTopLevelItem(i);
-      itemcount--;
-      i--;
-    }
     else if (item->data(0, Qt::UserRole).toString() == totalrole)
     {
       if (DEBUG)
-        qDebug("sortItems() removing row %d because it's a totalrole", i);
-      takeTopLevelItem(i);
-      itemcount--;
-      i--;
-    }
-    else if (*item < *prev && order == Qt::AscendingOrder)
-    {
-      int left   = 0;
-      int right  = i;
-      int middle = 0;
-      XTreeWidgetItem *test = 0;
-      while (left <= right)
-      {
-        middle = (left + right) / 2;
-        test   = static_cast<XTreeWidgetItem *>(topLevelItem(middle));
-        if (*test == *item)
-          break;
-        else if (*test < *item)
-        {
-          if (*item < *(static_cast<XTreeWidgetItem *>(topLevelItem(middle + 1))))
-            break;
-          else
-            left = middle + 1;
-        }
-        else
-          right = middle - 1;
-      }
-      // can't call takeTopLevelItem() until after < and == are done
-      if (*item < *test || *item == *test)
-      {
-        if (DEBUG)
-          qDebug("<= so moving %d to %d", i, middle);
-        takeTopLevelItem(i);
-        insertTopLevelItem(middle, item);
-      }
-      else
-      {
-        if (DEBUG)
-          qDebug("> so moving %d to %d", i, middle + 1);
-        takeTopLevelItem(i);
-        insertTopLevelItem(middle + 1, item);
-      }
-    }
-    else if (*item == *prev)
-    {
-      ; // nothing to do - make the > case easier to write
+        qDebug("sortItems() moving row %d to the end because it's a totalrole", i);
+      totals.append(item);
     }
-    else if (!(*item < *prev) && order == Qt::DescendingOrder)
-    {
-      int left   = 0;
-      int right  = i;
-      int middle = 0;
-      XTreeWidgetItem *test = 0;
-      while (left <= right)
-      {
-        middle = (left + right) / 2;
-        test   = static_cast<XTreeWidgetItem *>(topLevelItem(middle));
-        if (*test == *item)
-          break;
-        else if (!(*test < *item))
-        {
-          if (!(*item < *(static_cast<XTreeWidgetItem *>(topLevelItem(middle + 1)))))
-            break;
-          else
-            left = middle + 1;
-        }
-        else
-          right = middle - 1;
-      }
-      // can't call takeTopLevelItem() until after < and == are done
-      if (!(*item < *test) || *item == *test)
-      {
-        if (DEBUG)
-          qDebug(">= so moving %d to %d", i, middle);
-        takeTopLevelItem(i);
-        insertTopLevelItem(middle, item);
-      }
-      else
-      {
-        if (DEBUG)
-          qDebug("< so moving %d to %d", i, middle + 1);
-        takeTopLevelItem(i);
-        insertTopLevelItem(middle + 1, item);
-      }
-    }
-    // can't reuse item because the thing in position i may have changed
-    prev = static_cast<XTreeWidgetItem *>(topLevelItem(i));
+    else
+      keys.append(sortKey(item, column));
   }
 
+  sortKeys(keys, order == Qt::AscendingOrder ? sortKeyLessThan : sortKeyGreaterThan);
+
+  QList<QTreeWidgetItem *> sorted;
+  sorted.reserve(keys.size());
+  for (int i = 0; i < keys.size(); i++)
+    sorted.append(keys.at(i).item);
+  keys.clear();
+  sorted += totals;
+
+  QTreeWidget::addTopLevelItems(sorted);
+  for (int i = 0; i < expanded.size(); i++)
+    expanded.at(i)->setExpanded(true);
+
+  _calculatedRows = 0;    // every running sum can change
   populateCalculatedColumns();
 
   setId(previd);
   emit resorted();
 }
 
+/* Running sums and totals are kept for the top-level rows counted so far,
+   all but the last, so after an Append only the new rows and the last old
+   one are added in; a re-sort, a merge, or a row added or removed above
+   them starts the count over. A cell is only reformatted if its value
+   actually changed. Totals are shown one row per non-negative totalset;
+   existing totals rows are kept, wherever an Append left them, and only
+   the cells whose value changed are updated.
+ */
 void XTreeWidget::populateCalculatedColumns()
 {
-  QMap<int, QMap<int, double> > totals; // <col <totalset, subtotal> >
-  QMap<int, int> scales;                // keep scale for the col, not col[totalset]
+  _calculating = true;
+
+  // an Append that wasn't re-sorted leaves the old totals rows above the new rows
+  QMap<int, XTreeWidgetItem *> oldTotals;  // <totalset, totals row>
+  for (int row = topLevelItemCount() - 1; row >= _calculatedRows; row--)
+  {
+    if (topLevelItem(row)->data(0, Qt::UserRole).toString() != "totalrole")
+      continue;
+    XTreeWidgetItem *item = dynamic_cast<XTreeWidgetItem *>(takeTopLevelItem(row));
+    if (item)
+      oldTotals.insert(item->data(0, Xt::TotalSetRole).toInt(), item);
+  }
+
+  QList<int> runningCols;
+  QList<int> totalCols;
   for (int col = 0; topLevelItem(0) &&
        col < topLevelItem(0)->columnCount(); col++)
   {
     if (headerItem()->data(col, Qt::UserRole).toString() == "xtrunningrole")
+      runningCols.append(col);
+    else if (headerItem()->data(col, Qt::UserRole).toString() == "xttotalrole")
+      totalCols.append(col);
+  }
+
+  int rows = topLevelItemCount();
+  if (_calculatedRows == 0)
+  {
+    _runningSums.clear();
+    _totalSums.clear();
+    _totalScales.clear();
+  }
+  for (int row = _calculatedRows; row < rows - 1; row++)
+    addCalculatedRow(topLevelItem(row), runningCols, totalCols,
+                     _runningSums, _totalSums, _totalScales);
+  _calculatedRows = qMax(rows - 1, 0);
+
+  // the last row can still get children from the next Append, so it's
+  // added to copies of the sums instead of the sums that are kept
+  QHash<int, QHash<int, double> > running = _runningSums;
+  QMap<int, QMap<int, double> >   totals  = _totalSums;
+  QMap<int, int>                  scales  = _totalScales;
+  if (rows > 0)
+    addCalculatedRow(topLevelItem(rows - 1), runningCols, totalCols, running, totals, scales);
+
+  // negative totalsets are never shown so queries can keep rows out of the totals
+  QMap<int, QMap<int, double> >::iterator neg = totals.begin();
+  while (neg != totals.end() && neg.key() < 0)
+    neg = totals.erase(neg);
+
+  QMapIterator<int, QMap<int, double> > set(totals);
+  while (set.hasNext())
+  {
+    set.next();
+    QString label = (totalCols.size() == 1) ? tr("Total") : tr("Totals");
+    if (totals.size() > 1 && set.key() != 0)
+      label = tr("%1 %2").arg(label).arg(set.key());
+
+    XTreeWidgetItem *last = oldTotals.take(set.key());
+    if (last)
+      addTopLevelItem(last);
+    else
     {
-      QMap<int, double> subtotals;
-      // assume that Xt::RunningSetRole exists if xtrunningrole exists
-      for (int row = 0; row < topLevelItemCount(); row++)
-      {
-        int set = topLevelItem(row)->data(col, Xt::RunningSetRole).toInt();
-        if (!subtotals.contains(set))
-          subtotals[set] = topLevelItem(row)->data(col, Xt::RunningInitRole).toDouble();
-        subtotals[set] += topLevelItem(row)->data(col, Xt::RawRole).toDouble();
-
-        // setData apparently knows if the value hasn't changed
-        topLevelItem(row)->setData(col, Qt::DisplayRole,
-                                   QLocale().toString(subtotals[set], 'f',
-                                                      topLevelItem(row)->data(col, Xt::ScaleRole).toInt()));
-      }
+      last = new XTreeWidgetItem(this, -1, -1, label);
+      last->setData(0, Qt::UserRole, "totalrole");
+      last->setData(0, Xt::TotalSetRole, set.key());
     }
-    else if (headerItem()->data(col, Qt::UserRole).toString() == "xttotalrole")
+    if (last->text(0) != label)
+      last->setText(0, label);
+
+    QMapIterator<int, double> it(set.value());
+    while (it.hasNext())
     {
-      QMap<int, double> totalset;
-      int colscale = -99999;
-      // assume that Xt::TotalSetRole exists if xttotalrole exists
-      for (int row = 0; row < topLevelItemCount(); row++)
+      it.next();
+      QVariant prev = last->data(it.key(), Xt::RawRole);
+      if (! prev.isValid() || prev.toDouble() != it.value())
       {
-        int set = topLevelItem(row)->data(col, Xt::TotalSetRole).toInt();
-        if (!totalset.contains(set))
-          totalset[set] = topLevelItem(row)->data(col, Xt::TotalInitRole).toInt();
-        totalset[set] += topLevelItem(row)->totalForItem(col, set);
-        if (topLevelItem(row)->data(col, Xt::ScaleRole).toInt() > colscale)
-          colscale = topLevelItem(row)->data(col, Xt::ScaleRole).toInt();
+        last->setData(it.key(), Xt::RawRole, it.value());
+        last->setData(it.key(), Qt::DisplayRole,
+                      QLocale().toString(it.value(), 'f', scales.value(it.key())));
       }
-      totals.insert(col, totalset);
-      scales.insert(col, colscale);
     }
   }
 
-  // punt: for now only report values of totalset[0] for each totaled col
-  // TODO: figure out how to handle multiple totalsets
-  if (totals.size() > 0)
+  qDeleteAll(oldTotals);
+  _calculating = false;
+}
+
+/* add one top-level row to the running sums and, with its children, to
+   the totals, and show its running sums where they changed */
+void XTreeWidget::addCalculatedRow(XTreeWidgetItem *top,
+                                   const QList<int> &runningCols, const QList<int> &totalCols,
+                                   QHash<int, QHash<int, double> > &running,
+                                   QMap<int, QMap<int, double> > &totals,
+                                   QMap<int, int> &scales)
+{
+  // assume that Xt::RunningSetRole exists if xtrunningrole exists
+  for (int c = 0; c < runningCols.size(); c++)
   {
-    XTreeWidgetItem *last = new XTreeWidgetItem(this, -1, -1,
-                                                (totals.size() == 1) ? tr("Total") : tr("Totals"));
-    last->setData(0, Qt::UserRole, "totalrole");
-    QMapIterator<int, QMap<int, double> > it(totals);
-    while (it.hasNext())
+    int col = runningCols.at(c);
+    QHash<int, double> &subtotals = running[col];
+    int set = top->data(col, Xt::RunningSetRole).toInt();
+    QHash<int, double>::iterator sum = subtotals.find(set);
+    if (sum == subtotals.end())
+      sum = subtotals.insert(set, top->data(col, Xt::RunningInitRole).toDouble());
+    *sum += top->data(col, Xt::RawRole).toDouble();
+
+    QVariant prev = top->data(col, Xt::RunningValueRole);
+    if (! prev.isValid() || prev.toDouble() != *sum)
     {
-      it.next();
-      last->setData(it.key(), Qt::DisplayRole,
-                    QLocale().toString(it.value().value(0), 'f',
-                                       scales.value(it.key())));
+      top->setData(col, Xt::RunningValueRole, *sum);
+      top->setData(col, Qt::DisplayRole,
+                   QLocale().toString(*sum, 'f', top->data(col, Xt::ScaleRole).toInt()));
+    }
+  }
+
+  if (totalCols.isEmpty())
+    return;
+
+  // assume that Xt::TotalSetRole exists if xttotalrole exists
+  QVector<int> sets(totalCols.size());
+  for (int c = 0; c < totalCols.size(); c++)
+  {
+    int col = totalCols.at(c);
+    sets[c] = top->data(col, Xt::TotalSetRole).toInt();
+    QMap<int, double> &subtotals = totals[sets.at(c)];
+    if (! subtotals.contains(col))
+      subtotals.insert(col, top->data(col, Xt::TotalInitRole).toDouble());
+    int scale = top->data(col, Xt::ScaleRole).toInt();
+    if (! scales.contains(col) || scale > scales.value(col))
+      scales.insert(col, scale);
+  }
+
+  // same as totalForItem() for each column but in one walk of the subtree:
+  // children count toward their top-level row's totalset
+  QList<QTreeWidgetItem *> pending;
+  pending.append(top);
+  while (! pending.isEmpty())
+  {
+    XTreeWidgetItem *item = dynamic_cast<XTreeWidgetItem *>(pending.takeLast());
+    if (! item)
+      continue;
+    for (int c = 0; c < totalCols.size(); c++)
+    {
+      int col = totalCols.at(c);
+      if (item->data(col, Xt::TotalSetRole).toInt() == sets.at(c))
+        totals[sets.at(c)][col] += item->data(col, Xt::RawRole).toDouble();
     }
+    for (int i = 0; i < item->childCount(); i++)
+      pending.append(item->QTreeWidgetItem::child(i));
   }
 }
 
@@ -1403,6 +1924,19 @@ void XTreeWidget::setPopulateLinear(bool alwaysLinear)
   _alwaysLinear = alwaysLinear;
 }
 
+/*!
+  If \a backed is true then populate() keeps a column-oriented copy of the
+  query result and builds item text on demand instead of storing every
+  formatted role on every XTreeWidgetItem. This trades a little work at
+  paint time for much less memory and a much faster populate() on large
+  result sets. Items behave the same either way.
+*/
+bool XTreeWidget::resultSetBacked() const { return _resultSetBacked; }
+void XTreeWidget::setResultSetBacked(bool backed)
+{
+  _resultSetBacked = backed;
+}
+
 void XTreeWidget::clear()
 {
   if (DEBUG)
@@ -1421,10 +1955,29 @@ void XTreeWidget::clear()
   }
   emit valid(FALSE);
   _savedId = false; // was -1;
+  _appendLast = 0;
+  _populatePending = false;
+  _calculatedRows = 0;
 
   QTreeWidget::clear();
 }
 
+/* rows added or removed anywhere but after the ones populateCalculatedColumns()
+   has already counted mean it has to count from the top again. children
+   added to the last counted row are fine: that row is always recounted.
+ */
+void XTreeWidget::sRowsChanged(const QModelIndex &parent, int start, int)
+{
+  if (_calculating || _calculatedRows == 0)
+    return;
+
+  int row = start;
+  for (QModelIndex top = parent; top.isValid(); top = top.parent())
+    row = top.row();
+  if (row < _calculatedRows)
+    _calculatedRows = 0;
+}
+
 void XTreeWidget::sSelectionChanged()
 {
   QList<XTreeWidgetItem *> items = selectedItems();
@@ -1552,10 +2105,12 @@ void XTreeWidget::sExport()
   QString   path = xtsettingsValue(_settingsName + "/exportPath").toString();
   QString selectedFilter;
   QFileInfo fi(QFileDialog::getSaveFileName(this, tr("Export Save Filename"), path,
-                                            tr("Text CSV (*.csv);;Text VCF (*.vcf);;Text (*.txt);;ODF Text Document (*.odt);;HTML Document (*.html)"), &selectedFilter));
+                                            tr("Text CSV (*.csv);;Text TSV (*.tsv);;Text VCF (*.vcf);;Text (*.txt);;ODF Text Document (*.odt);;HTML Document (*.html)"), &selectedFilter));
   QString defaultSuffix;
   if(selectedFilter.contains("csv"))
     defaultSuffix = ".csv";
+  else if(selectedFilter.contains("tsv"))
+    defaultSuffix = ".tsv";
   else if(selectedFilter.contains("vcf"))
     defaultSuffix = ".vcf";
   else if(selectedFilter.contains("odt"))
@@ -1565,42 +2120,26 @@ void XTreeWidget::sExport()
   else
     defaultSuffix = ".txt";
 
-  if (!fi.filePath().isEmpty())
-  {
-    QTextDocument       *doc = new QTextDocument();
-    QTextDocumentWriter writer;
-    if (fi.suffix().isEmpty())
-      fi.setFile(fi.filePath() += defaultSuffix);
-    xtsettingsSetValue(_settingsName + "/exportPath", fi.path());
-    writer.setFileName(fi.filePath());
+  if (fi.filePath().isEmpty())
+    return;
 
-    if (fi.suffix() == "txt")
-    {
-      doc->setPlainText(toTxt());
-      writer.setFormat("plaintext");
-    }
-    else if (fi.suffix() == "csv")
-    {
-      doc->setPlainText(toCsv());
-      writer.setFormat("plaintext");
-    }
-    else if (fi.suffix() == "vcf")
-    {
-      doc->setPlainText(toVcf());
-      writer.setFormat("plaintext");
-    }
-    else if (fi.suffix() == "odt")
-    {
-      doc->setHtml(toHtml());
-      writer.setFormat("odf");
-    }
-    else if (fi.suffix() == "html")
-    {
-      doc->setHtml(toHtml());
-      writer.setFormat("HTML");
-    }
-    writer.write(doc);
-  }
+  if (fi.suffix().isEmpty())
+    fi.setFile(fi.filePath() += defaultSuffix);
+  xtsettingsSetValue(_settingsName + "/exportPath", fi.path());
+
+  XTreeWidgetExporter exporter(this);
+  QProgressDialog     dialog(tr("Exporting %1").arg(fi.fileName()),
+                             tr("Cancel"), 0, 0, this);
+  dialog.setWindowModality(Qt::WindowModal);
+  dialog.setMinimumDuration(500);
+  connect(&exporter, SIGNAL(progressRangeChanged(int, int)), &dialog,   SLOT(setRange(int, int)));
+  connect(&exporter, SIGNAL(progressValueChanged(int)),     &dialog,   SLOT(setValue(int)));
+  connect(&dialog,   SIGNAL(canceled()),                    &exporter, SLOT(cancel()));
+
+  if (! exporter.exportFile(fi.filePath()) && ! exporter.isCanceled())
+    QMessageBox::critical(this, tr("Export Failed"),
+                          tr("<p>Could not export to %1:<br>%2")
+                            .arg(fi.filePath(), exporter.errorString()));
 }
 
 void XTreeWidget::mousePressEvent(QMouseEvent *event)
@@ -1886,6 +2425,7 @@ void XTreeWidgetItem::constructor(int pId, int pAltId, QVariant v0,QVariant v1,
 {
   _id    = pId;
   _altId = pAltId;
+  _resultRow = -1;
 
   if (!v0.isNull())
     setText(0,  v0);
@@ -1928,6 +2468,123 @@ void XTreeWidgetItem::constructor(int pId, int pAltId, QVariant v0,QVariant v1,
   }
 }
 
+/* Take on the data populateWorker() put in \a other, another row built for
+   the same key, calling setData() only where something actually changed
+   so the view repaints just the changed cells of a merged row.
+ */
+void XTreeWidgetItem::mergeFrom(const XTreeWidgetItem *other)
+{
+  static const int roles[] = {
+    Qt::DisplayRole,      Qt::TextAlignmentRole, Qt::BackgroundRole,
+    Qt::ForegroundRole,   Qt::ToolTipRole,       Qt::StatusTipRole,
+    Qt::FontRole,         Xt::RawRole,           Xt::ScaleRole,
+    Xt::IdRole,           Xt::RunningSetRole,    Xt::RunningInitRole,
+    Xt::TotalSetRole,     Xt::TotalInitRole,     Xt::IndentRole,
+    Xt::DeletedRole,      Xt::RunningValueRole
+  };
+
+  _resultSet = other->_resultSet;
+  _resultRow = other->_resultRow;
+
+  int columns = qMax(columnCount(), other->columnCount());
+  for (int col = 0; col < columns; col++)
+    for (unsigned int r = 0; r < sizeof(roles) / sizeof(roles[0]); r++)
+    {
+      QVariant value = other->QTreeWidgetItem::data(col, roles[r]);
+      if (QTreeWidgetItem::data(col, roles[r]) != value)
+        setData(col, roles[r], value);
+    }
+}
+
+// value of an optional role column for a row, invalid if absent or NULL
+static QVariant resultSetRole(const XTreeWidgetResultSet *rs, int row, int field)
+{
+  if (field <= 0 || rs->isNull(row, field))
+    return QVariant();
+  return rs->value(row, field);
+}
+
+/* Rebuild the data populateWorker() would have stored on an item from
+   the result set row behind it. Keep this in sync with the per-column
+   setData() calls in populateWorker().
+*/
+static QVariant resultSetData(const XTreeWidgetResultSet *rs, int row, int col, int role)
+{
+  const XTreeWidgetPopulatePlan *plan = rs->_plan.data();
+  const int *colRole = plan->_colRole.constData() + col * COLROLE_COUNT;
+
+  switch (role)
+  {
+    case Xt::RawRole:
+      return rs->value(row, plan->_colIdx.at(col));
+
+    case Xt::ScaleRole:
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+    {
+      bool percent = false;
+      int  scale   = plan->scale(col, resultSetRole(rs, row, colRole[COLROLE_NUMERIC]),
+                                 &percent);
+      if (role == Xt::ScaleRole)
+        return plan->hasScale(col) ? QVariant(scale) : QVariant();
+
+      return plan->format(col, rs->value(row, plan->_colIdx.at(col)),
+                          resultSetRole(rs, row, colRole[COLROLE_DISPLAY]),
+                          colRole[COLROLE_NULL] ? rs->value(row, colRole[COLROLE_NULL]) :
+                                                  QVariant(),
+                          scale, percent);
+    }
+
+    case Qt::ForegroundRole:
+    case Qt::BackgroundRole:
+    {
+      QVariant color = resultSetRole(rs, row,
+                                     colRole[role == Qt::ForegroundRole ?
+                                             COLROLE_FOREGROUND : COLROLE_BACKGROUND]);
+      if (color.isValid())
+        return namedColor(color.toString());
+      break;
+    }
+
+    case Qt::TextAlignmentRole:
+      if (colRole[COLROLE_TEXTALIGNMENT])
+        return resultSetRole(rs, row, colRole[COLROLE_TEXTALIGNMENT]);
+      return plan->_alignment.at(col);
+
+    case Qt::ToolTipRole:
+      return resultSetRole(rs, row, colRole[COLROLE_TOOLTIP]);
+
+    case Qt::StatusTipRole:
+      return resultSetRole(rs, row, colRole[COLROLE_STATUSTIP]);
+
+    case Qt::FontRole:
+      return resultSetRole(rs, row, colRole[COLROLE_FONT]);
+
+    case Xt::RunningInitRole:
+      return resultSetRole(rs, row, colRole[COLROLE_RUNNINGINIT]);
+
+    case Xt::IdRole:
+      return resultSetRole(rs, row, colRole[COLROLE_ID]);
+
+    case Xt::TotalSetRole:
+      if (colRole[COLROLE_TOTAL])
+        return rs->value(row, colRole[COLROLE_TOTAL]).toInt();
+      break;
+  }
+
+  return QVariant();
+}
+
+QVariant XTreeWidgetItem::data(int colidx, int role) const
+{
+  QVariant result = QTreeWidgetItem::data(colidx, role);
+  if (_resultSet && ! result.isValid() &&
+      colidx >= 0 && colidx < _resultSet->_plan->columns())
+    result = resultSetData(_resultSet.data(), _resultRow, colidx, role);
+
+  return result;
+}
+
 int XTreeWidgetItem::id(const QString p)
 {
   int id = data(((XTreeWidget *)treeWidget())->column(p), Xt::IdRole).toInt();
@@ -2131,6 +2788,7 @@ void setupXTreeWidget(QScriptEngine *engine)
 
   glob.setProperty("Replace", QScriptValue(engine, XTreeWidget::Replace), QScriptValue::ReadOnly | QScriptValue::Undeletable);
   glob.setProperty("Append",  QScriptValue(engine, XTreeWidget::Append), QScriptValue::ReadOnly | QScriptValue::Undeletable);
+  glob.setProperty("Merge",   QScriptValue(engine, XTreeWidget::Merge), QScriptValue::ReadOnly | QScriptValue::Undeletable);
 
   glob.setProperty("itemColumn",     QScriptValue(engine, _itemColumn),    QScriptValue::ReadOnly | QScriptValue::Undeletable);
   glob.setProperty("whsColumn",      QScriptValue(engine, _whsColumn),     QScriptValue::ReadOnly | QScriptValue::Undeletable);
@@ -2269,18 +2927,16 @@ void XTreeWidget::sCopyVisibleToClipboard()
 void XTreeWidget::sSearch(const QString &pTarget)
 {
   clearSelection();
-  int i;
-  for (i = 0; i < topLevelItemCount(); i++)
-  {
-    // Currently this only looks at the first column
-    if (topLevelItem(i)->text(0).contains(pTarget, Qt::CaseInsensitive))
-      break;
-  }
 
-  if (i < topLevelItemCount())
+  // Currently this only looks at the first column
+  if (! _searchIndex)
+    _searchIndex = new XTreeWidgetSearchIndex(this, QList<int>() << 0, this);
+
+  QTreeWidgetItem *found = _searchIndex->contains(pTarget);
+  if (found)
   {
-    setCurrentItem(topLevelItem(i));
-    scrollToItem(topLevelItem(i));
+    setCurrentItem(found);
+    scrollToItem(found);
   }
 }
 
@@ -2374,105 +3030,21 @@ QString XTreeWidget::toCsv() const
   return opText;
 }
 
+/*! Return VCARD 3.0 records for the contacts the selected rows point to,
+    or for every listed row if none is selected. The contacts are fetched
+    in one query; see XTreeWidgetExporter.
+ */
 QString XTreeWidget::toVcf() const
 {
-  XSqlQuery qry;
-  qry.prepare("SELECT * FROM cntct WHERE (cntct_id=:cntct_id);");
-  qry.bindValue(":cntct_id", this->selectedItems().at(0)->id());
-  qry.exec();
-  if (qry.first()) {
-    QString name;
-    QString fullName;
-    QString first = qry.value("cntct_first_name").toString();
-    QString middle = qry.value("cntct_middle").toString();
-    QString last = qry.value("cntct_last_name").toString();
-    if (!last.isEmpty()) {
-      name = last;
-      fullName = last;
-    }
-    if (!middle.isEmpty()) {
-      name = name + ";" + middle;
-      fullName = middle + " " + fullName;
-    }
-    if (!first.isEmpty()) {
-      name = name + ";" + first;
-      fullName = first + " " + fullName;
-    }
-    QString begin = "VCARD";
-    QString version = "3.0";
-    QString org = "";
-    QString title = qry.value("cntct_title").toString();
-    QString photo = "";
-    QString phoneWork = qry.value("cntct_phone").toString();
-    QString phoneHome = qry.value("cntct_phone2").toString();
-    QString addressId = qry.value("cntct_addr_id").toString();
-    XSqlQuery qry2;
-    qry2.prepare("SELECT * FROM addr WHERE (addr_id=:addr_id);");
-    qry2.bindValue(":addr_id", addressId);
-    qry2.exec();
-    QStringList address;
-    QString addressWork= "";
-    QString labelWork = "";
-    if (qry2.first()) {
-      /*
-      * this is tricky, because sometimes (in the test database at least)
-      * our addr_line1 is the company name, and sometimes it's really the
-      * first line of the actual address.  For the former, we can use
-      * the addr_line1 as the organization name.
-      */
-      if(qry2.value("addr_line1").toString().at(0).isDigit())
-        address.append(qry2.value("addr_line1").toString());
-      else
-        org = qry2.value("addr_line1").toString();
-      address.append(qry2.value("addr_line2").toString());
-      address.append(qry2.value("addr_line3").toString());
-      address.append(qry2.value("addr_city").toString());
-      address.append(qry2.value("addr_state").toString());
-      address.append(qry2.value("addr_postalcode").toString());
-      address.append(qry2.value("addr_country").toString());
-    }
-    //for address, set address with semicolon delimiters
-    //for label, set address with ESCAPED newline delimiters
-    for (int i = 0; i < address.length(); i++) {
-      if(!address.at(i).isEmpty()) {
-        addressWork = addressWork + address.at(i) + ";";
-        labelWork = labelWork + address.at(i) + "\\n";
-      }
-    }
-    QString addressHome = "";
-    QString labelHome = "";
-    QString email = qry.value("cntct_email").toString();
-    QDate date = QDate::currentDate();
-    QString revision = date.toString(Qt::ISODate);
-    QString end = "VCARD";
-
-    QString stringToSave;
-
-    stringToSave.append("BEGIN:" + begin + "\n");
-    stringToSave.append("VERSION:" + version + "\n");
-    stringToSave.append("N:" + name + "\n");
-    stringToSave.append("FN:" + fullName + "\n");
-    if (!org.isEmpty())
-      stringToSave.append("ORG:" + org + "\n");
-    if (!title.isEmpty())
-      stringToSave.append("TITLE:" + title + "\n");
-    if (!phoneWork.isEmpty())
-      stringToSave.append("TEL;TYPE=WORK,VOICE:" + phoneWork + "\n");
-    if (!phoneHome.isEmpty())
-      stringToSave.append("TEL;TYPE=HOME,VOICE:" + phoneHome + "\n");
-    if (!addressWork.isEmpty())
-      stringToSave.append("ADR;TYPE=WORK:;;" + addressWork + "\n");
-    if (!labelWork.isEmpty())
-      stringToSave.append("LABEL;TYPE=WORK:;;" + labelWork + "\n");
-    if (!email.isEmpty())
-      stringToSave.append("EMAIL;TYPE=PREF,INTERNET:" + email + "\n");
-    stringToSave.append("REV:" + revision + "\n");
-    stringToSave.append("END:" + end + "\n");
-
-    return stringToSave;
-  }
-  else
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+
+  XTreeWidgetExporter exporter(const_cast<XTreeWidget *>(this));
+  if (! exporter.exportDevice(&buffer, XTreeWidgetExporter::VCF) ||
+      exporter.rowsWritten() == 0)
     return "failed to select contact for export";
+
+  return QString::fromUtf8(buffer.data());
 }
 
 QString XTreeWidget::toHtml() const
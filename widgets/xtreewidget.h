@@ -11,8 +11,13 @@
 #ifndef __XTREEWIDGET_H__
 #define __XTREEWIDGET_H__
 
+#include <QHash>
+#include <QMap>
+#include <QPointer>
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
+#include <QSharedPointer>
+#include <QSqlRecord>
 #include <QVariant>
 #include <QVector>
 #include <QTimer>
@@ -57,7 +62,11 @@ class QAction;
 class QMenu;
 class QScriptEngine;
 class XTreeWidget;
+class XTreeWidgetMerge;
+class XTreeWidgetPopulatePlan;
 class XTreeWidgetProgress;
+class XTreeWidgetResultSet;
+class XTreeWidgetSearchIndex;
 
 void  setupXTreeWidgetItem(QScriptEngine *engine);
 void  setupXTreeWidget(QScriptEngine *engine);
@@ -129,7 +138,7 @@ class XTUPLEWIDGETS_EXPORT XTreeWidgetItem : public QObject, public QTreeWidgetI
     Q_INVOKABLE inline void             setId(int pId)    { _id = pId;     }
     Q_INVOKABLE inline void             setAltId(int pId) { _altId = pId;  }
 
-    Q_INVOKABLE inline QVariant         data(int colidx,    int role) const { return QTreeWidgetItem::data(colidx, role); }
+    Q_INVOKABLE virtual QVariant        data(int colidx,    int role) const;
     Q_INVOKABLE inline void             setData(int colidx, int role, const QVariant &val) { QTreeWidgetItem::setData(colidx, role, val); }
     Q_INVOKABLE virtual QVariant        rawValue(const QString colname);
     Q_INVOKABLE virtual int             id(const QString);
@@ -149,12 +158,15 @@ class XTUPLEWIDGETS_EXPORT XTreeWidgetItem : public QObject, public QTreeWidgetI
     virtual double totalForItem(const int, const int) const;
 
   private:
+    void mergeFrom(const XTreeWidgetItem *other);
     void constructor( int, int, QVariant, QVariant, QVariant,
                       QVariant, QVariant, QVariant, QVariant,
                       QVariant, QVariant, QVariant, QVariant );
 
     int _id;
     int _altId;
+    QSharedPointer<XTreeWidgetResultSet> _resultSet;
+    int _resultRow;
 };
 
 Q_DECLARE_METATYPE(XTreeWidgetItem *)
@@ -162,16 +174,36 @@ Q_DECLARE_METATYPE(XTreeWidgetItem *)
 
 class XTreeWidgetPopulateParams;
 
+/* populateWorker() walks its input through this interface so an
+   XTreeWidget can be filled either from a live XSqlQuery or from rows
+   that were fetched somewhere else, such as on a background thread.
+*/
+class XTUPLEWIDGETS_EXPORT XTreeWidgetRows
+{
+  public:
+    virtual ~XTreeWidgetRows() {}
+
+    virtual int         at()          const = 0;
+    virtual int         count()       const = 0;
+    virtual bool        first()             = 0;
+    virtual bool        next()              = 0;
+    virtual QSqlRecord  record()      const = 0;
+    virtual bool        seek(int)           = 0;
+    virtual int         size()        const = 0;
+    virtual QVariant    value(int)    const = 0;
+};
+
 class XTUPLEWIDGETS_EXPORT XTreeWidget : public QTreeWidget
 {
   Q_OBJECT Q_PROPERTY(QString dragString READ dragString WRITE setDragString)
   Q_PROPERTY( QString altDragString READ altDragString WRITE setAltDragString)
   Q_PROPERTY( bool populateLinear READ populateLinear WRITE setPopulateLinear)
+  Q_PROPERTY( bool resultSetBacked READ resultSetBacked WRITE setResultSetBacked)
 
   Q_ENUMS(PopulateStyle)
 
   public :
-    enum PopulateStyle { Replace, Append };
+    enum PopulateStyle { Replace, Append, Merge };
     XTreeWidget(QWidget *);
     ~XTreeWidget();
 
@@ -179,6 +211,7 @@ class XTUPLEWIDGETS_EXPORT XTreeWidget : public QTreeWidget
     Q_INVOKABLE void  populate(XSqlQuery, int, bool = FALSE, PopulateStyle = Replace);
     void    populate(const QString&, bool = FALSE);
     void    populate(const QString&, int, bool = FALSE);
+    void    populate(const QSqlRecord&, const QList<QVariantList>&, int, bool = FALSE, PopulateStyle = Replace);
 
     QString dragString() const;
     void    setDragString(QString);
@@ -186,6 +219,12 @@ class XTUPLEWIDGETS_EXPORT XTreeWidget : public QTreeWidget
     void    setAltDragString(QString);
     bool    populateLinear();
     void    setPopulateLinear(bool alwaysLinear = true);
+    bool    resultSetBacked() const;
+    void    setResultSetBacked(bool backed = true);
+
+    Q_INVOKABLE void  setProgress(int value, int maximum);
+    Q_INVOKABLE void  hideProgress();
+    Q_INVOKABLE void  cancelPopulate();
 
     Q_INVOKABLE int   altId() const;
     Q_INVOKABLE int   id()    const;
@@ -282,6 +321,7 @@ class XTUPLEWIDGETS_EXPORT XTreeWidget : public QTreeWidget
     void  populateMenu(QMenu *, XTreeWidgetItem *, int);
     void  resorted();
     void  populated();
+    void  populateCanceled();
 
   protected slots:
     void  sHeaderClicked(int);
@@ -324,21 +364,46 @@ class XTUPLEWIDGETS_EXPORT XTreeWidget : public QTreeWidget
     int           _scol;
     Qt::SortOrder _sord;
     static void   loadLocale();
+    void          populate(QSharedPointer<XTreeWidgetRows>, int, bool, PopulateStyle);
+    XTreeWidgetProgress *progress();
+    QSharedPointer<XTreeWidgetPopulatePlan> populatePlan(const QSqlRecord &);
+    void          startMerge();
+    void          finishMerge();
+    void          restoreMergedState();
     QList<XTreeWidgetPopulateParams> _workingParams;
     QTimer        _workingTimer;
     bool          _alwaysLinear;
     bool          _linear;
+    bool          _resultSetBacked;
+    QSharedPointer<XTreeWidgetResultSet> _resultSet;
 
-    QVector<int>    *_colIdx;
-    QVector<int *>  *_colRole;
+    QSharedPointer<XTreeWidgetPopulatePlan> _plan;          // kept between populates
+    QSharedPointer<XTreeWidgetPopulatePlan> _populatePlan;  // in use right now
     int              _fieldCount;
     XTreeWidgetItem *_last;
-    int              _rowRole[ROWROLE_COUNT];
+    QPointer<XTreeWidgetItem> _appendLast;  // where an Append populate() carries on
+    bool             _populatePending;      // rows are in, totals and sorting aren't
+    XTreeWidgetMerge *_merge;
+    XTreeWidgetSearchIndex *_searchIndex;
     void             cleanupAfterPopulate();
+    void             finishPopulate();
     XTreeWidgetProgress *_progress;
+    bool             _progressExternal;
     QList<QMap<int, double> *> *_subtotals;
 
+    /* what populateCalculatedColumns() has summed so far, so rows appended
+       later don't make it start over from the top */
+    int              _calculatedRows;       // top-level rows counted below
+    bool             _calculating;
+    QHash<int, QHash<int, double> > _runningSums;  // <col, <runningset, sum> >
+    QMap<int, QMap<int, double> >   _totalSums;    // <totalset, <col, total> >
+    QMap<int, int>                  _totalScales;  // <col, scale>
+    void             addCalculatedRow(XTreeWidgetItem *, const QList<int> &, const QList<int> &,
+                                      QHash<int, QHash<int, double> > &,
+                                      QMap<int, QMap<int, double> > &, QMap<int, int> &);
+
   private slots:
+    void  sRowsChanged(const QModelIndex &, int, int);
     void  sSelectionChanged();
     void  sItemSelected();
     void  sItemSelected(QTreeWidgetItem *, int);
@@ -357,7 +422,7 @@ class XTUPLEWIDGETS_EXPORT XTreeWidget : public QTreeWidget
 class XTreeWidgetPopulateParams
 {
   public:
-    XSqlQuery _workingQuery;
+    QSharedPointer<XTreeWidgetRows> _workingRows;
     int       _workingIndex;
     bool      _workingUseAlt;
     XTreeWidget::PopulateStyle _workingPopstyle;
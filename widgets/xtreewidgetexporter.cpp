@@ -0,0 +1,778 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "xtreewidgetexporter.h"
+
+#include <QColor>
+#include <QDate>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QFont>
+#include <QSet>
+#include <QSqlError>
+#include <QStringList>
+#include <QTextDocument>
+
+#include "xsqlquery.h"
+
+#define DEBUG false
+
+#define BUFFERSIZE   65536
+#define PROGRESSROWS 500
+
+#define ODFMIMETYPE "application/vnd.oasis.opendocument.text"
+#define ODFNS       "xmlns:office=\"urn:oasis:names:tc:opendocument:xmlns:office:1.0\" "           \
+                    "xmlns:style=\"urn:oasis:names:tc:opendocument:xmlns:style:1.0\" "             \
+                    "xmlns:text=\"urn:oasis:names:tc:opendocument:xmlns:text:1.0\" "               \
+                    "xmlns:table=\"urn:oasis:names:tc:opendocument:xmlns:table:1.0\" "             \
+                    "xmlns:fo=\"urn:oasis:names:tc:opendocument:xmlns:xsl-fo-compatible:1.0\" "    \
+                    "office:version=\"1.2\""
+
+static quint32 crc32(quint32 crc, const QByteArray &data)
+{
+  static quint32 table[256];
+  static bool    initialized = false;
+  if (! initialized)
+  {
+    for (quint32 i = 0; i < 256; i++)
+    {
+      quint32 c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+      table[i] = c;
+    }
+    initialized = true;
+  }
+
+  crc = ~crc;
+  for (int i = 0; i < data.size(); i++)
+    crc = table[(crc ^ (uchar)data.at(i)) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void putLE(QByteArray &buf, quint32 value, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+    buf.append((char)((value >> (8 * i)) & 0xFF));
+}
+
+/* Just enough of a zip writer for an OpenDocument package. Entries are
+   stored, not compressed, and written straight to the device; each local
+   header is patched with the CRC and size once its entry is finished,
+   so the device has to be seekable.
+*/
+class XTreeWidgetZipWriter
+{
+  public:
+    XTreeWidgetZipWriter(QIODevice *device)
+      : _device(device), _crc(0), _size(0), _offset(0), _entries(0)
+    {
+      QDateTime now = QDateTime::currentDateTime();
+      _dosTime = (now.time().hour() << 11) | (now.time().minute() << 5) |
+                 (now.time().second() / 2);
+      _dosDate = ((now.date().year() - 1980) << 9) | (now.date().month() << 5) |
+                 now.date().day();
+    }
+
+    void startEntry(const QString &name)
+    {
+      _name   = name.toUtf8();
+      _offset = _device->pos();
+      _crc    = 0;
+      _size   = 0;
+
+      QByteArray header;
+      putLE(header, 0x04034b50, 4);   // local file header signature
+      putLE(header, 10,       2);     // version needed to extract
+      putLE(header, 0,        2);     // flags
+      putLE(header, 0,        2);     // stored
+      putLE(header, _dosTime, 2);
+      putLE(header, _dosDate, 2);
+      putLE(header, 0,        4);     // crc, patched by finishEntry()
+      putLE(header, 0,        4);     // compressed size, patched
+      putLE(header, 0,        4);     // uncompressed size, patched
+      putLE(header, _name.size(), 2);
+      putLE(header, 0,        2);     // extra field length
+      header.append(_name);
+      _device->write(header);
+    }
+
+    bool write(const QByteArray &data)
+    {
+      _crc   = crc32(_crc, data);
+      _size += data.size();
+      return _device->write(data) == data.size();
+    }
+
+    bool finishEntry()
+    {
+      qint64 end = _device->pos();
+      QByteArray patch;
+      putLE(patch, _crc,  4);
+      putLE(patch, _size, 4);
+      putLE(patch, _size, 4);
+      if (! _device->seek(_offset + 14) || _device->write(patch) != patch.size() ||
+          ! _device->seek(end))
+        return false;
+
+      QByteArray central;
+      putLE(central, 0x02014b50, 4);  // central file header signature
+      putLE(central, 20,       2);    // version made by
+      putLE(central, 10,       2);    // version needed to extract
+      putLE(central, 0,        2);    // flags
+      putLE(central, 0,        2);    // stored
+      putLE(central, _dosTime, 2);
+      putLE(central, _dosDate, 2);
+      putLE(central, _crc,     4);
+      putLE(central, _size,    4);
+      putLE(central, _size,    4);
+      putLE(central, _name.size(), 2);
+      putLE(central, 0,        2);    // extra field length
+      putLE(central, 0,        2);    // comment length
+      putLE(central, 0,        2);    // disk number
+      putLE(central, 0,        2);    // internal attributes
+      putLE(central, 0,        4);    // external attributes
+      putLE(central, _offset,  4);
+      central.append(_name);
+      _central.append(central);
+      _entries++;
+      return true;
+    }
+
+    bool close()
+    {
+      quint32 start = _device->pos();
+      QByteArray end;
+      putLE(end, 0x06054b50, 4);      // end of central directory signature
+      putLE(end, 0,          2);      // this disk
+      putLE(end, 0,          2);      // disk with the central directory
+      putLE(end, _entries,   2);
+      putLE(end, _entries,   2);
+      putLE(end, _central.size(), 4);
+      putLE(end, start,      4);
+      putLE(end, 0,          2);      // comment length
+      return _device->write(_central) == _central.size() &&
+             _device->write(end)      == end.size();
+    }
+
+  private:
+    QIODevice  *_device;
+    QByteArray  _name;
+    QByteArray  _central;
+    quint32     _crc;
+    quint32     _size;
+    quint32     _offset;
+    quint32     _dosTime;
+    quint32     _dosDate;
+    int         _entries;
+};
+
+static QString xmlEscape(const QString &text)
+{
+  QString result = Qt::escape(text);
+  result.replace("\"", "&quot;");
+  return result;
+}
+
+static QString colorName(const QVariant &color)
+{
+  if (! color.isValid())
+    return QString();
+  QColor c = color.value<QColor>();
+  return c.isValid() ? c.name() : QString();
+}
+
+XTreeWidgetExporter::XTreeWidgetExporter(XTreeWidget *tree, QObject *parent)
+  : QObject(parent),
+    _tree(tree),
+    _device(0),
+    _zip(0),
+    _canceled(false),
+    _rowsWritten(0)
+{
+}
+
+XTreeWidgetExporter::~XTreeWidgetExporter()
+{
+  delete _zip;
+}
+
+/*! Pick the export format for a file name suffix: csv, tsv or txt, html
+    or htm, odt, and vcf. Returns UnknownFormat for anything else.
+ */
+XTreeWidgetExporter::Format XTreeWidgetExporter::formatForSuffix(const QString &suffix)
+{
+  QString s = suffix.toLower();
+  if (s == "csv")
+    return CSV;
+  else if (s == "tsv" || s == "txt")
+    return TSV;
+  else if (s == "html" || s == "htm")
+    return HTML;
+  else if (s == "odt")
+    return ODF;
+  else if (s == "vcf")
+    return VCF;
+  return UnknownFormat;
+}
+
+/*! Write the tree's visible rows and columns to \a filename. If \a format
+    is UnknownFormat it is chosen from the file name suffix. Returns false
+    if the file couldn't be written or the export was canceled; the file
+    is removed in either case.
+ */
+bool XTreeWidgetExporter::exportFile(const QString &filename, int format)
+{
+  _errorString.clear();
+
+  Format fmt = (Format)format;
+  if (fmt == UnknownFormat)
+    fmt = formatForSuffix(QFileInfo(filename).suffix());
+  if (fmt == UnknownFormat)
+  {
+    _errorString = tr("Cannot tell what kind of file to write for %1").arg(filename);
+    return false;
+  }
+
+  QFile file(filename);
+  if (! file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    _errorString = file.errorString();
+    return false;
+  }
+
+  bool ok = exportDevice(&file, fmt);
+  file.close();
+  if (! ok)
+    file.remove();
+
+  if (DEBUG)
+    qDebug("XTreeWidgetExporter::exportFile(%s, %d) wrote %d rows, ok = %d",
+           qPrintable(filename), fmt, _rowsWritten, ok);
+  return ok;
+}
+
+/*! Write the export to an open \a device. ODF needs a device that can
+    seek, such as a QFile or QBuffer.
+ */
+bool XTreeWidgetExporter::exportDevice(QIODevice *device, Format format)
+{
+  _errorString.clear();
+  _canceled    = false;
+  _rowsWritten = 0;
+  _styles.clear();
+
+  if (! _tree)
+  {
+    _errorString = tr("There is nothing to export.");
+    return false;
+  }
+  if (format == UnknownFormat || ! device || ! device->isWritable())
+  {
+    _errorString = tr("Cannot write this kind of export.");
+    return false;
+  }
+  _device = device;
+
+  bool ok = (format == VCF) ? writeContacts() : walk(format);
+
+  if (! ok && _errorString.isEmpty() && ! _canceled)
+    _errorString = device->errorString();
+
+  _device = 0;
+  delete _zip;
+  _zip = 0;
+  _buffer.clear();
+  return ok;
+}
+
+void XTreeWidgetExporter::cancel()
+{
+  _canceled = true;
+}
+
+/* copy the header and the cells to write out of the tree, visiting the
+   rows the way the user sees them: visible rows only, and the children of
+   expanded rows only. nothing here lets events through, so the items
+   can't go away while they're being read.
+ */
+void XTreeWidgetExporter::snapshot(Format format, QStringList &header, QList<Row> &rows)
+{
+  QList<int> cols;
+  for (int col = 0; col < _tree->columnCount(); col++)
+    if (! _tree->isColumnHidden(col))
+      cols.append(col);
+
+  QTreeWidgetItem *headerItem = _tree->headerItem();
+  for (int i = 0; i < cols.size(); i++)
+    header << headerItem->text(cols.at(i));
+
+  bool styled = (format == HTML || format == ODF);
+  QList<QTreeWidgetItem *> pending;
+  for (int i = _tree->topLevelItemCount() - 1; i >= 0; i--)
+    pending.append(_tree->topLevelItem(i));
+  while (! pending.isEmpty())
+  {
+    QTreeWidgetItem *item = pending.takeLast();
+    if (item->isHidden())
+      continue;
+
+    XTreeWidgetItem *xitem = dynamic_cast<XTreeWidgetItem *>(item);
+    if (xitem)
+    {
+      Row row(cols.size());
+      for (int i = 0; i < cols.size(); i++)
+      {
+        Cell &cell  = row[i];
+        cell.text   = xitem->text(cols.at(i));
+        cell.quoted = (format == CSV &&
+                       xitem->data(cols.at(i), Qt::DisplayRole).type() == QVariant::String);
+        if (styled)
+          cell.style = cellStyle(xitem, cols.at(i));
+      }
+      rows.append(row);
+    }
+
+    if (item->isExpanded())
+      for (int i = item->childCount() - 1; i >= 0; i--)
+        pending.append(item->child(i));
+  }
+}
+
+/* write from a copy of the rows: emitting progressValueChanged() runs the
+   progress dialog's event loop, and an auto-update or a repopulate could
+   delete tree items that are still waiting to be written
+ */
+bool XTreeWidgetExporter::walk(Format format)
+{
+  QStringList header;
+  QList<Row>  rows;
+  snapshot(format, header, rows);
+
+  int total = rows.size();
+  emit progressRangeChanged(0, total);
+  emit progressValueChanged(0);
+
+  if (format == ODF)
+  {
+    _zip = new XTreeWidgetZipWriter(_device);
+    _zip->startEntry("mimetype");   // must be first and stored
+    _zip->write(ODFMIMETYPE);
+    _zip->finishEntry();
+    _zip->startEntry("content.xml");
+  }
+
+  writeHeader(format, header);
+
+  while (! rows.isEmpty())
+  {
+    writeRow(format, rows.takeFirst());   // and free it as we go
+    _rowsWritten++;
+
+    if (_rowsWritten % PROGRESSROWS == 0)
+    {
+      emit progressValueChanged(_rowsWritten);
+      if (_canceled)
+        return false;
+    }
+    if (_buffer.size() >= BUFFERSIZE && ! flush())
+      return false;
+  }
+
+  writeFooter(format);
+  if (! flush())
+    return false;
+
+  if (format == ODF)
+  {
+    if (! _zip->finishEntry())
+      return false;
+
+    _zip->startEntry("styles.xml");
+    _zip->write(stylesXml().toUtf8());
+    _zip->finishEntry();
+
+    _zip->startEntry("META-INF/manifest.xml");
+    _zip->write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<manifest:manifest xmlns:manifest=\"urn:oasis:names:tc:opendocument:xmlns:manifest:1.0\" manifest:version=\"1.2\">\n"
+                " <manifest:file-entry manifest:full-path=\"/\" manifest:version=\"1.2\" manifest:media-type=\"" ODFMIMETYPE "\"/>\n"
+                " <manifest:file-entry manifest:full-path=\"content.xml\" manifest:media-type=\"text/xml\"/>\n"
+                " <manifest:file-entry manifest:full-path=\"styles.xml\" manifest:media-type=\"text/xml\"/>\n"
+                "</manifest:manifest>\n");
+    _zip->finishEntry();
+    if (! _zip->close())
+      return false;
+  }
+
+  emit progressValueChanged(total);
+  return true;
+}
+
+/* the contact ids to write as vCards: the selected rows, or every row
+   the user can see if nothing is selected
+ */
+QList<int> XTreeWidgetExporter::contactIds() const
+{
+  QList<int>        ids;
+  QSet<int>         seen;
+  QList<QTreeWidgetItem *> items = _tree->selectedItems();
+  if (items.isEmpty())
+  {
+    QList<QTreeWidgetItem *> pending;
+    for (int i = _tree->topLevelItemCount() - 1; i >= 0; i--)
+      pending.append(_tree->topLevelItem(i));
+    while (! pending.isEmpty())
+    {
+      QTreeWidgetItem *item = pending.takeLast();
+      if (item->isHidden())
+        continue;
+      items.append(item);
+      if (item->isExpanded())
+        for (int c = item->childCount() - 1; c >= 0; c--)
+          pending.append(item->child(c));
+    }
+  }
+
+  for (int i = 0; i < items.size(); i++)
+  {
+    XTreeWidgetItem *item = dynamic_cast<XTreeWidgetItem *>(items.at(i));
+    if (item && item->id() > 0 && ! seen.contains(item->id()))
+    {
+      seen.insert(item->id());
+      ids.append(item->id());
+    }
+  }
+  return ids;
+}
+
+/* escape a vCard property value or structured value component */
+static QString vcardEscape(const QString &value)
+{
+  QString result = value;
+  result.replace("\\", "\\\\")
+        .replace(",",  "\\,")
+        .replace(";",  "\\;")
+        .replace("\r\n", "\\n")
+        .replace("\n", "\\n");
+  return result;
+}
+
+/* fetch every contact in one query, keeping the order of the list, and
+   write a VCARD 3.0 record for each as the rows come back
+ */
+bool XTreeWidgetExporter::writeContacts()
+{
+  QList<int> ids = contactIds();
+  emit progressRangeChanged(0, ids.size());
+  emit progressValueChanged(0);
+  if (ids.isEmpty())
+    return true;
+
+  QStringList idList;
+  for (int i = 0; i < ids.size(); i++)
+    idList.append(QString::number(ids.at(i)));
+
+  XSqlQuery qry;
+  qry.prepare("SELECT cntct_first_name, cntct_middle, cntct_last_name,"
+              "       cntct_title, cntct_phone, cntct_phone2, cntct_email,"
+              "       addr_line1, addr_line2, addr_line3, addr_city,"
+              "       addr_state, addr_postalcode, addr_country"
+              "  FROM (SELECT ids[seq] AS picked_id, seq"
+              "          FROM (SELECT ids, generate_subscripts(ids, 1) AS seq"
+              "                  FROM (SELECT CAST(:ids AS INTEGER[]) AS ids) AS list"
+              "               ) AS numbered"
+              "       ) AS picked"
+              "  JOIN cntct ON (cntct_id=picked_id)"
+              "  LEFT OUTER JOIN addr ON (cntct_addr_id=addr_id)"
+              " ORDER BY seq;");
+  qry.bindValue(":ids", "{" + idList.join(",") + "}");
+  if (! qry.exec())
+  {
+    _errorString = qry.lastError().databaseText();
+    return false;
+  }
+
+  QString revision = QDate::currentDate().toString(Qt::ISODate);
+  while (qry.next())
+  {
+    QString first  = qry.value("cntct_first_name").toString();
+    QString middle = qry.value("cntct_middle").toString();
+    QString last   = qry.value("cntct_last_name").toString();
+    QStringList fullName;
+    if (! first.isEmpty())
+      fullName << first;
+    if (! middle.isEmpty())
+      fullName << middle;
+    if (! last.isEmpty())
+      fullName << last;
+
+    /* sometimes addr_line1 is the company name and sometimes it's really
+       the first line of the address. treat it as the organization unless
+       it starts with a street number.
+     */
+    QString     org;
+    QStringList street;
+    QString     line1 = qry.value("addr_line1").toString();
+    if (! line1.isEmpty() && line1.at(0).isDigit())
+      street << line1;
+    else
+      org = line1;
+    if (! qry.value("addr_line2").toString().isEmpty())
+      street << qry.value("addr_line2").toString();
+    if (! qry.value("addr_line3").toString().isEmpty())
+      street << qry.value("addr_line3").toString();
+
+    QStringList label = street;
+    QStringList place;
+    place << qry.value("addr_city").toString()
+          << qry.value("addr_state").toString()
+          << qry.value("addr_postalcode").toString()
+          << qry.value("addr_country").toString();
+    for (int i = 0; i < place.size(); i++)
+      if (! place.at(i).isEmpty())
+        label << place.at(i);
+
+    write("BEGIN:VCARD\r\nVERSION:3.0\r\n");
+    write("N:" + vcardEscape(last) + ";" + vcardEscape(first) + ";" +
+          vcardEscape(middle) + ";;\r\n");
+    write("FN:" + vcardEscape(fullName.join(" ")) + "\r\n");
+    if (! org.isEmpty())
+      write("ORG:" + vcardEscape(org) + "\r\n");
+    if (! qry.value("cntct_title").toString().isEmpty())
+      write("TITLE:" + vcardEscape(qry.value("cntct_title").toString()) + "\r\n");
+    if (! qry.value("cntct_phone").toString().isEmpty())
+      write("TEL;TYPE=WORK,VOICE:" + vcardEscape(qry.value("cntct_phone").toString()) + "\r\n");
+    if (! qry.value("cntct_phone2").toString().isEmpty())
+      write("TEL;TYPE=HOME,VOICE:" + vcardEscape(qry.value("cntct_phone2").toString()) + "\r\n");
+    if (! label.isEmpty())
+    {
+      write("ADR;TYPE=WORK:;;" + vcardEscape(street.join("\n")));
+      for (int i = 0; i < place.size(); i++)
+        write(";" + vcardEscape(place.at(i)));
+      write("\r\n");
+      write("LABEL;TYPE=WORK:" + vcardEscape(label.join("\n")) + "\r\n");
+    }
+    if (! qry.value("cntct_email").toString().isEmpty())
+      write("EMAIL;TYPE=PREF,INTERNET:" + vcardEscape(qry.value("cntct_email").toString()) + "\r\n");
+    write("REV:" + revision + "\r\nEND:VCARD\r\n");
+    _rowsWritten++;
+
+    if (_rowsWritten % PROGRESSROWS == 0)
+    {
+      emit progressValueChanged(_rowsWritten);
+      if (_canceled)
+        return false;
+    }
+    if (_buffer.size() >= BUFFERSIZE && ! flush())
+      return false;
+  }
+
+  if (! flush())
+    return false;
+
+  emit progressValueChanged(ids.size());
+  return true;
+}
+
+void XTreeWidgetExporter::writeHeader(Format format, const QStringList &header)
+{
+  QStringList fields;
+
+  switch (format)
+  {
+    case CSV:
+      for (int i = 0; i < header.size(); i++)
+        fields << QString(header.at(i)).replace("\"","\"\"").replace("\r\n"," ").replace("\n"," ");
+      write(fields.join(",") + "\r\n");
+      break;
+
+    case TSV:
+      for (int i = 0; i < header.size(); i++)
+        fields << QString(header.at(i)).replace("\r\n"," ").replace(QRegExp("[\t\n]"), " ");
+      write(fields.join("\t") + "\r\n");
+      break;
+
+    case HTML:
+      write("<html>\n<head><meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\"/></head>\n"
+            "<body>\n<table border=\"1\" cellspacing=\"0\" cellpadding=\"2\">\n<tr>");
+      for (int i = 0; i < header.size(); i++)
+        write("<th bgcolor=\"" + QColor(Qt::lightGray).name() + "\">" +
+              xmlEscape(header.at(i)) + "</th>");
+      write("</tr>\n");
+      break;
+
+    case ODF:
+      write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<office:document-content " ODFNS ">\n"
+            "<office:body><office:text>\n"
+            "<table:table table:name=\"Table1\">\n");
+      write(QString("<table:table-column table:number-columns-repeated=\"%1\"/>\n")
+              .arg(qMax(header.size(), 1)));
+      write("<table:table-header-rows><table:table-row>");
+      for (int i = 0; i < header.size(); i++)
+        write("<table:table-cell table:style-name=\"XtHeader\" office:value-type=\"string\"><text:p>" +
+              xmlEscape(header.at(i)) + "</text:p></table:table-cell>");
+      write("</table:table-row></table:table-header-rows>\n");
+      break;
+
+    default:
+      break;
+  }
+}
+
+void XTreeWidgetExporter::writeRow(Format format, const Row &row)
+{
+  QStringList fields;
+
+  switch (format)
+  {
+    case CSV:
+      for (int i = 0; i < row.size(); i++)
+      {
+        QString text = QString(row.at(i).text).replace("\"","\"\"");
+        if (row.at(i).quoted)
+          text = "\"" + text + "\"";
+        fields << text;
+      }
+      write(fields.join(",") + "\r\n");
+      break;
+
+    case TSV:
+      for (int i = 0; i < row.size(); i++)
+        fields << QString(row.at(i).text).replace("\r\n"," ").replace(QRegExp("[\t\n]"), " ");
+      write(fields.join("\t") + "\r\n");
+      break;
+
+    case HTML:
+      write("<tr>");
+      for (int i = 0; i < row.size(); i++)
+      {
+        const Cell &cell = row.at(i);
+        QString     style;
+        if (! cell.style.isEmpty())
+        {
+          QStringList parts = cell.style.split("|");
+          if (! parts.at(0).isEmpty())
+            style += "background-color:" + parts.at(0) + ";";
+          if (! parts.at(1).isEmpty())
+            style += "color:" + parts.at(1) + ";";
+          if (! parts.at(2).isEmpty())
+            style += "font-family:" + xmlEscape(QFont(parts.at(2)).family()) + ";";
+        }
+
+        if (style.isEmpty())
+          write("<td>");
+        else
+          write("<td style=\"" + style + "\">");
+        write(xmlEscape(cell.text) + "</td>");
+      }
+      write("</tr>\n");
+      break;
+
+    case ODF:
+      write("<table:table-row>");
+      for (int i = 0; i < row.size(); i++)
+      {
+        const Cell &cell = row.at(i);
+        if (cell.style.isEmpty())
+          write("<table:table-cell office:value-type=\"string\"><text:p>");
+        else
+          write("<table:table-cell table:style-name=\"" + _styles.value(cell.style) +
+                "\" office:value-type=\"string\"><text:p>");
+        write(xmlEscape(cell.text) + "</text:p></table:table-cell>");
+      }
+      write("</table:table-row>\n");
+      break;
+
+    default:
+      break;
+  }
+}
+
+void XTreeWidgetExporter::writeFooter(Format format)
+{
+  if (format == HTML)
+    write("</table>\n</body>\n</html>\n");
+  else if (format == ODF)
+    write("</table:table>\n</office:text></office:body>\n</office:document-content>\n");
+}
+
+/* the colors and font of a cell as "bg|fg|font", or an empty string if it
+   has none. each combination is kept once, with the name of the ODF cell
+   style made for it the first time it's seen; the styles are written to
+   styles.xml after the content.
+ */
+QString XTreeWidgetExporter::cellStyle(XTreeWidgetItem *item, int col)
+{
+  QString bg   = colorName(item->data(col, Qt::BackgroundRole));
+  QString fg   = colorName(item->data(col, Qt::ForegroundRole));
+  QString font = item->data(col, Qt::FontRole).toString();
+  if (bg.isEmpty() && fg.isEmpty() && font.isEmpty())
+    return QString();
+
+  QString key = bg + "|" + fg + "|" + font;
+  QHash<QString, QString>::const_iterator it = _styles.constFind(key);
+  if (it != _styles.constEnd())
+    return it.key();    // share the one copy
+
+  _styles.insert(key, QString("XtCell%1").arg(_styles.size() + 1));
+  return key;
+}
+
+QString XTreeWidgetExporter::stylesXml() const
+{
+  QString xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<office:document-styles " ODFNS ">\n<office:styles>\n"
+                "<style:style style:name=\"XtHeader\" style:family=\"table-cell\">"
+                "<style:table-cell-properties fo:background-color=\"" +
+                QColor(Qt::lightGray).name() + "\"/></style:style>\n";
+
+  QHashIterator<QString, QString> it(_styles);
+  while (it.hasNext())
+  {
+    it.next();
+    QStringList parts = it.key().split("|");
+    xml += "<style:style style:name=\"" + it.value() + "\" style:family=\"table-cell\">";
+    if (! parts.at(0).isEmpty())
+      xml += "<style:table-cell-properties fo:background-color=\"" + parts.at(0) + "\"/>";
+    if (! parts.at(1).isEmpty() || ! parts.at(2).isEmpty())
+    {
+      xml += "<style:text-properties";
+      if (! parts.at(1).isEmpty())
+        xml += " fo:color=\"" + parts.at(1) + "\"";
+      if (! parts.at(2).isEmpty())
+        xml += " fo:font-family=\"" + xmlEscape(QFont(parts.at(2)).family()) + "\"";
+      xml += "/>";
+    }
+    xml += "</style:style>\n";
+  }
+
+  xml += "</office:styles>\n</office:document-styles>\n";
+  return xml;
+}
+
+void XTreeWidgetExporter::write(const QString &text)
+{
+  _buffer += text;
+}
+
+bool XTreeWidgetExporter::flush()
+{
+  if (_buffer.isEmpty())
+    return true;
+
+  QByteArray data = _buffer.toUtf8();
+  _buffer.clear();
+
+  if (_zip)
+    return _zip->write(data);
+  return _device->write(data) == data.size();
+}
@@ -0,0 +1,104 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __XTREEWIDGETEXPORTER_H__
+#define __XTREEWIDGETEXPORTER_H__
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "xtreewidget.h"
+
+class QIODevice;
+class XTreeWidgetZipWriter;
+
+/* Write the visible columns and rows of an XTreeWidget to a file without
+   building the whole export in memory or in a QTextDocument. The cells to
+   write are copied out of the tree first, because the progress dialog
+   lets events through and a refresh could delete the items meanwhile;
+   then the rows are formatted one at a time into a small text buffer that
+   is flushed to the file every few thousand characters.
+
+   ODF is written as a minimal OpenDocument Text package: the table in
+   content.xml is streamed into the zip archive the same way, and the cell
+   styles it used are written to styles.xml afterwards.
+
+   VCF is the exception: rather than the columns it writes a VCARD 3.0
+   record for the contact each selected row's id points to, or for every
+   listed row if none is selected, fetching all of them in one query.
+
+   progressValueChanged() is emitted every few hundred rows; connect it and
+   progressRangeChanged() to a progress dialog and connect the dialog's
+   cancel to cancel() to stop early.
+*/
+class XTUPLEWIDGETS_EXPORT XTreeWidgetExporter : public QObject
+{
+  Q_OBJECT
+  Q_ENUMS(Format)
+
+  public:
+    enum Format { UnknownFormat = -1, CSV, TSV, HTML, ODF, VCF };
+
+    XTreeWidgetExporter(XTreeWidget *tree, QObject *parent = 0);
+    virtual ~XTreeWidgetExporter();
+
+    static Format formatForSuffix(const QString &suffix);
+
+    Q_INVOKABLE bool    exportFile(const QString &filename, int format = UnknownFormat);
+    bool                exportDevice(QIODevice *device, Format format);
+    Q_INVOKABLE QString errorString() const { return _errorString; }
+    Q_INVOKABLE bool    isCanceled()  const { return _canceled; }
+    Q_INVOKABLE int     rowsWritten() const { return _rowsWritten; }
+
+  public slots:
+    void cancel();
+
+  signals:
+    void progressRangeChanged(int minimum, int maximum);
+    void progressValueChanged(int rows);
+
+  private:
+    struct Cell
+    {
+      QString text;
+      QString style;    // "bg|fg|font", empty if the cell has none
+      bool    quoted;   // a string value, which CSV puts in quotes
+    };
+    typedef QVector<Cell> Row;
+
+    bool    walk(Format format);
+    void    snapshot(Format format, QStringList &header, QList<Row> &rows);
+    bool    writeContacts();
+    QList<int> contactIds() const;
+    void    writeHeader(Format format, const QStringList &header);
+    void    writeRow(Format format, const Row &row);
+    void    writeFooter(Format format);
+    QString cellStyle(XTreeWidgetItem *item, int col);
+    QString stylesXml() const;
+
+    void    write(const QString &text);
+    bool    flush();
+
+    QPointer<XTreeWidget>  _tree;
+    QIODevice             *_device;
+    XTreeWidgetZipWriter  *_zip;
+    QString                _buffer;
+    QString                _errorString;
+    bool                   _canceled;
+    int                    _rowsWritten;
+    QHash<QString, QString> _styles; // "bg|fg|font" -> ODF style name
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "xtreewidgetpopulateplan.h"
+
+#include <QLocale>
+#include <QObject>
+#include <QStringList>
+
+#include <cmath>
+
+#include "format.h"
+
+#define DEBUG false
+
+#define yesStr QObject::tr("Yes")
+#define noStr  QObject::tr("No")
+
+// Issue #8897 - same rounding as XTreeWidget has always used
+static double roundTo(double r, int places)
+{
+  double off = pow(10.0, places);
+  double x   = r * off;
+  double intpart;
+  double fractpart = modf(x, &intpart);
+
+  if (fabs(fractpart) >= 0.5)
+    x = x >= 0 ? ceil(x) : floor(x);
+  else
+    x = x < 0 ? ceil(x) : floor(x);
+
+  return x / off;
+}
+
+XTreeWidgetPopulatePlan::XTreeWidgetPopulatePlan(const QString &key, int columns)
+  : _defaultScale(decimalPlaces("")),
+    _colIdx(columns, -1),
+    _colRole(columns * COLROLE_COUNT, 0),
+    _format(columns, RawFormat),
+    _fixedScale(columns, _defaultScale),
+    _displayType(columns, QVariant::Invalid),
+    _alignment(columns, 0),
+    _hasScale(columns),
+    _noRole(columns),
+    _key(key),
+    _columns(columns),
+    _lastNumeric(columns),
+    _lastScale(columns, -1),
+    _lastPercent(columns)
+{
+  for (int i = 0; i < ROWROLE_COUNT; i++)
+    _rowRole[i] = 0;
+}
+
+/*! The role suffixes XTreeWidget looks for in query results, indexed by
+    the COLROLE_* values.
+ */
+const QStringList &XTreeWidgetPopulatePlan::knownRoles()
+{
+  static QStringList roles;
+  if (roles.isEmpty())
+    roles << "qtdisplayrole"      << "qttextalignmentrole"
+          << "qtbackgroundrole"   << "qtforegroundrole"
+          << "qttooltiprole"      << "qtstatustiprole"
+          << "qtfontrole"         << "xtkeyrole"
+          << "xtrunningrole"      << "xtrunninginit"
+          << "xtgrouprunningrole" << "xttotalrole"
+          << "xtnumericrole"      << "xtnullrole"
+          << "xtidrole";
+  return roles;
+}
+
+/*! The number of decimal places to show in column \a col, given the value
+    of its xtnumericrole field. \a percent is set if the value should be
+    multiplied by 100 for display.
+ */
+int XTreeWidgetPopulatePlan::scale(int col, const QVariant &numericrole, bool *percent) const
+{
+  if (role(col, COLROLE_NUMERIC) <= 0)
+  {
+    if (percent)
+      *percent = false;
+    return _fixedScale.at(col);
+  }
+
+  QString name = numericrole.toString();
+  if (_lastScale.at(col) < 0 || name != _lastNumeric.at(col))
+  {
+    _lastNumeric[col] = name;
+    _lastScale[col]   = decimalPlaces(name);
+    _lastPercent.setBit(col, name == "percent" || name == "scrap");
+  }
+
+  if (percent)
+    *percent = _lastPercent.testBit(col);
+  return _lastScale.at(col);
+}
+
+/*! The display value for column \a col given its \a raw value, the
+    value of its qtdisplayrole field and the value of its xtnullrole field.
+    Fields the query didn't supply should be passed as invalid QVariants.
+ */
+QVariant XTreeWidgetPopulatePlan::format(int col, const QVariant &raw, const QVariant &display,
+                                         const QVariant &nullstr, int scale, bool percent) const
+{
+  /* if qtdisplayrole IS NULL then let the raw value shine through.
+     this allows UNIONS to do interesting things, like put dates and
+     text into the same visual column without SQL errors.
+  */
+  if (display.isValid() && ! display.isNull())
+  {
+    /* this might not handle PostgreSQL NUMERICs properly
+       but at least it will try to handle INTEGERs and DOUBLEs
+       and it will avoid formatting sales order numbers with decimal
+       and group separators
+    */
+    switch (_displayType.at(col))
+    {
+      case QVariant::Int:
+        return QLocale().toString(display.toInt());
+      case QVariant::Double:
+        return QLocale().toString(display.toDouble(), 'f', scale);
+      default:
+        return display.toString();
+    }
+  }
+
+  if (raw.isNull())
+    return nullstr.isValid() ? nullstr.toString() : QString("");
+
+  switch (_format.at(col))
+  {
+    case NumericFormat:
+      if (percent)
+        return QLocale().toString(raw.toDouble() * 100.0, 'f', scale);
+      // fall through
+    case DoubleFormat:
+      return QLocale().toString(roundTo(raw.toDouble(), scale), 'f', scale);
+
+    case BoolFormat:
+      return raw.toBool() ? yesStr : noStr;
+
+    default:
+      return raw;
+  }
+}
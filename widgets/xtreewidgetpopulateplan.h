@@ -0,0 +1,98 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __XTREEWIDGETPOPULATEPLAN_H__
+#define __XTREEWIDGETPOPULATEPLAN_H__
+
+#include <QBitArray>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include "xtreewidget.h"
+
+// per-column roles a query can supply, in the order of knownRoles()
+#define COLROLE_DISPLAY       0
+#define COLROLE_TEXTALIGNMENT 1
+#define COLROLE_BACKGROUND    2
+#define COLROLE_FOREGROUND    3
+#define COLROLE_TOOLTIP       4
+#define COLROLE_STATUSTIP     5
+#define COLROLE_FONT          6
+#define COLROLE_KEY           7
+#define COLROLE_RUNNING       8
+#define COLROLE_RUNNINGINIT   9
+#define COLROLE_GROUPRUNNING  10
+#define COLROLE_TOTAL         11
+#define COLROLE_NUMERIC       12
+#define COLROLE_NULL          13
+#define COLROLE_ID            14
+// make sure COLROLE_COUNT = last COLROLE + 1
+#define COLROLE_COUNT         15
+
+class QStringList;
+
+/* Everything XTreeWidget::populateWorker() needs to know about how the
+   fields of a query map onto its columns, worked out once when the query
+   shape is first seen instead of once per row. Each column also gets its
+   display formatter picked here so formatting a cell is a switch on an
+   int rather than a series of string comparisons.
+
+   XTreeWidget keeps the last plan and reuses it as long as the query
+   returns the same fields for the same columns, so auto-refreshing
+   displays don't rebuild it every time.
+*/
+class XTreeWidgetPopulatePlan
+{
+  public:
+    enum Format
+    {
+      RawFormat,        // show the value as-is
+      BoolFormat,       // Yes/No
+      DoubleFormat,     // rounded to the default or the column's fixed scale
+      NumericFormat     // scale (and percent) from an xtnumericrole field
+    };
+
+    XTreeWidgetPopulatePlan(const QString &key, int columns);
+
+    static const QStringList &knownRoles();
+
+    const QString &key()     const { return _key; }
+    int       columns()      const { return _columns; }
+
+    int       role(int col, int roleid) const { return _colRole.at(col * COLROLE_COUNT + roleid); }
+    bool      hasScale(int col)         const { return _hasScale.testBit(col); }
+
+    int       scale(int col, const QVariant &numericrole, bool *percent = 0) const;
+    QVariant  format(int col, const QVariant &raw, const QVariant &display,
+                     const QVariant &nullstr, int scale, bool percent) const;
+
+    int           _defaultScale;
+    int           _rowRole[ROWROLE_COUNT];
+    QVector<int>  _colIdx;      // querycol = _colIdx[xtreecol]
+    QVector<int>  _colRole;     // querycol = _colRole[xtreecol * COLROLE_COUNT + roleid]
+    QVector<int>  _format;      // Format of each xtreecol
+    QVector<int>  _fixedScale;  // scale of each xtreecol without an xtnumericrole field
+    QVector<int>  _displayType; // QVariant::Type of each xtreecol's qtdisplayrole field
+    QVector<int>  _alignment;   // header text alignment of each xtreecol
+    QBitArray     _hasScale;    // xtreecol has an xtnumericrole, running or total
+    QBitArray     _noRole;      // xtreecol has no role map, skip it
+
+  private:
+    QString       _key;
+    int           _columns;
+
+    // most columns use the same xtnumericrole on every row so remember the last one
+    mutable QVector<QString> _lastNumeric;
+    mutable QVector<int>     _lastScale;
+    mutable QBitArray        _lastPercent;
+};
+
+#endif
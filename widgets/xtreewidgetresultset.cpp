@@ -0,0 +1,182 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "xtreewidgetresultset.h"
+
+#include <QSqlField>
+#include <QSqlRecord>
+
+#include "xtreewidget.h"
+#include "xtreewidgetpopulateplan.h"
+
+#define DEBUG false
+
+XTreeWidgetResultColumn::XTreeWidgetResultColumn(QVariant::Type type)
+  : _type(type)
+{
+}
+
+void XTreeWidgetResultColumn::append(const QVariant &value)
+{
+  int row = _nulls.size();
+  _nulls.resize(row + 1);
+
+  if (value.isNull())
+    _nulls.setBit(row);
+  else if (_type != QVariant::Invalid && value.type() != _type)
+    toVariants();
+
+  switch (_type)
+  {
+    case QVariant::Bool:
+    case QVariant::Int:
+      _ints.append(value.toInt());
+      break;
+
+    case QVariant::LongLong:
+      _longs.append(value.toLongLong());
+      break;
+
+    case QVariant::Double:
+      _doubles.append(value.toDouble());
+      break;
+
+    case QVariant::String:
+      _strings.append(value.toString());
+      break;
+
+    default:
+      _variants.append(value);
+  }
+}
+
+QVariant XTreeWidgetResultColumn::value(int row) const
+{
+  if (row < 0 || row >= _nulls.size())
+    return QVariant();
+
+  if (_nulls.testBit(row) && _type != QVariant::Invalid)
+    return QVariant(_type);
+
+  switch (_type)
+  {
+    case QVariant::Bool:
+      return QVariant(_ints.at(row) != 0);
+
+    case QVariant::Int:
+      return QVariant(_ints.at(row));
+
+    case QVariant::LongLong:
+      return QVariant(_longs.at(row));
+
+    case QVariant::Double:
+      return QVariant(_doubles.at(row));
+
+    case QVariant::String:
+      return QVariant(_strings.at(row));
+
+    default:
+      return _variants.at(row);
+  }
+}
+
+bool XTreeWidgetResultColumn::isNull(int row) const
+{
+  return (row < 0 || row >= _nulls.size() || _nulls.testBit(row));
+}
+
+void XTreeWidgetResultColumn::squeeze()
+{
+  _ints.squeeze();
+  _longs.squeeze();
+  _doubles.squeeze();
+  _strings.squeeze();
+  _variants.squeeze();
+}
+
+/* the column saw a value that doesn't match the type we guessed from the
+   record so copy what we have so far into the catch-all variant array
+*/
+void XTreeWidgetResultColumn::toVariants()
+{
+  if (DEBUG)
+    qDebug("XTreeWidgetResultColumn::toVariants() from type %d", _type);
+
+  QVector<QVariant> variants;
+  variants.reserve(_nulls.size());
+  for (int row = 0; row < _nulls.size() - 1; row++)
+    variants.append(value(row));
+
+  _variants = variants;
+  _ints.clear();
+  _longs.clear();
+  _doubles.clear();
+  _strings.clear();
+  _type = QVariant::Invalid;
+}
+
+XTreeWidgetResultSet::XTreeWidgetResultSet(const QSqlRecord &record, const QList<int> &fields)
+  : _rowCount(0)
+{
+  _fieldMap.fill(-1, record.count());
+  for (int i = 0; i < fields.size(); i++)
+  {
+    int field = fields.at(i);
+    if (field < 0 || field >= record.count() || _fieldMap.at(field) >= 0)
+      continue;
+
+    QVariant::Type type = record.field(field).type();
+    switch (type)
+    {
+      case QVariant::Bool:
+      case QVariant::Int:
+      case QVariant::LongLong:
+      case QVariant::Double:
+      case QVariant::String:
+        break;
+      default:
+        type = QVariant::Invalid;
+    }
+
+    _fieldMap[field] = _columns.size();
+    _fields.append(field);
+    _columns.append(XTreeWidgetResultColumn(type));
+  }
+}
+
+int XTreeWidgetResultSet::appendRow(const XTreeWidgetRows &row)
+{
+  for (int i = 0; i < _fields.size(); i++)
+    _columns[i].append(row.value(_fields.at(i)));
+
+  return _rowCount++;
+}
+
+QVariant XTreeWidgetResultSet::value(int row, int field) const
+{
+  if (field < 0 || field >= _fieldMap.size() || _fieldMap.at(field) < 0)
+    return QVariant();
+
+  return _columns.at(_fieldMap.at(field)).value(row);
+}
+
+bool XTreeWidgetResultSet::isNull(int row, int field) const
+{
+  if (field < 0 || field >= _fieldMap.size() || _fieldMap.at(field) < 0)
+    return true;
+
+  return _columns.at(_fieldMap.at(field)).isNull(row);
+}
+
+void XTreeWidgetResultSet::squeeze()
+{
+  for (int i = 0; i < _columns.size(); i++)
+    _columns[i].squeeze();
+}
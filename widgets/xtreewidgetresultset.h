@@ -0,0 +1,79 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __XTREEWIDGETRESULTSET_H__
+#define __XTREEWIDGETRESULTSET_H__
+
+#include <QBitArray>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+class QSqlRecord;
+class XTreeWidgetPopulatePlan;
+class XTreeWidgetRows;
+
+/* One column of a query result, stored as a plain array of the column's
+   own type instead of one QVariant per cell. Columns that turn out to
+   hold mixed types (UNIONs, etc.) fall back to a QVariant array.
+*/
+class XTreeWidgetResultColumn
+{
+  public:
+    XTreeWidgetResultColumn(QVariant::Type type = QVariant::Invalid);
+
+    void      append(const QVariant &value);
+    QVariant  value(int row) const;
+    bool      isNull(int row) const;
+    int       count() const { return _nulls.size(); }
+    void      squeeze();
+
+  private:
+    void      toVariants();
+
+    QVariant::Type     _type;
+    QVector<int>       _ints;
+    QVector<qlonglong> _longs;
+    QVector<double>    _doubles;
+    QVector<QString>   _strings;
+    QVector<QVariant>  _variants;
+    QBitArray          _nulls;
+};
+
+/* A column-oriented copy of the fields an XTreeWidget actually uses from
+   a populate() query, shared by all of the XTreeWidgetItems created from
+   that query. The items keep only their row number and build display
+   text from here on demand, so rows that are never painted never get
+   formatted.
+*/
+class XTreeWidgetResultSet
+{
+  public:
+    XTreeWidgetResultSet(const QSqlRecord &record, const QList<int> &fields);
+
+    int       appendRow(const XTreeWidgetRows &row);
+    int       rowCount()                const { return _rowCount; }
+    QVariant  value(int row, int field) const;
+    bool      isNull(int row, int field) const;
+    void      squeeze();
+
+    // how to turn a row back into item data, filled in by XTreeWidget
+    QSharedPointer<XTreeWidgetPopulatePlan> _plan;
+
+  private:
+    QVector<int>                      _fieldMap;  // querycol -> _columns index or -1
+    QList<int>                        _fields;    // querycols in _columns order
+    QVector<XTreeWidgetResultColumn>  _columns;
+    int                               _rowCount;
+};
+
+#endif
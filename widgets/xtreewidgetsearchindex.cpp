@@ -0,0 +1,328 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "xtreewidgetsearchindex.h"
+
+#include <QAbstractItemModel>
+#include <QSet>
+#include <QTreeWidget>
+
+#include <algorithm>
+#include <limits>
+
+#define DEBUG false
+
+/* more rows than this arriving at once is a load, not an edit, so
+   rebuild on the next search instead of inserting them one by one */
+#define BULKINSERT 64
+
+static quint64 trigram(const QString &text, int pos)
+{
+  return ((quint64)text.at(pos).unicode()     << 32) |
+         ((quint64)text.at(pos + 1).unicode() << 16) |
+          (quint64)text.at(pos + 2).unicode();
+}
+
+static QSet<quint64> trigrams(const QString &text)
+{
+  QSet<quint64> result;
+  for (int i = 0; i + 2 < text.length(); i++)
+    result.insert(trigram(text, i));
+  return result;
+}
+
+bool XTreeWidgetSearchIndex::Key::operator<(const Key &other) const
+{
+  int cmp = QString::compare(text, other.text);
+  return cmp < 0 || (cmp == 0 && seq < other.seq);
+}
+
+/* orders a prefix before every key that starts with something greater,
+   for finding the end of the run of keys that start with it */
+struct XTreeWidgetSearchIndex::PrefixLess
+{
+  int length;
+  bool operator()(const QString &prefix, const Key &key) const
+  {
+    return key.text.leftRef(length).compare(prefix) > 0;
+  }
+};
+
+XTreeWidgetSearchIndex::XTreeWidgetSearchIndex(QTreeWidget *tree, const QList<int> &columns, QObject *parent)
+  : QObject(parent),
+    _tree(tree),
+    _columns(columns),
+    _valid(false),
+    _rowCount(0),
+    _nextSeq(0),
+    _minValid(false)
+{
+  QAbstractItemModel *model = tree->model();
+  connect(model, SIGNAL(rowsInserted(const QModelIndex&, int, int)),
+          this,  SLOT(sRowsInserted(const QModelIndex&, int, int)));
+  connect(model, SIGNAL(rowsAboutToBeRemoved(const QModelIndex&, int, int)),
+          this,  SLOT(sRowsAboutToBeRemoved(const QModelIndex&, int, int)));
+  connect(model, SIGNAL(modelReset()),     this, SLOT(invalidate()));
+  connect(model, SIGNAL(layoutChanged()),  this, SLOT(invalidate()));
+  connect(model, SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)),
+          this,  SLOT(invalidate()));
+}
+
+/*! Return the first top-level item with text in one of the indexed
+    columns that starts with \a target, ignoring case, or 0 if none does.
+ */
+QTreeWidgetItem *XTreeWidgetSearchIndex::startsWith(const QString &target)
+{
+  if (! _valid)
+    build();
+
+  QString folded = target.toCaseFolded();
+  if (folded.isEmpty())
+    return _tree ? _tree->topLevelItem(0) : 0;
+
+  Key        lower  = { folded, -1 };
+  PrefixLess prefix = { folded.length() };
+  QVector<Key>::const_iterator from = std::lower_bound(_keys.constBegin(), _keys.constEnd(), lower);
+  QVector<Key>::const_iterator to   = std::upper_bound(from, _keys.constEnd(), folded, prefix);
+  if (from == to)
+    return 0;
+
+  if (! _minValid)
+    buildMinimum();
+  return _items.value(minimumSeq(from - _keys.constBegin(), to - _keys.constBegin()));
+}
+
+/*! Return the first top-level item with text in one of the indexed
+    columns that contains \a target, ignoring case, or 0 if none does.
+ */
+QTreeWidgetItem *XTreeWidgetSearchIndex::contains(const QString &target)
+{
+  if (! _valid)
+    build();
+
+  QString folded = target.toCaseFolded();
+  if (folded.isEmpty())
+    return _tree ? _tree->topLevelItem(0) : 0;
+
+  if (folded.length() < 3)
+  {
+    int first = -1;
+    for (QHash<int, QStringList>::const_iterator it = _text.constBegin(); it != _text.constEnd(); ++it)
+    {
+      if (first >= 0 && it.key() > first)
+        continue;
+      for (int c = 0; c < it.value().size(); c++)
+        if (it.value().at(c).contains(folded))
+        {
+          first = it.key();
+          break;
+        }
+    }
+    return first < 0 ? 0 : _items.value(first);
+  }
+
+  /* walk the shortest posting list in order and check each row against
+     the others; the first row that really contains the target wins */
+  QList<const QVector<int> *> postings;
+  foreach (quint64 tri, trigrams(folded))
+  {
+    QHash<quint64, QVector<int> >::const_iterator found = _trigrams.constFind(tri);
+    if (found == _trigrams.constEnd())
+      return 0;
+    postings.append(&found.value());
+  }
+
+  int shortest = 0;
+  for (int i = 1; i < postings.size(); i++)
+    if (postings.at(i)->size() < postings.at(shortest)->size())
+      shortest = i;
+
+  const QVector<int> *candidates = postings.at(shortest);
+  for (int i = 0; i < candidates->size(); i++)
+  {
+    int  seq = candidates->at(i);
+    bool all = true;
+    for (int p = 0; all && p < postings.size(); p++)
+      if (p != shortest)
+        all = std::binary_search(postings.at(p)->constBegin(), postings.at(p)->constEnd(), seq);
+    if (! all)
+      continue;
+
+    const QStringList &text = _text[seq];
+    for (int c = 0; c < text.size(); c++)
+      if (text.at(c).contains(folded))
+        return _items.value(seq);
+  }
+
+  return 0;
+}
+
+void XTreeWidgetSearchIndex::invalidate()
+{
+  if (DEBUG && _valid)
+    qDebug("XTreeWidgetSearchIndex::invalidate() dropping %d rows", _rowCount);
+
+  _valid = false;
+  _keys.clear();
+  _minSeq.clear();
+  _minValid = false;
+  _trigrams.clear();
+  _items.clear();
+  _seqs.clear();
+  _text.clear();
+}
+
+void XTreeWidgetSearchIndex::sRowsInserted(const QModelIndex &parent, int start, int end)
+{
+  if (! _valid || parent.isValid())
+    return;
+
+  if (start != _rowCount || end - start + 1 > BULKINSERT)
+  {
+    invalidate();
+    return;
+  }
+
+  int sorted = _keys.size();
+  for (int row = start; row <= end; row++)
+  {
+    QTreeWidgetItem *item = _tree->topLevelItem(row);
+    if (! item)
+    {
+      invalidate();
+      return;
+    }
+    addItem(item, _nextSeq++);
+    _rowCount++;
+  }
+  std::sort(_keys.begin() + sorted, _keys.end());
+  std::inplace_merge(_keys.begin(), _keys.begin() + sorted, _keys.end());
+  _minValid = false;
+}
+
+void XTreeWidgetSearchIndex::sRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
+{
+  if (! _valid || parent.isValid())
+    return;
+
+  for (int row = start; row <= end; row++)
+  {
+    QTreeWidgetItem *item = _tree->topLevelItem(row);
+    if (! item || ! _seqs.contains(item))
+    {
+      invalidate();
+      return;
+    }
+    removeItem(item);
+    _rowCount--;
+  }
+}
+
+void XTreeWidgetSearchIndex::build()
+{
+  invalidate();
+  if (! _tree)
+    return;
+
+  _rowCount = _tree->topLevelItemCount();
+  _keys.reserve(_rowCount * _columns.size());
+  for (int row = 0; row < _rowCount; row++)
+    addItem(_tree->topLevelItem(row), row);
+  _nextSeq = _rowCount;
+
+  std::sort(_keys.begin(), _keys.end());
+  _valid = true;
+
+  if (DEBUG)
+    qDebug("XTreeWidgetSearchIndex::build() %d rows, %d keys, %d trigrams",
+           _rowCount, _keys.size(), _trigrams.size());
+}
+
+/* a segment tree over the seqs of the sorted keys: key i is the leaf at
+   _keys.size() + i and every node above holds the lower of its two
+   children. it's rebuilt, in linear time, on the first prefix search
+   after the keys change.
+ */
+void XTreeWidgetSearchIndex::buildMinimum()
+{
+  int n = _keys.size();
+  _minSeq.resize(2 * n);
+  for (int i = 0; i < n; i++)
+    _minSeq[n + i] = _keys.at(i).seq;
+  for (int i = n - 1; i > 0; i--)
+    _minSeq[i] = qMin(_minSeq.at(2 * i), _minSeq.at(2 * i + 1));
+  _minValid = true;
+}
+
+/* the lowest seq of the keys from index from up to but not including to */
+int XTreeWidgetSearchIndex::minimumSeq(int from, int to) const
+{
+  int result = std::numeric_limits<int>::max();
+  for (from += _keys.size(), to += _keys.size(); from < to; from /= 2, to /= 2)
+  {
+    if (from & 1)
+      result = qMin(result, _minSeq.at(from++));
+    if (to & 1)
+      result = qMin(result, _minSeq.at(--to));
+  }
+  return result;
+}
+
+/* seqs are handed out in list order so postings stay sorted by appending;
+   callers sort _keys once they're done adding */
+void XTreeWidgetSearchIndex::addItem(QTreeWidgetItem *item, int seq)
+{
+  QStringList   text;
+  QSet<quint64> grams;
+  for (int i = 0; i < _columns.size(); i++)
+  {
+    Key key = { item->text(_columns.at(i)).toCaseFolded(), seq };
+    text.append(key.text);
+    _keys.append(key);
+    grams.unite(trigrams(key.text));
+  }
+
+  foreach (quint64 tri, grams)
+    _trigrams[tri].append(seq);
+
+  _items.insert(seq, item);
+  _seqs.insert(item, seq);
+  _text.insert(seq, text);
+}
+
+void XTreeWidgetSearchIndex::removeItem(QTreeWidgetItem *item)
+{
+  int         seq  = _seqs.take(item);
+  QStringList text = _text.take(seq);
+  _items.remove(seq);
+
+  QSet<quint64> grams;
+  for (int i = 0; i < text.size(); i++)
+  {
+    Key key = { text.at(i), seq };
+    QVector<Key>::iterator it = std::lower_bound(_keys.begin(), _keys.end(), key);
+    if (it != _keys.end() && it->seq == seq && it->text == key.text)
+      _keys.erase(it);
+    _minValid = false;
+    grams.unite(trigrams(text.at(i)));
+  }
+
+  foreach (quint64 tri, grams)
+  {
+    QHash<quint64, QVector<int> >::iterator posting = _trigrams.find(tri);
+    if (posting == _trigrams.end())
+      continue;
+    QVector<int>::iterator it = std::lower_bound(posting->begin(), posting->end(), seq);
+    if (it != posting->end() && *it == seq)
+      posting->erase(it);
+    if (posting->isEmpty())
+      _trigrams.erase(posting);
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2014 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef XTREEWIDGETSEARCHINDEX_H
+#define XTREEWIDGETSEARCHINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QModelIndex>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+class QTreeWidget;
+class QTreeWidgetItem;
+
+/* Case-folded copies of the text in some columns of a tree's top-level
+   items, kept so type-ahead searching doesn't have to call text() and
+   fold every row on every keystroke.
+
+   Keys are held sorted so the keys with a prefix are one run found by
+   binary search, and a segment tree over their row order gives the
+   earliest row in that run without scanning it. Every key is also broken
+   into trigrams so a contains lookup only looks at the rows that have
+   all of the target's trigrams. Either lookup returns the matching item
+   that comes first in the list.
+
+   The index is built the first time it's searched. Rows appended or
+   removed one at a time after that are added to or dropped from the
+   index; sorting, clearing, editing, or bulk loads throw it away to be
+   rebuilt on the next search.
+*/
+class XTreeWidgetSearchIndex : public QObject
+{
+  Q_OBJECT
+
+  public:
+    XTreeWidgetSearchIndex(QTreeWidget *tree, const QList<int> &columns, QObject *parent = 0);
+
+    QTreeWidgetItem *startsWith(const QString &target);
+    QTreeWidgetItem *contains(const QString &target);
+
+  public slots:
+    void invalidate();
+
+  private slots:
+    void sRowsInserted(const QModelIndex &parent, int start, int end);
+    void sRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end);
+
+  private:
+    struct Key
+    {
+      QString text;
+      int     seq;
+      bool operator<(const Key &other) const;
+    };
+    struct PrefixLess;
+
+    void build();
+    void buildMinimum();
+    int  minimumSeq(int from, int to) const;
+    void addItem(QTreeWidgetItem *item, int seq);
+    void removeItem(QTreeWidgetItem *item);
+
+    QPointer<QTreeWidget>             _tree;
+    QList<int>                        _columns;
+    bool                              _valid;
+    int                               _rowCount;
+    int                               _nextSeq;
+    QVector<Key>                      _keys;      // sorted by text
+    QVector<int>                      _minSeq;    // segment tree of lowest seqs over _keys
+    bool                              _minValid;
+    QHash<quint64, QVector<int> >     _trigrams;  // trigram -> ascending seqs
+    QHash<int, QTreeWidgetItem *>     _items;     // seq -> item
+    QHash<QTreeWidgetItem *, int>     _seqs;      // item -> seq
+    QHash<int, QStringList>           _text;      // seq -> folded column text
+};
+
+#endif